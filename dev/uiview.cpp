@@ -54,7 +54,7 @@ void UIView::PositionChanged(qint64 p_Position)
 {
   m_TrackPositionSec = p_Position / 1000;
 
-  if (m_Scrobbler && (m_TrackDurationSec > 0) && (m_PlaylistPosition < m_Playlist.count()))
+  if ((m_TrackDurationSec > 0) && (m_PlaylistPosition < m_Playlist.count()))
   {
     if (m_TrackPositionSec == 0)
     {
@@ -66,16 +66,25 @@ void UIView::PositionChanged(qint64 p_Position)
     const qint64 elapsedSec = m_PlayTime.elapsed() / 1000;
     if (!m_SetPlayed && (elapsedSec >= 10) && (m_TrackPositionSec >= (m_TrackDurationSec / 2))) // scrobble played after 50% (min 10 sec)
     {
-      const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
-      const QString& title = m_Playlist.at(m_PlaylistPosition).title;
-      m_Scrobbler->Played(artist, title, m_TrackDurationSec);
+      if (m_Scrobbler)
+      {
+        const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
+        const QString& title = m_Playlist.at(m_PlaylistPosition).title;
+        m_Scrobbler->Played(artist, title, m_TrackDurationSec);
+      }
+
+      emit TrackPlayed(m_PlaylistPosition);
       m_SetPlayed = true;
     }
     else if (!m_SetPlaying && (elapsedSec >= 3)) // scrobble playing after 3 sec
     {
-      const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
-      const QString& title = m_Playlist.at(m_PlaylistPosition).title;
-      m_Scrobbler->Playing(artist, title, m_TrackDurationSec);
+      if (m_Scrobbler)
+      {
+        const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
+        const QString& title = m_Playlist.at(m_PlaylistPosition).title;
+        m_Scrobbler->Playing(artist, title, m_TrackDurationSec);
+      }
+
       m_SetPlaying = true;
     }
   }
@@ -135,19 +144,7 @@ void UIView::Search()
 {
 }
 
-void UIView::SelectPrevious()
-{
-}
-
-void UIView::SelectNext()
-{
-}
-
-void UIView::PagePrevious()
-{
-}
-
-void UIView::PageNext()
+void UIView::MoveSelection(int /*p_Rows*/, int /*p_Pages*/)
 {
 }
 
@@ -268,6 +265,10 @@ void UIView::ToggleFolders()
 {
 }
 
+void UIView::ToggleStats()
+{
+}
+
 void UIView::GetViewFolders(bool& p_ViewFolders)
 {
   p_ViewFolders = m_ViewFolders;
@@ -326,6 +327,18 @@ void UIView::Unenqueue()
 {
 }
 
-void UIView::QueueUpdated(const QVector<int>& /*p_Queue*/)
+void UIView::EnqueueFolder()
+{
+}
+
+void UIView::QueueUpdated(const PlayQueue* /*p_Queue*/)
+{
+}
+
+void UIView::EqualizerUpdated(const QString& /*p_Preset*/)
+{
+}
+
+void UIView::SpeedUpdated(float /*p_Speed*/)
 {
 }
@@ -147,7 +147,7 @@ fi
 
 # tests
 if [[ "${TESTS}" == "1" ]]; then
-  true || exiterr "tests failed, exiting."
+  mkdir -p build/tests && cd build/tests && ${QMAKE} ../../tests/realffttest.pro && make ${MAKEARGS} && ./realffttest && cd ../.. || exiterr "tests failed, exiting."
 fi
 
 # doc
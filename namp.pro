@@ -3,21 +3,56 @@ TEMPLATE             = app
 CONFIG              += c++11 release cmdline
 QT                  += core multimedia
 
-HEADERS              = src/audioplayer.h                       \
+HEADERS              = src/aliassampler.h                      \
+                       src/audioengine.h                       \
+                       src/audioplayer.h                       \
                        src/common.h                            \
+                       src/equalizer.h                         \
+                       src/filerangedevice.h                   \
                        src/log.h                               \
+                       src/loudness.h                          \
+                       src/loudnessscanner.h                   \
+                       src/mp3index.h                          \
+                       src/mp3util.h                           \
+                       src/playbackclock.h                     \
+                       src/playbackstats.h                     \
+                       src/playqueue.h                         \
+                       src/playstats.h                         \
+                       src/prefetcher.h                        \
+                       src/realfft.h                           \
                        src/scrobbler.h                         \
+                       src/shuffleorder.h                      \
                        src/spectrum.h                          \
+                       src/spectrumcache.h                     \
+                       src/spscring.h                          \
+                       src/timestretch.h                       \
                        src/uikeyhandler.h                      \
                        src/uiview.h                            \
                        src/util.h                              \
                        src/version.h
 
-SOURCES              = src/audioplayer.cpp                     \
+SOURCES              = src/aliassampler.cpp                    \
+                       src/audioengine.cpp                     \
+                       src/audioplayer.cpp                     \
                        src/main.cpp                            \
+                       src/equalizer.cpp                       \
+                       src/filerangedevice.cpp                 \
                        src/log.cpp                             \
+                       src/loudness.cpp                        \
+                       src/loudnessscanner.cpp                 \
+                       src/mp3index.cpp                        \
+                       src/mp3util.cpp                         \
+                       src/playbackclock.cpp                   \
+                       src/playbackstats.cpp                   \
+                       src/playqueue.cpp                       \
+                       src/playstats.cpp                       \
+                       src/prefetcher.cpp                      \
+                       src/realfft.cpp                         \
                        src/scrobbler.cpp                       \
+                       src/shuffleorder.cpp                    \
                        src/spectrum.cpp                        \
+                       src/spectrumcache.cpp                   \
+                       src/timestretch.cpp                     \
                        src/util.cpp
 
 !DEVBUILD {
@@ -0,0 +1,92 @@
+// aliassampler.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "aliassampler.h"
+
+#include <cstdlib>
+
+void AliasSampler::Build(const std::vector<float>& p_Weights)
+{
+  const int count = static_cast<int>(p_Weights.size());
+  m_Probability.assign(count, 1.0f);
+  m_Alias.resize(count);
+  for (int i = 0; i < count; ++i)
+  {
+    m_Alias[i] = i;
+  }
+
+  double sum = 0.0;
+  for (const float weight : p_Weights)
+  {
+    sum += (weight > 0.0f) ? weight : 0.0f;
+  }
+
+  // All zero weights sample uniformly
+  if ((count == 0) || (sum <= 0.0)) return;
+
+  // Scale weights to a mean of one, and pair each entry below one with an
+  // entry above it that fills up the rest of its column
+  std::vector<double> scaled(count);
+  std::vector<int> small;
+  std::vector<int> large;
+  small.reserve(count);
+  large.reserve(count);
+  for (int i = 0; i < count; ++i)
+  {
+    scaled[i] = ((p_Weights[i] > 0.0f) ? p_Weights[i] : 0.0) * count / sum;
+    if (scaled[i] < 1.0)
+    {
+      small.push_back(i);
+    }
+    else
+    {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty())
+  {
+    const int less = small.back();
+    small.pop_back();
+    const int more = large.back();
+
+    m_Probability[less] = static_cast<float>(scaled[less]);
+    m_Alias[less] = more;
+    scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+    if (scaled[more] < 1.0)
+    {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  // Remaining entries are full columns, up to rounding errors
+  for (const int i : small)
+  {
+    m_Probability[i] = 1.0f;
+  }
+
+  for (const int i : large)
+  {
+    m_Probability[i] = 1.0f;
+  }
+}
+
+int AliasSampler::Sample() const
+{
+  if (m_Probability.empty()) return -1;
+
+  const int column = rand() % static_cast<int>(m_Probability.size());
+  const float r = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX) + 1.0f);
+  return (r < m_Probability[column]) ? column : m_Alias[column];
+}
+
+int AliasSampler::Size() const
+{
+  return static_cast<int>(m_Probability.size());
+}
@@ -0,0 +1,25 @@
+// aliassampler.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <vector>
+
+// Weighted random sampling using Vose's alias method. Building the table is
+// linear in the number of weights, and each draw is constant time.
+class AliasSampler
+{
+public:
+  void Build(const std::vector<float>& p_Weights);
+  int Sample() const;
+  int Size() const;
+
+private:
+  std::vector<float> m_Probability;
+  std::vector<int> m_Alias;
+};
@@ -0,0 +1,1666 @@
+// audioengine.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "audioengine.h"
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+
+#include <QMediaDevices>
+#include <QUrl>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "log.h"
+#include "mp3util.h"
+#include "playbackstats.h"
+
+// Stream ring capacity in samples (~2.7 sec of stereo audio at 48 kHz)
+static const size_t kRingSamples = 1 << 18;
+
+// Audio buffered before the sink is started, to not begin with an underrun
+static const qint64 kPrefillMs = 200;
+
+// Position update and stream supervision interval
+static const int kTimerIntervalMs = 50;
+
+// Buffered audio below which a playing stream counts as starved by the decoder
+static const qint64 kStallMs = 50;
+
+// Worker retry interval when the ring is full
+static const int kRetryIntervalMs = 10;
+
+// Delivered audio kept by the sink device for replay on a new sink, in
+// samples (~1.4 sec of stereo audio at 48 kHz), above typical sink and
+// backend buffers together
+static const size_t kHistorySamples = 1 << 17;
+
+// Mixed crossfade audio held for the analyzer until taken by the GUI thread,
+// in samples (~0.7 sec of stereo audio at 48 kHz)
+static const size_t kFadeTapSamples = 1 << 16;
+
+// Equalizer load (fraction of a core) above which it is counted as overloaded
+static const float kMaxEqualizerLoad = 0.01f;
+
+// Analyzer buffers held for a queued track until playback reaches it
+static const int kMaxNextBuffers = 512;
+
+static const int kDefaultSampleRate = 48000;
+
+// Decoded start of next / previous track candidates, kept so that skipping
+// to one of them starts playback without waiting for the decoder
+static const qint64 kHeadMs = 1500;
+static const qint64 kMaxHeadBytes = 8 * 1024 * 1024;
+
+// Convert frames to interleaved stereo float. Mono is duplicated, and only
+// front left / right are used from multi-channel audio.
+template <typename T>
+static void ToStereo(const T* p_In, int p_Channels, int p_Frames, float p_Scale, float p_Bias, float* p_Out)
+{
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    const T* frame = p_In + (i * p_Channels);
+    const float left = (frame[0] * p_Scale) + p_Bias;
+    const float right = (p_Channels > 1) ? ((frame[1] * p_Scale) + p_Bias) : left;
+    p_Out[(2 * i) + 0] = left;
+    p_Out[(2 * i) + 1] = right;
+  }
+}
+
+// Append buffer frames from p_Skip onwards, at most p_MaxFrames, to p_Out as
+// interleaved stereo float. Returns number of frames appended.
+static int AppendStereo(const QAudioBuffer& p_Buffer, int p_Skip, int p_MaxFrames, std::vector<float>& p_Out)
+{
+  const QAudioFormat fmt = p_Buffer.format();
+  const int channels = fmt.channelCount();
+  const int count = qMin(p_Buffer.frameCount() - p_Skip, p_MaxFrames);
+  if ((channels <= 0) || (count <= 0)) return 0;
+
+  const size_t offset = p_Out.size();
+  p_Out.resize(offset + (count * AudioStream::kChannels));
+  float* out = p_Out.data() + offset;
+  switch (fmt.sampleFormat())
+  {
+    case QAudioFormat::Float:
+      ToStereo(p_Buffer.constData<float>() + (p_Skip * channels), channels, count, 1.0f, 0.0f, out);
+      break;
+
+    case QAudioFormat::Int16:
+      ToStereo(p_Buffer.constData<qint16>() + (p_Skip * channels), channels, count, 1.0f / 32768.0f, 0.0f, out);
+      break;
+
+    case QAudioFormat::Int32:
+      ToStereo(p_Buffer.constData<qint32>() + (p_Skip * channels), channels, count, 1.0f / 2147483648.0f, 0.0f, out);
+      break;
+
+    case QAudioFormat::UInt8:
+      ToStereo(p_Buffer.constData<quint8>() + (p_Skip * channels), channels, count, 1.0f / 128.0f, -1.0f, out);
+      break;
+
+    default:
+      p_Out.resize(offset);
+      return 0;
+  }
+
+  return count;
+}
+
+// Read interleaved stereo from stream, with silence in place of missing data
+// (an underrun, unless the stream has ended)
+static void ReadStream(AudioStream& p_Stream, float* p_Out, size_t p_Samples, bool& p_Underrun)
+{
+  const size_t read = p_Stream.ring.Read(p_Out, p_Samples);
+  if (read < p_Samples)
+  {
+    std::fill(p_Out + read, p_Out + p_Samples, 0.0f);
+    p_Underrun = p_Underrun || !p_Stream.finished.load(std::memory_order_acquire);
+  }
+
+  p_Stream.framesRead.fetch_add(read / AudioStream::kChannels, std::memory_order_release);
+}
+
+// Scale interleaved stereo frames by a gain going linearly from p_OutFrom to
+// p_OutTo over the block, and add p_In (if given) scaled by a gain going from
+// p_InFrom to p_InTo
+static void MixGain(float* p_Out, const float* p_In, int p_Frames, float p_OutFrom, float p_OutTo,
+                    float p_InFrom, float p_InTo)
+{
+  if (p_Frames <= 0) return;
+
+  const float outStep = (p_OutTo - p_OutFrom) / p_Frames;
+  const float inStep = (p_InTo - p_InFrom) / p_Frames;
+  int i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+  // Two frames per vector, with gains for the first frame in the low lanes
+  __m128 outGain = _mm_setr_ps(p_OutFrom, p_OutFrom, p_OutFrom + outStep, p_OutFrom + outStep);
+  __m128 inGain = _mm_setr_ps(p_InFrom, p_InFrom, p_InFrom + inStep, p_InFrom + inStep);
+  const __m128 outInc = _mm_set1_ps(2.0f * outStep);
+  const __m128 inInc = _mm_set1_ps(2.0f * inStep);
+  for (; (i + 2) <= p_Frames; i += 2)
+  {
+    float* out = p_Out + (i * AudioStream::kChannels);
+    __m128 mix = _mm_mul_ps(_mm_loadu_ps(out), outGain);
+    if (p_In != nullptr)
+    {
+      mix = _mm_add_ps(mix, _mm_mul_ps(_mm_loadu_ps(p_In + (i * AudioStream::kChannels)), inGain));
+    }
+
+    _mm_storeu_ps(out, mix);
+    outGain = _mm_add_ps(outGain, outInc);
+    inGain = _mm_add_ps(inGain, inInc);
+  }
+#elif defined(__ARM_NEON)
+  const float outInit[4] = { p_OutFrom, p_OutFrom, p_OutFrom + outStep, p_OutFrom + outStep };
+  const float inInit[4] = { p_InFrom, p_InFrom, p_InFrom + inStep, p_InFrom + inStep };
+  float32x4_t outGain = vld1q_f32(outInit);
+  float32x4_t inGain = vld1q_f32(inInit);
+  const float32x4_t outInc = vdupq_n_f32(2.0f * outStep);
+  const float32x4_t inInc = vdupq_n_f32(2.0f * inStep);
+  for (; (i + 2) <= p_Frames; i += 2)
+  {
+    float* out = p_Out + (i * AudioStream::kChannels);
+    float32x4_t mix = vmulq_f32(vld1q_f32(out), outGain);
+    if (p_In != nullptr)
+    {
+      mix = vmlaq_f32(mix, vld1q_f32(p_In + (i * AudioStream::kChannels)), inGain);
+    }
+
+    vst1q_f32(out, mix);
+    outGain = vaddq_f32(outGain, outInc);
+    inGain = vaddq_f32(inGain, inInc);
+  }
+#endif
+
+  for (; i < p_Frames; ++i)
+  {
+    const float outGain = p_OutFrom + (i * outStep);
+    const float inGain = p_InFrom + (i * inStep);
+    for (int c = 0; c < AudioStream::kChannels; ++c)
+    {
+      const int pos = (i * AudioStream::kChannels) + c;
+      p_Out[pos] = (p_Out[pos] * outGain) + ((p_In != nullptr) ? (p_In[pos] * inGain) : 0.0f);
+    }
+  }
+}
+
+AudioStream::AudioStream(size_t p_Capacity)
+  : ring(p_Capacity)
+{
+}
+
+void AudioStream::Reset()
+{
+  // Only while neither a decoder nor the sink uses the stream
+  ring.Clear();
+  framesWritten.store(0);
+  framesRead.store(0);
+  finished.store(false);
+}
+
+AudioMix::AudioMix(size_t p_TapCapacity)
+  : tap(p_TapCapacity)
+{
+}
+
+AudioSinkDevice::AudioSinkDevice(AudioMix& p_Mix, TimeStretch& p_TimeStretch, Equalizer& p_Equalizer,
+                                 QAudioFormat::SampleFormat p_SampleFormat, QObject* p_Parent)
+  : QIODevice(p_Parent)
+  , m_Mix(p_Mix)
+  , m_TimeStretch(p_TimeStretch)
+  , m_Equalizer(p_Equalizer)
+  , m_SampleFormat(p_SampleFormat)
+  , m_History(kHistorySamples, 0.0f)
+{
+}
+
+bool AudioSinkDevice::isSequential() const
+{
+  return true;
+}
+
+qint64 AudioSinkDevice::bytesAvailable() const
+{
+  // Gaps are filled with silence, so there is always data to read
+  return (1 << 20) + QIODevice::bytesAvailable();
+}
+
+qint64 AudioSinkDevice::readData(char* p_Data, qint64 p_MaxSize)
+{
+  const int sampleBytes = (m_SampleFormat == QAudioFormat::Int16) ? sizeof(qint16) : sizeof(float);
+  const qint64 frames = p_MaxSize / (sampleBytes * AudioStream::kChannels);
+  if (frames <= 0) return 0;
+
+  const size_t samples = frames * AudioStream::kChannels;
+  float* out = nullptr;
+  if (m_SampleFormat == QAudioFormat::Int16)
+  {
+    if (m_Scratch.size() < samples)
+    {
+      m_Scratch.resize(samples);
+    }
+
+    out = m_Scratch.data();
+  }
+  else
+  {
+    out = reinterpret_cast<float*>(p_Data);
+  }
+
+  // Replayed audio was already counted as read from the stream
+  const size_t replayed = std::min(samples, m_Replay.size() - m_ReplayPos);
+  std::copy(m_Replay.begin() + m_ReplayPos, m_Replay.begin() + m_ReplayPos + replayed, out);
+  m_ReplayPos += replayed;
+
+  bool underrun = false;
+  if (!m_TimeStretch.Prepare())
+  {
+    ReadInput(out + replayed, samples - replayed, underrun);
+  }
+  else
+  {
+    // Stretched audio is produced from stream input as needed
+    size_t done = replayed;
+    while (true)
+    {
+      done += m_TimeStretch.ReadOutput(out + done, samples - done);
+      if (done >= samples) break;
+
+      size_t wanted = 0;
+      float* input = m_TimeStretch.InputBuffer(wanted);
+      ReadInput(input, wanted, underrun);
+      m_TimeStretch.InputWritten(wanted);
+    }
+  }
+
+  if (underrun)
+  {
+    m_Mix.underruns.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  for (size_t i = 0; i < samples; ++i)
+  {
+    m_History[m_HistoryPos] = out[i];
+    m_HistoryPos = (m_HistoryPos + 1) % m_History.size();
+  }
+
+  m_HistoryFrames += frames;
+
+  m_FramesDelivered.fetch_add(frames - (replayed / AudioStream::kChannels), std::memory_order_release);
+  m_Equalizer.Process(out, frames);
+
+  if (m_SampleFormat == QAudioFormat::Int16)
+  {
+    qint16* data = reinterpret_cast<qint16*>(p_Data);
+    for (size_t i = 0; i < samples; ++i)
+    {
+      data[i] = static_cast<qint16>(qBound(-32768.0f, out[i] * 32768.0f, 32767.0f));
+    }
+  }
+
+  return frames * sampleBytes * AudioStream::kChannels;
+}
+
+qint64 AudioSinkDevice::writeData(const char* /*p_Data*/, qint64 /*p_MaxSize*/)
+{
+  return -1;
+}
+
+void AudioSinkDevice::ReadInput(float* p_Out, size_t p_Samples, bool& p_Underrun)
+{
+  AudioStream* primary = m_Mix.primary.load(std::memory_order_acquire);
+  ReadStream(*primary, p_Out, p_Samples, p_Underrun);
+
+  // Track gain changes are ramped over a block, starting from the gain the
+  // previous block ended with
+  const int frames = static_cast<int>(p_Samples / AudioStream::kChannels);
+  AudioStream* incoming = m_Mix.incoming.load(std::memory_order_acquire);
+  if (incoming == nullptr)
+  {
+    const float gain = primary->gain.load(std::memory_order_relaxed);
+    const float from = (m_PrimaryGain < 0.0f) ? gain : m_PrimaryGain;
+    if ((from != 1.0f) || (gain != 1.0f))
+    {
+      MixGain(p_Out, nullptr, frames, from, gain, 0.0f, 0.0f);
+    }
+
+    m_PrimaryGain = gain;
+    return;
+  }
+
+  if (m_MixBuffer.size() < p_Samples)
+  {
+    m_MixBuffer.resize(p_Samples);
+  }
+
+  ReadStream(*incoming, m_MixBuffer.data(), p_Samples, p_Underrun);
+
+  // Crossfade, with equal-power gains at block ends
+  const qint64 fadeFrames = qMax(1ll, m_Mix.fadeFrames.load(std::memory_order_acquire));
+  const qint64 fadePos = m_Mix.fadePos.load(std::memory_order_relaxed);
+  const auto fadeGains = [&](qint64 p_Pos, float& p_OutGain, float& p_InGain)
+  {
+    const float t = static_cast<float>(qMin(p_Pos, fadeFrames)) / fadeFrames;
+    p_OutGain = primary->gain.load(std::memory_order_relaxed) * cosf(t * static_cast<float>(M_PI_2));
+    p_InGain = incoming->gain.load(std::memory_order_relaxed) * sinf(t * static_cast<float>(M_PI_2));
+  };
+
+  float outFrom = 0.0f;
+  float inFrom = 0.0f;
+  fadeGains(fadePos, outFrom, inFrom);
+  if ((m_PrimaryGain >= 0.0f) && (m_IncomingGain >= 0.0f))
+  {
+    outFrom = m_PrimaryGain;
+    inFrom = m_IncomingGain;
+  }
+
+  float outTo = 0.0f;
+  float inTo = 0.0f;
+  fadeGains(fadePos + frames, outTo, inTo);
+  MixGain(p_Out, m_MixBuffer.data(), frames, outFrom, outTo, inFrom, inTo);
+
+  if (m_Mix.tapEnabled.load(std::memory_order_relaxed))
+  {
+    const qint64 tapFrames = qBound(0ll, fadeFrames - fadePos, static_cast<qint64>(frames));
+    m_Mix.tap.Write(p_Out, tapFrames * AudioStream::kChannels);
+  }
+
+  m_Mix.fadePos.store(fadePos + frames, std::memory_order_release);
+  if ((fadePos + frames) >= fadeFrames)
+  {
+    // Incoming stream takes over
+    m_PrimaryGain = inTo;
+    m_IncomingGain = -1.0f;
+    m_Mix.primary.store(incoming, std::memory_order_release);
+    m_Mix.incoming.store(nullptr, std::memory_order_release);
+  }
+  else
+  {
+    m_PrimaryGain = outTo;
+    m_IncomingGain = inTo;
+  }
+}
+
+void AudioSinkDevice::SetReplay(const std::vector<float>& p_Samples)
+{
+  // Counted as delivered when handed over, as the audio was read from the
+  // stream before, and is unplayed until the sink has processed it
+  m_Replay = p_Samples;
+  m_ReplayPos = 0;
+  m_FramesDelivered.fetch_add(m_Replay.size() / AudioStream::kChannels, std::memory_order_release);
+}
+
+qint64 AudioSinkDevice::FramesDelivered() const
+{
+  return m_FramesDelivered.load(std::memory_order_acquire);
+}
+
+std::vector<float> AudioSinkDevice::LastDelivered(qint64 p_Frames) const
+{
+  const qint64 maxFrames = std::min<qint64>(m_HistoryFrames, m_History.size() / AudioStream::kChannels);
+  const size_t count = std::clamp<qint64>(p_Frames, 0, maxFrames) * AudioStream::kChannels;
+  std::vector<float> samples(count);
+  size_t pos = (m_HistoryPos + m_History.size() - count) % m_History.size();
+  for (size_t i = 0; i < count; ++i)
+  {
+    samples[i] = m_History[pos];
+    pos = (pos + 1) % m_History.size();
+  }
+
+  return samples;
+}
+
+AudioDecodeWorker::AudioDecodeWorker(AudioStream& p_Stream)
+  : m_Stream(p_Stream)
+{
+  m_RetryTimer = new QTimer(this);
+  m_RetryTimer->setSingleShot(true);
+  m_RetryTimer->setInterval(kRetryIntervalMs);
+  connect(m_RetryTimer, &QTimer::timeout, this, &AudioDecodeWorker::ProcessPending);
+}
+
+void AudioDecodeWorker::Start(const QString& p_Track, int p_Serial, qint64 p_StartMs, qint64 p_DurationMs,
+                              const QAudioFormat& p_Format, qint64 p_SkipFrames)
+{
+  // Decoder is created on first use so that it lives in the worker thread
+  if (m_Decoder == nullptr)
+  {
+    m_Decoder = new QAudioDecoder(this);
+    connect(m_Decoder, &QAudioDecoder::bufferReady, this, &AudioDecodeWorker::OnBufferReady);
+    connect(m_Decoder, &QAudioDecoder::finished, this, &AudioDecodeWorker::OnFinished);
+    connect(m_Decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+            this, &AudioDecodeWorker::OnError);
+    connect(m_Decoder, &QAudioDecoder::durationChanged, this, [this](qint64 p_DecoderDurationMs)
+    {
+      // Decoding started mid-file only knows the duration of the remainder
+      if (m_Device == nullptr)
+      {
+        emit DurationChanged(m_Serial, p_DecoderDurationMs);
+      }
+    });
+  }
+
+  Stop();
+  m_Format = p_Format;
+  m_Serial = p_Serial;
+  OpenTrack(p_Track, p_StartMs, p_DurationMs);
+  m_SkipFrames += p_SkipFrames;
+}
+
+void AudioDecodeWorker::Stop()
+{
+  CloseTrack();
+  m_RetryTimer->stop();
+  m_Pending.clear();
+  m_PendingPos = 0;
+}
+
+void AudioDecodeWorker::SetTapEnabled(bool p_Enabled)
+{
+  m_TapEnabled = p_Enabled;
+}
+
+void AudioDecodeWorker::ProcessPending()
+{
+  // Hand over decoded audio until the ring is full, leaving further decoder
+  // buffers unread (which in turn throttles the decoder) until sink catches up.
+  while (true)
+  {
+    if (!FlushPending())
+    {
+      m_RetryTimer->start();
+      return;
+    }
+
+    if ((m_Decoder == nullptr) || !m_Decoder->bufferAvailable())
+    {
+      if (m_DecoderFinished && !AdvanceTrack())
+      {
+        m_RetryTimer->start();
+      }
+
+      return;
+    }
+
+    ConvertBuffer(m_Decoder->read());
+  }
+}
+
+void AudioDecodeWorker::OnBufferReady()
+{
+  ProcessPending();
+}
+
+void AudioDecodeWorker::OnFinished()
+{
+  m_DecoderFinished = true;
+  ProcessPending();
+}
+
+void AudioDecodeWorker::OnError(QAudioDecoder::Error p_Error)
+{
+  Log::Warning("Decoder error %d: %s", static_cast<int>(p_Error),
+               m_Decoder->errorString().toStdString().c_str());
+  emit DecodeError(m_Serial, m_Decoder->errorString());
+  m_DecoderFinished = true;
+  ProcessPending();
+}
+
+void AudioDecodeWorker::OpenTrack(const QString& p_Track, qint64 p_StartMs, qint64 p_DurationMs)
+{
+  m_TimeOffsetMs = 0;
+  m_SkipUntilMs = 0;
+  m_SkipFrames = 0;
+  m_SkipSamples = 0;
+  m_SkipSampleRate = 0;
+  m_DecoderFinished = false;
+  m_RateWarned = false;
+  m_Decoder->setAudioFormat(m_Format);
+
+  // QAudioDecoder cannot seek, so for mp3 decoding starts from a frame near
+  // the requested position, and for other formats audio before it is dropped.
+  // Indexed mp3 tracks start at an exact frame, dropping decoded audio before
+  // the position (or from the start, if the position is within the first
+  // frames), and others at a frame estimated assuming constant bitrate.
+  Mp3Index index;
+  qint64 offset = -1;
+  qint64 skipSamples = 0;
+  qint64 timeOffsetMs = p_StartMs;
+  if ((p_StartMs > 0) && index.Open(Mp3Index::Key(p_Track)))
+  {
+    if (index.Find(p_StartMs, offset, skipSamples))
+    {
+      timeOffsetMs = p_StartMs - ((skipSamples * 1000) / index.SampleRate());
+    }
+  }
+  else
+  {
+    offset = Mp3Util::EstimateOffset(p_Track, p_StartMs, p_DurationMs);
+  }
+
+  if (offset > 0)
+  {
+    m_Device = new FileRangeDevice(p_Track, offset, this);
+    if (m_Device->open(QIODevice::ReadOnly))
+    {
+      m_TimeOffsetMs = timeOffsetMs;
+      m_SkipSamples = skipSamples;
+      m_SkipSampleRate = index.SampleRate();
+      m_Decoder->setSourceDevice(m_Device);
+    }
+    else
+    {
+      delete m_Device;
+      m_Device = nullptr;
+    }
+  }
+
+  if (m_Device == nullptr)
+  {
+    m_SkipUntilMs = p_StartMs;
+    m_Decoder->setSource(QUrl::fromLocalFile(p_Track));
+  }
+
+  m_Decoder->start();
+}
+
+void AudioDecodeWorker::CloseTrack()
+{
+  if (m_Decoder != nullptr)
+  {
+    m_Decoder->stop();
+  }
+
+  if (m_Device != nullptr)
+  {
+    m_Decoder->setSourceDevice(nullptr);
+    delete m_Device;
+    m_Device = nullptr;
+  }
+
+  m_DecoderFinished = false;
+}
+
+bool AudioDecodeWorker::AdvanceTrack()
+{
+  QString track;
+  {
+    QMutexLocker locker(&m_Stream.mutex);
+
+    // Previous transition not yet reached by playback (very short track)
+    if (m_Stream.boundaryFrame.load() >= 0) return false;
+
+    if (m_Stream.nextTrack.isEmpty())
+    {
+      m_Stream.finished.store(true, std::memory_order_release);
+      return true;
+    }
+
+    track = m_Stream.nextTrack;
+    m_Serial = m_Stream.nextSerial;
+    m_Stream.nextTrack.clear();
+    m_Stream.boundaryTrack = track;
+    m_Stream.boundarySerial = m_Serial;
+    m_Stream.finished.store(false, std::memory_order_release);
+    m_Stream.boundaryFrame.store(m_Stream.framesWritten.load());
+  }
+
+  // Continue directly after the last frame of the previous track
+  Log::Debug("Decoding queued track=%s", track.toStdString().c_str());
+  CloseTrack();
+  OpenTrack(track, 0, 0);
+  return true;
+}
+
+void AudioDecodeWorker::ConvertBuffer(const QAudioBuffer& p_Buffer)
+{
+  if (!p_Buffer.isValid()) return;
+
+  const QAudioFormat fmt = p_Buffer.format();
+  const int channels = fmt.channelCount();
+  const int sampleRate = fmt.sampleRate();
+  const int frames = p_Buffer.frameCount();
+  if ((channels <= 0) || (sampleRate <= 0) || (frames <= 0)) return;
+
+  if ((sampleRate != m_Format.sampleRate()) && !m_RateWarned)
+  {
+    Log::Warning("Decoder output %d Hz differs from device %d Hz", sampleRate, m_Format.sampleRate());
+    m_RateWarned = true;
+  }
+
+  // Drop audio before requested start position
+  const qint64 startUs = (m_TimeOffsetMs * 1000) + p_Buffer.startTime();
+  const qint64 skipUs = (m_SkipUntilMs * 1000) - startUs;
+  int skip = (skipUs > 0) ? static_cast<int>(qMin<qint64>(frames, (skipUs * sampleRate) / 1000000)) : 0;
+
+  // Drop audio before an indexed start position, counted in samples at the
+  // track rate, at the rate the decoder actually outputs
+  if (m_SkipSamples > 0)
+  {
+    m_SkipFrames += (m_SkipSamples * sampleRate) / m_SkipSampleRate;
+    m_SkipSamples = 0;
+  }
+
+  // Drop audio already played from a cached head, counted in frames to
+  // continue exactly where it ends
+  if (m_SkipFrames > 0)
+  {
+    const int headSkip = static_cast<int>(qMin<qint64>(frames, m_SkipFrames));
+    m_SkipFrames -= headSkip;
+    skip = qMax(skip, headSkip);
+  }
+
+  if (skip >= frames) return;
+
+  const size_t offset = m_Pending.size();
+  const int count = AppendStereo(p_Buffer, skip, frames - skip, m_Pending);
+  if (count == 0) return;
+
+  const float* out = m_Pending.data() + offset;
+  if (m_TapEnabled)
+  {
+    QAudioFormat tapFormat = m_Format;
+    tapFormat.setSampleRate(sampleRate);
+    const QByteArray data(reinterpret_cast<const char*>(out), count * AudioStream::kChannels * sizeof(float));
+    emit BufferDecoded(m_Serial, QAudioBuffer(data, tapFormat, startUs + ((skip * 1000000ll) / sampleRate)));
+  }
+}
+
+bool AudioDecodeWorker::FlushPending()
+{
+  const size_t remaining = m_Pending.size() - m_PendingPos;
+  if (remaining > 0)
+  {
+    // Only whole frames, so that the sink never reads half a frame
+    size_t count = std::min(remaining, m_Stream.ring.Free());
+    count -= count % AudioStream::kChannels;
+
+    const size_t written = m_Stream.ring.Write(m_Pending.data() + m_PendingPos, count);
+    m_PendingPos += written;
+    m_Stream.framesWritten.fetch_add(written / AudioStream::kChannels, std::memory_order_release);
+  }
+
+  if (m_PendingPos < m_Pending.size()) return false;
+
+  m_Pending.clear();
+  m_PendingPos = 0;
+  return true;
+}
+
+HeadDecodeWorker::HeadDecodeWorker()
+{
+}
+
+void HeadDecodeWorker::SetTracks(const QStringList& p_Tracks, const QAudioFormat& p_Format, int p_Frames)
+{
+  // Decoder is created on first use so that it lives in the worker thread
+  if (m_Decoder == nullptr)
+  {
+    m_Decoder = new QAudioDecoder(this);
+    connect(m_Decoder, &QAudioDecoder::bufferReady, this, &HeadDecodeWorker::OnBufferReady);
+    connect(m_Decoder, &QAudioDecoder::finished, this, &HeadDecodeWorker::OnFinished);
+    connect(m_Decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+            this, &HeadDecodeWorker::OnError);
+  }
+
+  const bool formatChanged = (p_Format != m_Format) || (p_Frames != m_Frames);
+  m_Tracks = p_Tracks;
+  m_Format = p_Format;
+  m_Frames = p_Frames;
+
+  // Track being decoded is finished first if still wanted
+  if (!m_Track.isEmpty())
+  {
+    if (!formatChanged && (m_Tracks.removeAll(m_Track) > 0)) return;
+
+    m_Decoder->stop();
+    m_Track.clear();
+  }
+
+  DecodeNext();
+}
+
+void HeadDecodeWorker::OnBufferReady()
+{
+  while (!m_Track.isEmpty() && m_Decoder->bufferAvailable())
+  {
+    const QAudioBuffer buffer = m_Decoder->read();
+    if (!buffer.isValid()) continue;
+
+    m_SampleRate = buffer.format().sampleRate();
+    const int frames = static_cast<int>(m_Samples.size() / AudioStream::kChannels);
+    AppendStereo(buffer, 0, m_Frames - frames, m_Samples);
+    if ((m_Samples.size() / AudioStream::kChannels) >= static_cast<size_t>(m_Frames))
+    {
+      FinishHead();
+    }
+  }
+}
+
+void HeadDecodeWorker::OnFinished()
+{
+  // Track shorter than a head
+  if (m_Track.isEmpty()) return;
+
+  FinishHead();
+}
+
+void HeadDecodeWorker::OnError(QAudioDecoder::Error p_Error)
+{
+  Log::Debug("Head decoder error %d: %s track=%s", static_cast<int>(p_Error),
+             m_Decoder->errorString().toStdString().c_str(), m_Track.toStdString().c_str());
+  m_Decoder->stop();
+  m_Track.clear();
+  QMetaObject::invokeMethod(this, [this]()
+  {
+    DecodeNext();
+  }, Qt::QueuedConnection);
+}
+
+void HeadDecodeWorker::DecodeNext()
+{
+  if (!m_Track.isEmpty() || m_Tracks.isEmpty()) return;
+
+  m_Track = m_Tracks.takeFirst();
+  m_SampleRate = 0;
+  m_Samples.clear();
+  m_Decoder->setAudioFormat(m_Format);
+  m_Decoder->setSource(QUrl::fromLocalFile(m_Track));
+  m_Decoder->start();
+}
+
+void HeadDecodeWorker::FinishHead()
+{
+  const QByteArray samples(reinterpret_cast<const char*>(m_Samples.data()), m_Samples.size() * sizeof(float));
+  emit HeadDecoded(m_Track, m_SampleRate, samples);
+
+  // Next track is started from the event loop, not from within decoder signals
+  m_Decoder->stop();
+  m_Track.clear();
+  m_Samples.clear();
+  QMetaObject::invokeMethod(this, [this]()
+  {
+    DecodeNext();
+  }, Qt::QueuedConnection);
+}
+
+AudioEngine::AudioEngine(QObject* p_Parent)
+  : QObject(p_Parent)
+  , m_Streams{ { kRingSamples }, { kRingSamples } }
+  , m_Mix(kFadeTapSamples)
+{
+  m_Stream = &m_Streams[0];
+  m_FadeStream = &m_Streams[1];
+  m_Mix.primary.store(m_Stream);
+
+  // Decoders of both decks share a thread
+  m_Worker = new AudioDecodeWorker(*m_Stream);
+  m_FadeWorker = new AudioDecodeWorker(*m_FadeStream);
+  for (AudioDecodeWorker* worker : { m_Worker, m_FadeWorker })
+  {
+    worker->moveToThread(&m_Thread);
+    connect(&m_Thread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &AudioDecodeWorker::DurationChanged, this, &AudioEngine::OnDurationChanged);
+    connect(worker, &AudioDecodeWorker::BufferDecoded, this, &AudioEngine::OnBufferDecoded);
+    connect(worker, &AudioDecodeWorker::DecodeError, this, &AudioEngine::OnDecodeError);
+  }
+
+  m_Thread.start();
+
+  m_HeadWorker = new HeadDecodeWorker();
+  m_HeadWorker->moveToThread(&m_HeadThread);
+  connect(&m_HeadThread, &QThread::finished, m_HeadWorker, &QObject::deleteLater);
+  connect(m_HeadWorker, &HeadDecodeWorker::HeadDecoded, this, &AudioEngine::OnHeadDecoded);
+  m_HeadThread.start(QThread::LowPriority);
+
+  m_IndexWorker = new Mp3IndexWorker();
+  m_IndexWorker->moveToThread(&m_IndexThread);
+  connect(&m_IndexThread, &QThread::finished, m_IndexWorker, &QObject::deleteLater);
+  m_IndexThread.start(QThread::LowestPriority);
+
+  m_Device = QMediaDevices::defaultAudioOutput();
+  m_Format = SinkFormat(m_Device);
+
+  m_Timer.setInterval(kTimerIntervalMs);
+  connect(&m_Timer, &QTimer::timeout, this, &AudioEngine::OnTimer);
+}
+
+AudioEngine::~AudioEngine()
+{
+  StopSink();
+  StopDecoding();
+  m_Thread.quit();
+  m_Thread.wait();
+  m_HeadThread.quit();
+  m_HeadThread.wait();
+  m_IndexThread.requestInterruption();
+  m_IndexThread.quit();
+  m_IndexThread.wait();
+}
+
+QString AudioEngine::Source() const
+{
+  return m_Track;
+}
+
+qint64 AudioEngine::Position() const
+{
+  return m_PositionMs;
+}
+
+qint64 AudioEngine::Duration() const
+{
+  return m_DurationMs;
+}
+
+bool AudioEngine::IsPlaying() const
+{
+  return m_Playing;
+}
+
+bool AudioEngine::IsStopped() const
+{
+  return !m_Decoding;
+}
+
+void AudioEngine::SetSource(const QString& p_Track)
+{
+  StopSink();
+  StopDecoding();
+  SetPlaying(false);
+  m_SinkPending = false;
+  m_Track = p_Track;
+  m_Serial = ++m_LastSerial;
+  m_DurationMs = 0;
+  m_PositionMs = 0;
+  m_NextDurations.clear();
+  {
+    QMutexLocker locker(&m_Stream->mutex);
+    m_Stream->nextTrack.clear();
+    m_Stream->boundaryTrack.clear();
+    m_Stream->boundaryFrame.store(-1);
+  }
+
+  if (!m_Track.isEmpty())
+  {
+    StartDecoding(0);
+  }
+
+  UpdateIndexTracks();
+
+  emit DurationChanged(m_DurationMs);
+  emit PositionChanged(m_PositionMs);
+}
+
+void AudioEngine::SetNextSource(const QString& p_Track)
+{
+  {
+    QMutexLocker locker(&m_Stream->mutex);
+
+    // Too late to change once decoding has moved on to the queued track
+    if (m_Stream->boundaryFrame.load() >= 0) return;
+    if (m_Stream->nextTrack == p_Track) return;
+
+    // With crossfade the next track is decoded on the other deck, unless the
+    // current track is too short to fade out of, or still fading in
+    const bool crossfade = (m_CrossfadeMs > 0) && !m_Fading && (m_DurationMs > (2 * m_CrossfadeMs));
+    if (crossfade && m_Stream->nextTrack.isEmpty())
+    {
+      locker.unlock();
+      PrepareFade(p_Track);
+      return;
+    }
+
+    m_Stream->nextTrack = p_Track;
+    m_Stream->nextSerial = ++m_LastSerial;
+  }
+
+  // Decoder may already have reached end of current track
+  if (m_Decoding)
+  {
+    QMetaObject::invokeMethod(m_Worker, "ProcessPending", Qt::QueuedConnection);
+  }
+}
+
+void AudioEngine::Play()
+{
+  if (m_Track.isEmpty()) return;
+
+  if (!m_Decoding)
+  {
+    StartDecoding(m_PositionMs);
+  }
+
+  if (m_Sink)
+  {
+    m_Sink->resume();
+  }
+  else
+  {
+    // Sink is started once enough audio is buffered
+    m_SinkPending = true;
+  }
+
+  SetPlaying(true);
+  StartSinkIfReady();
+}
+
+void AudioEngine::Pause()
+{
+  if (m_Sink)
+  {
+    m_Sink->suspend();
+  }
+
+  m_SinkPending = false;
+  SetPlaying(false);
+}
+
+void AudioEngine::Stop()
+{
+  StopSink();
+  StopDecoding();
+  m_SinkPending = false;
+  m_PositionMs = 0;
+  SetPlaying(false);
+  emit PositionChanged(m_PositionMs);
+}
+
+void AudioEngine::SetPosition(qint64 p_PositionMs)
+{
+  if (m_Track.isEmpty()) return;
+
+  StopSink();
+  StopDecoding();
+  StartDecoding(qMax(0ll, p_PositionMs));
+  m_SinkPending = m_Playing;
+  emit PositionChanged(m_PositionMs);
+}
+
+void AudioEngine::SetVolume(float p_Volume)
+{
+  m_Volume = p_Volume;
+  if (m_Sink)
+  {
+    m_Sink->setVolume(m_Volume);
+  }
+}
+
+void AudioEngine::SetTrackGain(float p_Gain)
+{
+  // Applied per stream, so that each track keeps its gain during a crossfade
+  m_Stream->gain.store(p_Gain);
+}
+
+void AudioEngine::SetCrossfade(qint64 p_DurationMs)
+{
+  m_CrossfadeMs = p_DurationMs;
+
+  // A crossfade in progress plays out, one prepared is dropped
+  if ((m_CrossfadeMs == 0) && !m_Fading)
+  {
+    StopFade();
+  }
+}
+
+void AudioEngine::SetDevice(const QAudioDevice& p_Device)
+{
+  // Only the sink is re-bound, with decoder and buffered audio kept, and the
+  // new sink starts with what the old one had buffered but not yet played
+  qint64 playedFrames = 0;
+  std::vector<float> unplayed = TakeUnplayed(playedFrames);
+  StopSink();
+  m_Device = p_Device;
+
+  // Current rate is kept if the new device supports it
+  const QAudioFormat format = SinkFormat(p_Device, m_Format.sampleRate());
+  const bool rateChanged = (format.sampleRate() != m_Format.sampleRate());
+  if (rateChanged && m_Decoding)
+  {
+    // Buffered audio is at the previous rate, decode again from the last
+    // played position
+    const qint64 positionMs =
+      m_TrackStartMs + (qMax(0ll, playedFrames - m_TrackStartFrame) * 1000) / m_Format.sampleRate();
+    Log::Info("Output rate changed %d -> %d, decoding again from %lld ms",
+              m_Format.sampleRate(), format.sampleRate(), positionMs);
+    m_Format = format;
+    StopDecoding();
+    StartDecoding(positionMs);
+  }
+  else
+  {
+    m_Format = format;
+    if (!rateChanged)
+    {
+      m_Replay = std::move(unplayed);
+
+      // Audio delivered to the old sink less what the new one replays is
+      // what the old device played, so the position carries over unchanged
+      // unless the unplayed audio exceeded the kept history
+      const qint64 resumedFrames = PlayedFrames();
+      if (resumedFrames != playedFrames)
+      {
+        Log::Warning("Device switch resumes at frame %lld, played %lld", resumedFrames, playedFrames);
+      }
+    }
+  }
+
+  m_SinkPending = m_Playing;
+}
+
+void AudioEngine::SetTapEnabled(bool p_Enabled)
+{
+  m_TapEnabled = p_Enabled;
+  m_Mix.tapEnabled.store(p_Enabled);
+  m_NextBuffers.clear();
+
+  for (AudioDecodeWorker* worker : { m_Worker, m_FadeWorker })
+  {
+    QMetaObject::invokeMethod(worker, [worker, p_Enabled]()
+    {
+      worker->SetTapEnabled(p_Enabled);
+    }, Qt::QueuedConnection);
+  }
+}
+
+void AudioEngine::SetEqualizer(const QVector<float>& p_GainsDb)
+{
+  m_Equalizer.SetGains(p_GainsDb);
+}
+
+void AudioEngine::SetSpeed(float p_Speed)
+{
+  m_TimeStretch.SetSpeed(p_Speed);
+}
+
+void AudioEngine::SetHeadTracks(const QStringList& p_Tracks)
+{
+  m_HeadTracks = p_Tracks;
+
+  // Heads of tracks no longer among the candidates are released
+  for (auto it = m_Heads.begin(); it != m_Heads.end();)
+  {
+    if (!p_Tracks.contains(it.key()) || (it.value().sampleRate != m_Format.sampleRate()))
+    {
+      it = m_Heads.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  QStringList tracks;
+  for (const QString& track : p_Tracks)
+  {
+    if (!track.isEmpty() && !m_Heads.contains(track) && !tracks.contains(track))
+    {
+      tracks << track;
+    }
+  }
+
+  // Heads are limited to half the ring, to leave room for the decoder
+  QAudioFormat decodeFormat = m_Format;
+  decodeFormat.setSampleFormat(QAudioFormat::Float);
+  const int frames = static_cast<int>(qMin<qint64>((kHeadMs * m_Format.sampleRate()) / 1000,
+                                                   kRingSamples / AudioStream::kChannels / 2));
+  HeadDecodeWorker* worker = m_HeadWorker;
+  QMetaObject::invokeMethod(m_HeadWorker, [worker, tracks, decodeFormat, frames]()
+  {
+    worker->SetTracks(tracks, decodeFormat, frames);
+  }, Qt::QueuedConnection);
+
+  UpdateIndexTracks();
+}
+
+void AudioEngine::UpdateIndexTracks()
+{
+  // Current track first, as it is the one most likely to be seeked in
+  QStringList tracks;
+  for (const QString& track : QStringList(m_Track) + m_HeadTracks)
+  {
+    if (Mp3Util::IsMp3(track) && !tracks.contains(track))
+    {
+      tracks << track;
+    }
+  }
+
+  Mp3IndexWorker* worker = m_IndexWorker;
+  QMetaObject::invokeMethod(m_IndexWorker, [worker, tracks]()
+  {
+    worker->SetTracks(tracks);
+  }, Qt::QueuedConnection);
+}
+
+void AudioEngine::OnTimer()
+{
+  StartSinkIfReady();
+  CheckBoundary();
+  StartFadeIfReady();
+  if (m_Fading)
+  {
+    DrainFadeTap();
+    if (m_Mix.incoming.load(std::memory_order_acquire) == nullptr)
+    {
+      // Outgoing track has played out
+      StopFade();
+    }
+  }
+
+  UpdateStats();
+
+  m_PositionMs =
+    m_TrackStartMs + ((qMax(0ll, PlayedFrames() - m_TrackStartFrame) * 1000) / m_Format.sampleRate());
+  if (m_Playing)
+  {
+    emit PositionChanged(m_PositionMs);
+  }
+
+  bool ended = false;
+  {
+    QMutexLocker locker(&m_Stream->mutex);
+    ended = m_Stream->finished.load() && m_Stream->nextTrack.isEmpty() &&
+      (m_Stream->framesRead.load() >= m_Stream->framesWritten.load());
+  }
+
+  if (!ended) return;
+
+  // Let the sink play out what it has buffered before stopping it
+  if (!m_DrainTimer.isValid())
+  {
+    m_DrainTimer.start();
+  }
+
+  const qint64 stretchMs = ((m_TimeStretch.PendingFrames() * 1000) / m_Format.sampleRate()) / m_TimeStretch.Speed();
+  const qint64 drainMs = m_Sink ? ((m_Format.durationForBytes(m_Sink->bufferSize()) / 1000) + stretchMs) : 0;
+  if (m_DrainTimer.elapsed() < drainMs) return;
+
+  StopSink();
+  StopDecoding();
+  m_SinkPending = false;
+  SetPlaying(false);
+  emit EndOfMedia();
+}
+
+void AudioEngine::StartSinkIfReady()
+{
+  if (!m_SinkPending) return;
+
+  const qint64 bufferedMs = ((m_Stream->ring.Size() / AudioStream::kChannels) * 1000) / m_Format.sampleRate();
+  if ((bufferedMs >= kPrefillMs) || m_Stream->finished.load())
+  {
+    m_SinkPending = false;
+    StartSink();
+  }
+}
+
+void AudioEngine::UpdateStats()
+{
+  const int underruns = m_Mix.underruns.load();
+  if (underruns != m_LastUnderruns)
+  {
+    PlaybackStats::Record(PlaybackStats::Underrun, m_Track, underruns - m_LastUnderruns);
+    m_LastUnderruns = underruns;
+  }
+
+  float load = 0.0f;
+  if (m_Equalizer.TakeLoad(load))
+  {
+    PlaybackStats::SetDspLoad(load);
+    if (load > kMaxEqualizerLoad)
+    {
+      PlaybackStats::Record(PlaybackStats::DspOverload, QString("equalizer %1%").arg(load * 100.0f, 0, 'f', 2));
+    }
+  }
+
+  if (m_Sink)
+  {
+    PlaybackStats::SetOutputLatency((LatencyFrames() * 1000) / m_Format.sampleRate());
+  }
+
+  // Count each time the decoder falls behind a running sink, once until the
+  // ring has recovered
+  if (!m_Playing || m_SinkPending || m_Stream->finished.load())
+  {
+    m_Stalled = false;
+    return;
+  }
+
+  const qint64 bufferedMs = ((m_Stream->ring.Size() / AudioStream::kChannels) * 1000) / m_Format.sampleRate();
+  if (!m_Stalled && (bufferedMs < kStallMs))
+  {
+    m_Stalled = true;
+    PlaybackStats::Record(PlaybackStats::DecoderStall, m_Track);
+  }
+  else if (m_Stalled && (bufferedMs >= kPrefillMs))
+  {
+    m_Stalled = false;
+  }
+}
+
+void AudioEngine::OnDurationChanged(int p_Serial, qint64 p_DurationMs)
+{
+  if (p_Serial == m_Serial)
+  {
+    m_DurationMs = p_DurationMs;
+    emit DurationChanged(m_DurationMs);
+  }
+  else
+  {
+    m_NextDurations.insert(p_Serial, p_DurationMs);
+  }
+}
+
+void AudioEngine::OnBufferDecoded(int p_Serial, const QAudioBuffer& p_Buffer)
+{
+  if (!m_TapEnabled) return;
+
+  if (p_Serial == m_Serial)
+  {
+    // Start of a crossfaded track is tapped from the mix instead
+    if (p_Buffer.startTime() < m_FadeTapUs) return;
+
+    emit AudioBufferReady(p_Buffer);
+  }
+  else if ((p_Serial > m_Serial) && (m_NextBuffers.size() < kMaxNextBuffers))
+  {
+    m_NextBuffers.append(qMakePair(p_Serial, p_Buffer));
+  }
+}
+
+void AudioEngine::OnDecodeError(int p_Serial, const QString& p_ErrorString)
+{
+  if (p_Serial != m_Serial) return;
+
+  emit ErrorOccurred(p_ErrorString);
+}
+
+void AudioEngine::OnHeadDecoded(const QString& p_Track, int p_SampleRate, const QByteArray& p_Samples)
+{
+  if (!m_HeadTracks.contains(p_Track) || (p_SampleRate != m_Format.sampleRate())) return;
+
+  qint64 bytes = p_Samples.size();
+  for (const AudioHead& head : m_Heads)
+  {
+    bytes += head.samples.size();
+  }
+
+  if (bytes > kMaxHeadBytes)
+  {
+    Log::Debug("Head cache full, skipping track=%s", p_Track.toStdString().c_str());
+    return;
+  }
+
+  AudioHead head;
+  head.sampleRate = p_SampleRate;
+  head.samples = p_Samples;
+  m_Heads.insert(p_Track, head);
+}
+
+void AudioEngine::StartDecoding(qint64 p_PositionMs)
+{
+  // Decoder and sink are both stopped here, so the stream can be reset
+  m_Stream->Reset();
+  m_Mix.primary.store(m_Stream);
+  {
+    // A queued track that decoding had already moved on to is queued again
+    QMutexLocker locker(&m_Stream->mutex);
+    if (m_Stream->boundaryFrame.load() >= 0)
+    {
+      m_Stream->nextTrack = m_Stream->boundaryTrack;
+      m_Stream->nextSerial = m_Stream->boundarySerial;
+      m_Stream->boundaryTrack.clear();
+      m_Stream->boundaryFrame.store(-1);
+    }
+  }
+
+  m_TrackStartMs = p_PositionMs;
+  m_TrackStartFrame = 0;
+  m_PositionMs = p_PositionMs;
+  m_FadeTapUs = 0;
+  m_NextBuffers.clear();
+  m_Replay.clear();
+  m_TimeStretch.Reset();
+  m_DrainTimer.invalidate();
+  m_Decoding = true;
+
+  // Playback from start can begin with a cached head, while the decoder
+  // starts up and continues after it
+  const qint64 skipFrames = (p_PositionMs == 0) ? WriteHead() : 0;
+
+  QAudioFormat decodeFormat = m_Format;
+  decodeFormat.setSampleFormat(QAudioFormat::Float);
+  AudioDecodeWorker* worker = m_Worker;
+  const QString track = m_Track;
+  const int serial = m_Serial;
+  const qint64 durationMs = m_DurationMs;
+  QMetaObject::invokeMethod(m_Worker, [worker, track, serial, p_PositionMs, durationMs, decodeFormat, skipFrames]()
+  {
+    worker->Start(track, serial, p_PositionMs, durationMs, decodeFormat, skipFrames);
+  }, Qt::QueuedConnection);
+
+  m_Timer.start();
+}
+
+qint64 AudioEngine::WriteHead()
+{
+  auto it = m_Heads.constFind(m_Track);
+  if ((it == m_Heads.constEnd()) || (it.value().sampleRate != m_Format.sampleRate())) return 0;
+
+  // Worker is stopped, so the ring can be written from here until it is
+  // started again
+  const QByteArray& samples = it.value().samples;
+  size_t count = std::min(samples.size() / sizeof(float), m_Stream->ring.Free());
+  count -= count % AudioStream::kChannels;
+  const size_t written = m_Stream->ring.Write(reinterpret_cast<const float*>(samples.constData()), count);
+  const qint64 frames = written / AudioStream::kChannels;
+  m_Stream->framesWritten.fetch_add(frames, std::memory_order_release);
+  Log::Debug("Starting from cached head, %lld frames track=%s", frames, m_Track.toStdString().c_str());
+
+  if (m_TapEnabled)
+  {
+    QAudioFormat tapFormat = m_Format;
+    tapFormat.setSampleFormat(QAudioFormat::Float);
+    emit AudioBufferReady(QAudioBuffer(samples.left(written * sizeof(float)), tapFormat, 0));
+  }
+
+  return frames;
+}
+
+void AudioEngine::StopDecoding()
+{
+  if (!m_Decoding) return;
+
+  // Wait for the worker to stop writing, before the stream is reset
+  AudioDecodeWorker* worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker]()
+  {
+    worker->Stop();
+  }, Qt::BlockingQueuedConnection);
+
+  StopFade();
+  m_Decoding = false;
+  m_Timer.stop();
+}
+
+void AudioEngine::PrepareFade(const QString& p_Track)
+{
+  if (p_Track == m_FadeTrack) return;
+
+  // Next track is decoded ahead on the other deck, for the crossfade to
+  // start with its audio buffered
+  StopFade();
+  m_FadeTrack = p_Track;
+  m_FadeSerial = ++m_LastSerial;
+  m_FadeStream->gain.store(1.0f);
+
+  QAudioFormat decodeFormat = m_Format;
+  decodeFormat.setSampleFormat(QAudioFormat::Float);
+  AudioDecodeWorker* worker = m_FadeWorker;
+  const int serial = m_FadeSerial;
+  QMetaObject::invokeMethod(m_FadeWorker, [worker, p_Track, serial, decodeFormat]()
+  {
+    worker->Start(p_Track, serial, 0, 0, decodeFormat, 0);
+  }, Qt::QueuedConnection);
+}
+
+void AudioEngine::StartFadeIfReady()
+{
+  if (m_FadeTrack.isEmpty() || m_Fading || !m_Sink || m_SinkPending) return;
+
+  // Crossfade starts when reading of the current track reaches the fade
+  // duration before its end, and is sized to end with it (or at once, if
+  // the track ended before its expected duration)
+  const int sampleRate = m_Format.sampleRate();
+  const qint64 readMs =
+    m_TrackStartMs + ((qMax(0ll, m_Stream->framesRead.load() - m_TrackStartFrame) * 1000) / sampleRate);
+  const bool ended = m_Stream->finished.load() && (m_Stream->framesRead.load() >= m_Stream->framesWritten.load());
+  if (!ended && ((m_DurationMs <= 0) || (readMs < (m_DurationMs - m_CrossfadeMs)))) return;
+
+  // Incoming track is to begin without an underrun
+  const qint64 bufferedMs = ((m_FadeStream->ring.Size() / AudioStream::kChannels) * 1000) / sampleRate;
+  if ((bufferedMs < kPrefillMs) && !m_FadeStream->finished.load()) return;
+
+  const qint64 fadeFrames = ended ? 1 : qMax(1ll, ((m_DurationMs - readMs) * sampleRate) / 1000);
+  std::swap(m_Stream, m_FadeStream);
+  std::swap(m_Worker, m_FadeWorker);
+  m_Track = m_FadeTrack;
+  m_Serial = m_FadeSerial;
+  m_FadeTrack.clear();
+  m_TrackStartMs = 0;
+  m_TrackStartFrame = 0;
+  m_PositionMs = 0;
+  m_DurationMs = m_NextDurations.value(m_Serial, 0);
+  m_NextDurations.clear();
+  m_DrainTimer.invalidate();
+
+  // Sink device mixes in the incoming stream from here
+  m_Fading = true;
+  m_FadeTapFrames = 0;
+  m_FadeTapUs = (fadeFrames * 1000000) / sampleRate;
+  m_Mix.tap.Clear();
+  m_Mix.fadeFrames.store(fadeFrames);
+  m_Mix.fadePos.store(0);
+  m_Mix.incoming.store(m_Stream, std::memory_order_release);
+
+  Log::Debug("Crossfade %lld ms to track=%s", (fadeFrames * 1000) / sampleRate, m_Track.toStdString().c_str());
+  emit TrackAdvanced(m_Track);
+  emit DurationChanged(m_DurationMs);
+
+  // Analyzer buffers decoded ahead for the new track, following the mixed
+  // audio of the crossfade
+  for (const QPair<int, QAudioBuffer>& buffer : m_NextBuffers)
+  {
+    if ((buffer.first == m_Serial) && (buffer.second.startTime() >= m_FadeTapUs))
+    {
+      emit AudioBufferReady(buffer.second);
+    }
+  }
+
+  m_NextBuffers.clear();
+}
+
+void AudioEngine::StopFade()
+{
+  if (m_FadeTrack.isEmpty() && !m_Fading) return;
+
+  // Sink is stopped or has finished mixing the other deck at this point, so
+  // its stream can be reset once its decoder has stopped
+  AudioDecodeWorker* worker = m_FadeWorker;
+  QMetaObject::invokeMethod(m_FadeWorker, [worker]()
+  {
+    worker->Stop();
+  }, Qt::BlockingQueuedConnection);
+
+  m_FadeStream->Reset();
+  m_FadeTrack.clear();
+  m_Fading = false;
+  m_Mix.incoming.store(nullptr);
+  m_Mix.primary.store(m_Stream);
+}
+
+void AudioEngine::DrainFadeTap()
+{
+  const size_t count = m_Mix.tap.Size();
+  if (count == 0) return;
+
+  QByteArray samples(count * sizeof(float), Qt::Uninitialized);
+  m_Mix.tap.Read(reinterpret_cast<float*>(samples.data()), count);
+  if (!m_TapEnabled) return;
+
+  // Mixed audio starts at the start of the incoming track
+  QAudioFormat tapFormat = m_Format;
+  tapFormat.setSampleFormat(QAudioFormat::Float);
+  const qint64 startUs = (m_FadeTapFrames * 1000000) / m_Format.sampleRate();
+  m_FadeTapFrames += count / AudioStream::kChannels;
+  emit AudioBufferReady(QAudioBuffer(samples, tapFormat, startUs));
+}
+
+void AudioEngine::StartSink()
+{
+  if (m_Device.isNull())
+  {
+    Log::Warning("No audio output device available");
+    return;
+  }
+
+  m_TimeStretch.SetSampleRate(m_Format.sampleRate());
+  m_Equalizer.SetSampleRate(m_Format.sampleRate());
+  m_SinkDevice.reset(new AudioSinkDevice(m_Mix, m_TimeStretch, m_Equalizer, m_Format.sampleFormat()));
+  m_SinkDevice->SetReplay(m_Replay);
+  m_Replay.clear();
+  m_SinkDevice->open(QIODevice::ReadOnly);
+  m_Sink.reset(new QAudioSink(m_Device, m_Format));
+  m_Sink->setVolume(m_Volume);
+  m_Sink->start(m_SinkDevice.data());
+  if (m_Sink->error() != QAudio::NoError)
+  {
+    Log::Warning("Audio sink error %d on %s", static_cast<int>(m_Sink->error()),
+                 m_Device.description().toStdString().c_str());
+  }
+
+  // Sink was not running while paused before it was started
+  if (!m_Playing)
+  {
+    m_Sink->suspend();
+  }
+}
+
+void AudioEngine::StopSink()
+{
+  if (!m_Sink) return;
+
+  m_Sink->stop();
+  m_Sink.reset();
+  m_SinkDevice.reset();
+}
+
+void AudioEngine::SetPlaying(bool p_Playing)
+{
+  if (p_Playing == m_Playing) return;
+
+  m_Playing = p_Playing;
+  emit PlayingChanged(m_Playing);
+}
+
+void AudioEngine::CheckBoundary()
+{
+  const qint64 boundary = m_Stream->boundaryFrame.load();
+  if ((boundary < 0) || (PlayedFrames() < boundary)) return;
+
+  {
+    QMutexLocker locker(&m_Stream->mutex);
+    m_Track = m_Stream->boundaryTrack;
+    m_Serial = m_Stream->boundarySerial;
+    m_Stream->boundaryTrack.clear();
+    m_Stream->boundaryFrame.store(-1);
+  }
+
+  m_TrackStartFrame = boundary;
+  m_TrackStartMs = 0;
+  m_FadeTapUs = 0;
+  m_DurationMs = m_NextDurations.value(m_Serial, 0);
+  m_NextDurations.clear();
+
+  Log::Debug("Gapless transition to track=%s", m_Track.toStdString().c_str());
+  emit TrackAdvanced(m_Track);
+  emit DurationChanged(m_DurationMs);
+
+  // Analyzer buffers decoded ahead for the new track
+  for (const QPair<int, QAudioBuffer>& buffer : m_NextBuffers)
+  {
+    if (buffer.first == m_Serial)
+    {
+      emit AudioBufferReady(buffer.second);
+    }
+  }
+
+  m_NextBuffers.clear();
+}
+
+qint64 AudioEngine::LatencyFrames() const
+{
+  // Audio to replay on a sink not yet started
+  if (!m_Sink || !m_SinkDevice) return m_Replay.size() / AudioStream::kChannels;
+
+  // Audio delivered to the sink and not yet played. Depending on backend,
+  // processed time is either what has been played, leaving all of it in the
+  // difference, or what has been written to the backend, leaving out what
+  // the backend buffer holds (its actual fill, not its size).
+  const qint64 processedFrames = (m_Sink->processedUSecs() * m_Format.sampleRate()) / 1000000;
+  const qint64 bufferedBytes = qMax<qint64>(0, m_Sink->bufferSize() - m_Sink->bytesFree());
+  const qint64 bufferedFrames = m_Format.framesForBytes(static_cast<qint32>(bufferedBytes));
+  return qMax(m_SinkDevice->FramesDelivered() - processedFrames, bufferedFrames);
+}
+
+qint64 AudioEngine::PlayedFrames() const
+{
+  // Stream frames read lead what is heard by the input held by time
+  // stretching, and by the output latency, which is in output frames and
+  // covers more of the stream at higher speed
+  const qint64 latencyFrames = static_cast<qint64>(LatencyFrames() * m_TimeStretch.Speed());
+  return qMax(0ll, m_Stream->framesRead.load() - m_TimeStretch.PendingFrames() - latencyFrames);
+}
+
+std::vector<float> AudioEngine::TakeUnplayed(qint64& p_PlayedFrames)
+{
+  if (!m_Sink || !m_SinkDevice)
+  {
+    p_PlayedFrames = PlayedFrames();
+    return std::vector<float>();
+  }
+
+  // Audio still in the sink and backend buffers is lost when it is stopped.
+  // Sink is suspended first, so that nothing more is delivered or played
+  // while it is taken.
+  m_Sink->suspend();
+  p_PlayedFrames = PlayedFrames();
+  const qint64 unplayedFrames = LatencyFrames();
+  Log::Debug("Sink stopped with %lld frames unplayed", unplayedFrames);
+  return m_SinkDevice->LastDelivered(unplayedFrames);
+}
+
+QAudioFormat AudioEngine::SinkFormat(const QAudioDevice& p_Device, int p_SampleRate)
+{
+  QAudioFormat format = p_Device.preferredFormat();
+  if (format.sampleRate() <= 0)
+  {
+    format.setSampleRate(kDefaultSampleRate);
+  }
+
+  if (p_SampleRate > 0)
+  {
+    QAudioFormat rateFormat = format;
+    rateFormat.setSampleRate(p_SampleRate);
+    rateFormat.setChannelCount(AudioStream::kChannels);
+    rateFormat.setSampleFormat(QAudioFormat::Float);
+    if (!p_Device.isFormatSupported(rateFormat))
+    {
+      rateFormat.setSampleFormat(QAudioFormat::Int16);
+    }
+
+    if (p_Device.isFormatSupported(rateFormat)) return rateFormat;
+  }
+
+  format.setChannelCount(AudioStream::kChannels);
+  format.setSampleFormat(QAudioFormat::Float);
+  if (!p_Device.isFormatSupported(format))
+  {
+    format.setSampleFormat(QAudioFormat::Int16);
+  }
+
+  return format;
+}
+
+#endif
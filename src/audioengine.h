@@ -0,0 +1,340 @@
+// audioengine.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QtGlobal>
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <vector>
+
+#include "equalizer.h"
+#include "filerangedevice.h"
+#include "mp3index.h"
+#include "spscring.h"
+#include "timestretch.h"
+
+// PCM stream from decoder thread to audio sink, as interleaved stereo float
+// samples in a lock-free ring. Frame counters let the GUI thread derive the
+// playback position, and a boundary marks where a gaplessly queued track
+// starts in the stream.
+struct AudioStream
+{
+  static const int kChannels = 2;
+
+  AudioStream(size_t p_Capacity);
+  void Reset();
+
+  SpscRing<float> ring;
+  std::atomic<qint64> framesWritten{0};
+  std::atomic<qint64> framesRead{0};
+  std::atomic<qint64> boundaryFrame{-1};
+  std::atomic<bool> finished{false};
+  std::atomic<float> gain{1.0f};
+
+  // Track hand-over between GUI and decoder thread, guarded by mutex
+  QMutex mutex;
+  QString nextTrack;
+  int nextSerial = 0;
+  QString boundaryTrack;
+  int boundarySerial = 0;
+};
+
+// Streams read by the sink device. Outside crossfades only the primary
+// stream is played. During one the incoming stream is mixed in, with gains
+// following equal-power curves over the fade, until it takes over as primary
+// at the end of it. Mixed audio of the fade is copied to the tap ring for the
+// analyzer.
+struct AudioMix
+{
+  AudioMix(size_t p_TapCapacity);
+
+  std::atomic<AudioStream*> primary{nullptr};
+  std::atomic<AudioStream*> incoming{nullptr};
+  std::atomic<qint64> fadeFrames{0};
+  std::atomic<qint64> fadePos{0};
+  std::atomic<bool> tapEnabled{false};
+  std::atomic<int> underruns{0};
+  SpscRing<float> tap;
+};
+
+// Pull device for the audio sink, draining the mixed streams through time
+// stretching and the equalizer. Missing data is played as silence and
+// counted as an underrun.
+// Recently delivered audio is kept (before equalization), so that what a
+// stopped sink had buffered but not yet played can be replayed first on a
+// new sink.
+class AudioSinkDevice : public QIODevice
+{
+public:
+  AudioSinkDevice(AudioMix& p_Mix, TimeStretch& p_TimeStretch, Equalizer& p_Equalizer,
+                  QAudioFormat::SampleFormat p_SampleFormat, QObject* p_Parent = nullptr);
+
+  bool isSequential() const override;
+  qint64 bytesAvailable() const override;
+
+  void SetReplay(const std::vector<float>& p_Samples);
+  qint64 FramesDelivered() const;
+  std::vector<float> LastDelivered(qint64 p_Frames) const;
+
+protected:
+  qint64 readData(char* p_Data, qint64 p_MaxSize) override;
+  qint64 writeData(const char* p_Data, qint64 p_MaxSize) override;
+
+private:
+  void ReadInput(float* p_Out, size_t p_Samples, bool& p_Underrun);
+
+private:
+  AudioMix& m_Mix;
+  TimeStretch& m_TimeStretch;
+  Equalizer& m_Equalizer;
+  QAudioFormat::SampleFormat m_SampleFormat;
+  std::vector<float> m_Scratch;
+  std::vector<float> m_MixBuffer;
+  float m_PrimaryGain = -1.0f;
+  float m_IncomingGain = -1.0f;
+  std::vector<float> m_Replay;
+  size_t m_ReplayPos = 0;
+  std::vector<float> m_History;
+  size_t m_HistoryPos = 0;
+  qint64 m_HistoryFrames = 0;
+  std::atomic<qint64> m_FramesDelivered{0};
+};
+
+// Decodes tracks on a dedicated thread into the stream ring, continuing
+// directly with the next queued track at end of the current one.
+class AudioDecodeWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  AudioDecodeWorker(AudioStream& p_Stream);
+
+public slots:
+  void Start(const QString& p_Track, int p_Serial, qint64 p_StartMs, qint64 p_DurationMs,
+             const QAudioFormat& p_Format, qint64 p_SkipFrames);
+  void Stop();
+  void SetTapEnabled(bool p_Enabled);
+  void ProcessPending();
+
+signals:
+  void DurationChanged(int p_Serial, qint64 p_DurationMs);
+  void BufferDecoded(int p_Serial, const QAudioBuffer& p_Buffer);
+  void DecodeError(int p_Serial, const QString& p_ErrorString);
+
+private slots:
+  void OnBufferReady();
+  void OnFinished();
+  void OnError(QAudioDecoder::Error p_Error);
+
+private:
+  void OpenTrack(const QString& p_Track, qint64 p_StartMs, qint64 p_DurationMs);
+  void CloseTrack();
+  bool AdvanceTrack();
+  void ConvertBuffer(const QAudioBuffer& p_Buffer);
+  bool FlushPending();
+
+private:
+  AudioStream& m_Stream;
+  QAudioDecoder* m_Decoder = nullptr;
+  FileRangeDevice* m_Device = nullptr;
+  QTimer* m_RetryTimer = nullptr;
+  QAudioFormat m_Format;
+  std::vector<float> m_Pending;
+  size_t m_PendingPos = 0;
+  int m_Serial = 0;
+  qint64 m_TimeOffsetMs = 0;
+  qint64 m_SkipUntilMs = 0;
+  qint64 m_SkipFrames = 0;
+  qint64 m_SkipSamples = 0;
+  int m_SkipSampleRate = 0;
+  bool m_DecoderFinished = false;
+  bool m_TapEnabled = false;
+  bool m_RateWarned = false;
+};
+
+// Decodes the first seconds of tracks likely to be played next, on a low
+// priority thread, one track at a time.
+class HeadDecodeWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  HeadDecodeWorker();
+
+public slots:
+  void SetTracks(const QStringList& p_Tracks, const QAudioFormat& p_Format, int p_Frames);
+
+signals:
+  void HeadDecoded(const QString& p_Track, int p_SampleRate, const QByteArray& p_Samples);
+
+private slots:
+  void OnBufferReady();
+  void OnFinished();
+  void OnError(QAudioDecoder::Error p_Error);
+
+private:
+  void DecodeNext();
+  void FinishHead();
+
+private:
+  QAudioDecoder* m_Decoder = nullptr;
+  QStringList m_Tracks;
+  QString m_Track;
+  QAudioFormat m_Format;
+  int m_Frames = 0;
+  int m_SampleRate = 0;
+  std::vector<float> m_Samples;
+};
+
+// Decoded start of a track, as interleaved stereo float samples.
+struct AudioHead
+{
+  int sampleRate = 0;
+  QByteArray samples;
+};
+
+// Playback engine decoding to a QAudioSink through a lock-free ring, as an
+// alternative to QMediaPlayer. Provides gapless transitions and crossfades
+// between tracks, and owns the PCM on its way to the device.
+class AudioEngine : public QObject
+{
+  Q_OBJECT
+
+public:
+  AudioEngine(QObject* p_Parent = nullptr);
+  ~AudioEngine();
+
+  QString Source() const;
+  qint64 Position() const;
+  qint64 Duration() const;
+  bool IsPlaying() const;
+  bool IsStopped() const;
+
+public slots:
+  void SetSource(const QString& p_Track);
+  void SetNextSource(const QString& p_Track);
+  void Play();
+  void Pause();
+  void Stop();
+  void SetPosition(qint64 p_PositionMs);
+  void SetVolume(float p_Volume);
+  void SetTrackGain(float p_Gain);
+  void SetCrossfade(qint64 p_DurationMs);
+  void SetDevice(const QAudioDevice& p_Device);
+  void SetTapEnabled(bool p_Enabled);
+  void SetHeadTracks(const QStringList& p_Tracks);
+  void SetEqualizer(const QVector<float>& p_GainsDb);
+  void SetSpeed(float p_Speed);
+
+signals:
+  void PositionChanged(qint64 p_PositionMs);
+  void DurationChanged(qint64 p_DurationMs);
+  void PlayingChanged(bool p_Playing);
+  void EndOfMedia();
+  void TrackAdvanced(const QString& p_Track);
+  void ErrorOccurred(const QString& p_ErrorString);
+  void AudioBufferReady(const QAudioBuffer& p_Buffer);
+
+private slots:
+  void OnTimer();
+  void OnDurationChanged(int p_Serial, qint64 p_DurationMs);
+  void OnBufferDecoded(int p_Serial, const QAudioBuffer& p_Buffer);
+  void OnDecodeError(int p_Serial, const QString& p_ErrorString);
+  void OnHeadDecoded(const QString& p_Track, int p_SampleRate, const QByteArray& p_Samples);
+
+private:
+  void StartDecoding(qint64 p_PositionMs);
+  qint64 WriteHead();
+  void StartSinkIfReady();
+  void StopDecoding();
+  void PrepareFade(const QString& p_Track);
+  void StartFadeIfReady();
+  void StopFade();
+  void DrainFadeTap();
+  void StartSink();
+  void StopSink();
+  void SetPlaying(bool p_Playing);
+  void CheckBoundary();
+  void UpdateStats();
+  void UpdateIndexTracks();
+  qint64 LatencyFrames() const;
+  qint64 PlayedFrames() const;
+  std::vector<float> TakeUnplayed(qint64& p_PlayedFrames);
+  static QAudioFormat SinkFormat(const QAudioDevice& p_Device, int p_SampleRate = 0);
+
+private:
+  // Two decks, swapped at the start of a crossfade. m_Stream and m_Worker
+  // hold the current track, m_FadeStream and m_FadeWorker the incoming track
+  // ahead of a crossfade and the outgoing track during it.
+  AudioStream m_Streams[2];
+  AudioStream* m_Stream = nullptr;
+  AudioStream* m_FadeStream = nullptr;
+  AudioMix m_Mix;
+  TimeStretch m_TimeStretch;
+  Equalizer m_Equalizer;
+  QThread m_Thread;
+  AudioDecodeWorker* m_Worker = nullptr;
+  AudioDecodeWorker* m_FadeWorker = nullptr;
+  QAudioDevice m_Device;
+  QAudioFormat m_Format;
+  QScopedPointer<QAudioSink> m_Sink;
+  QScopedPointer<AudioSinkDevice> m_SinkDevice;
+  QTimer m_Timer;
+  QElapsedTimer m_DrainTimer;
+  QString m_Track;
+  int m_Serial = 0;
+  int m_LastSerial = 0;
+  qint64 m_DurationMs = 0;
+  qint64 m_TrackStartMs = 0;
+  qint64 m_TrackStartFrame = 0;
+  qint64 m_PositionMs = 0;
+  float m_Volume = 1.0f;
+  bool m_Playing = false;
+  bool m_Decoding = false;
+  bool m_SinkPending = false;
+  std::vector<float> m_Replay;
+  bool m_TapEnabled = false;
+  bool m_Stalled = false;
+  int m_LastUnderruns = 0;
+  qint64 m_CrossfadeMs = 0;
+  QString m_FadeTrack;
+  int m_FadeSerial = 0;
+  bool m_Fading = false;
+  qint64 m_FadeTapFrames = 0;
+  qint64 m_FadeTapUs = 0;
+  QHash<int, qint64> m_NextDurations;
+  QList<QPair<int, QAudioBuffer>> m_NextBuffers;
+  QThread m_HeadThread;
+  HeadDecodeWorker* m_HeadWorker = nullptr;
+  QStringList m_HeadTracks;
+  QHash<QString, AudioHead> m_Heads;
+  QThread m_IndexThread;
+  Mp3IndexWorker* m_IndexWorker = nullptr;
+};
+
+#endif
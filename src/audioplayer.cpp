@@ -15,6 +15,7 @@
 #endif
 
 #include <QAudioOutput>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QObject>
@@ -23,36 +24,104 @@
 #include <dirent.h>
 #include <string.h>
 
+#include <cmath>
+#include <utility>
+
 #include "audioplayer.h"
+#include "equalizer.h"
 #include "log.h"
+#include "playbackstats.h"
+#include "timestretch.h"
 #include "util.h"
 
+// Pre-open the next track when this close to the end of the current one,
+// or the start of a crossfade
+static const qint64 kPreloadLeadMs = 5000;
+
+static const int kMaxCrossfadeSec = 12;
+static const int kFadeIntervalMs = 20;
+
+// Time over which gain measured for the playing track is applied
+static const qint64 kGainRampMs = 500;
+
+// Interval between position updates during playback beyond which an update
+// is counted as late, for QMediaPlayer and for the native engine respectively
+static const qint64 kLatePositionMs = 1500;
+static const qint64 kLateEnginePositionMs = 250;
+
+// Upper limit of the start of the next track read into page cache
+static const int kMaxPrefetchMb = 256;
+
+// Playback speed change per key press
+static const float kSpeedStep = 0.25f;
+
+// Time after an output device change within which QMediaPlayer playback is
+// expected to continue on the new device, before the track is re-opened
+static const int kDeviceCheckMs = 1000;
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 8, 0)
+// Typical output latency, by which visuals lead the position of a player
+// without playback tap
+static const qint64 kUntappedLatencyMs = 175;
+#endif
+
 AudioPlayer::AudioPlayer(QObject *p_Parent /* = NULL */)
   : QObject(p_Parent)
-  , m_MediaPlayer(this)
 {
   // (Play and Stop are now slots, not signals forwarded to QMediaPlayer)
 
-  // Signals from media player
-  connect(&m_MediaPlayer, &QMediaPlayer::mediaStatusChanged, this, &AudioPlayer::OnMediaStatusChanged);
-  connect(&m_MediaPlayer, &QMediaPlayer::positionChanged, this, &AudioPlayer::PositionChanged);
-  connect(&m_MediaPlayer, &QMediaPlayer::durationChanged, this, &AudioPlayer::DurationChanged);
-#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  connect(&m_MediaPlayer, &QMediaPlayer::errorOccurred, this, &AudioPlayer::OnErrorOccurred);
-#else
-  connect(&m_MediaPlayer, QOverload<QMediaPlayer::Error>::of(&QMediaPlayer::error), this, &AudioPlayer::OnErrorOccurred);
-#endif
+  // Two media players, the active one and one pre-opening the next track
+  m_MediaPlayer = new QMediaPlayer(this);
+  m_NextMediaPlayer = new QMediaPlayer(this);
+
+  // Playback clock
+  m_PlaybackClock = new PlaybackClock(this);
 
   // Spectrum analyzer
-  m_Spectrum = new Spectrum([this]() { return m_MediaPlayer.position(); }, this);
+  m_Spectrum = new Spectrum([this]() { return m_PlaybackClock->AudiblePosition(); }, this);
   connect(m_Spectrum, &Spectrum::SpectrumChanged, this, &AudioPlayer::SpectrumChanged);
 
+  // Signals from media player
+  ConnectMediaPlayer(m_MediaPlayer);
+
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
   QAudioDevice audioDevice(QMediaDevices::defaultAudioOutput());
   m_AudioOutput.reset(new QAudioOutput());
   m_AudioOutput->setDevice(audioDevice);
-  m_MediaPlayer.setAudioOutput(m_AudioOutput.get());
+  m_MediaPlayer->setAudioOutput(m_AudioOutput.get());
+  m_NextAudioOutput.reset(new QAudioOutput());
+  m_NextAudioOutput->setDevice(audioDevice);
+  m_NextMediaPlayer->setAudioOutput(m_NextAudioOutput.get());
   connect(&m_MediaDevices, &QMediaDevices::audioOutputsChanged, this, &AudioPlayer::OnAudioOutputsChanged);
+#endif
+  ApplyVolume();
+
+  // Crossfade volume ramps
+  m_FadeTimer.setInterval(kFadeIntervalMs);
+  connect(&m_FadeTimer, &QTimer::timeout, this, &AudioPlayer::OnFadeTimer);
+  m_GainTimer.setInterval(kFadeIntervalMs);
+  connect(&m_GainTimer, &QTimer::timeout, this, &AudioPlayer::OnGainTimer);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+  // Feed spectrum analyzer with the PCM sent to the output device, instead of
+  // decoding the track a second time
+  m_AudioBufferOutput.reset(new QAudioBufferOutput());
+  connect(m_AudioBufferOutput.get(), &QAudioBufferOutput::audioBufferReceived, m_Spectrum, &Spectrum::AddPlaybackBuffer);
+  m_Spectrum->SetPlaybackTap(true);
+
+  // Player position follows the output, and trails the buffers sent to it by
+  // the output latency
+  connect(m_AudioBufferOutput.get(), &QAudioBufferOutput::audioBufferReceived, this,
+          [this](const QAudioBuffer& p_Buffer)
+  {
+    const qint64 endMs = (p_Buffer.startTime() + p_Buffer.duration()) / 1000;
+    const qint64 latencyMs = endMs - m_MediaPlayer->position();
+    PlaybackStats::SetOutputLatency(qMax(0ll, static_cast<qint64>(latencyMs / m_MediaPlayer->playbackRate())));
+  });
+#else
+  // Player position is not tied to the output, visuals are offset by a
+  // typical output latency to follow what is heard
+  m_PlaybackClock->SetOutputLatency(kUntappedLatencyMs);
 #endif
 }
 
@@ -63,11 +132,25 @@ AudioPlayer::~AudioPlayer()
 void AudioPlayer::Shutdown()
 {
   m_Spectrum->Stop();
-  m_MediaPlayer.stop();
+  delete m_LoudnessScanner;
+  m_LoudnessScanner = nullptr;
+  delete m_Prefetcher;
+  m_Prefetcher = nullptr;
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetSource(QString());
+  }
+#endif
+  ClearPreload();
+  m_MediaPlayer->stop();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+  m_MediaPlayer->setAudioBufferOutput(nullptr);
+#endif
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  m_MediaPlayer.setSource(QUrl());
+  m_MediaPlayer->setSource(QUrl());
 #else
-  m_MediaPlayer.setMedia(QMediaContent());
+  m_MediaPlayer->setMedia(QMediaContent());
 #endif
 }
 
@@ -114,6 +197,15 @@ void AudioPlayer::SetPlaylist(const QStringList& p_Paths, const QString& p_Curre
   }
 
   emit PlaylistUpdated(m_PlayListPaths);
+  m_ShuffleOrder.SetTracks(m_PlayListPaths);
+  m_SmartNextIndex = -1;
+  m_SamplerCycle = -1;
+  m_Weights.clear();
+
+  if (m_LoudnessScanner != nullptr)
+  {
+    m_LoudnessScanner->Scan(m_PlayListPaths);
+  }
 
   const int currentIndex = m_PlayListPaths.indexOf(p_CurrentTrack);
   if (currentIndex != -1)
@@ -122,7 +214,7 @@ void AudioPlayer::SetPlaylist(const QStringList& p_Paths, const QString& p_Curre
   }
   else if (m_Shuffle)
   {
-    m_CurrentIndex = rand() % m_PlayListPaths.size();
+    m_CurrentIndex = qMax(0, m_ShuffleOrder.Next());
   }
   else
   {
@@ -132,10 +224,59 @@ void AudioPlayer::SetPlaylist(const QStringList& p_Paths, const QString& p_Curre
   OnMediaChanged(true /*p_Forward*/);
 }
 
+void AudioPlayer::SetEngine(const QString& p_Engine)
+{
+  if ((p_Engine != "native") || !m_Engine.isEmpty()) return;
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  // Decode to an audio sink through own ring buffer, in place of QMediaPlayer
+  Log::Info("Using native audio engine");
+  m_Engine = p_Engine;
+  m_AudioEngine = new AudioEngine(this);
+  DisconnectMediaPlayer(m_MediaPlayer);
+  connect(m_AudioEngine, &AudioEngine::PositionChanged, this, &AudioPlayer::PositionChanged);
+  connect(m_AudioEngine, &AudioEngine::PositionChanged, this, &AudioPlayer::OnPositionChanged);
+  connect(m_AudioEngine, &AudioEngine::PositionChanged, m_PlaybackClock, &PlaybackClock::Update);
+  connect(m_AudioEngine, &AudioEngine::PlayingChanged, m_PlaybackClock, &PlaybackClock::SetPlaying);
+  connect(m_AudioEngine, &AudioEngine::DurationChanged, this, &AudioPlayer::DurationChanged);
+  connect(m_AudioEngine, &AudioEngine::DurationChanged, m_Spectrum, &Spectrum::SetDuration);
+  connect(m_AudioEngine, &AudioEngine::TrackAdvanced, this, &AudioPlayer::OnEngineTrackAdvanced);
+  connect(m_AudioEngine, &AudioEngine::AudioBufferReady, m_Spectrum, &Spectrum::AddPlaybackBuffer);
+  connect(m_AudioEngine, &AudioEngine::EndOfMedia, this, [this]()
+  {
+    OnMediaStatusChanged(QMediaPlayer::EndOfMedia);
+  });
+  connect(m_AudioEngine, &AudioEngine::ErrorOccurred, this, [this](const QString& p_ErrorString)
+  {
+    Log::Warning("Audio engine error: %s (track=%s)", p_ErrorString.toStdString().c_str(),
+                 m_CurrentTrack.toStdString().c_str());
+    Next();
+  });
+  m_Spectrum->SetPlaybackTap(true);
+  m_PlaybackClock->SetOutputLatency(0);
+  ApplyVolume();
+  ApplyEqualizer();
+  ApplySpeed();
+#else
+  Log::Warning("Native audio engine requires Qt 6, using QMediaPlayer");
+#endif
+}
+
+void AudioPlayer::GetEngine(QString& p_Engine)
+{
+  p_Engine = m_Engine.isEmpty() ? QString("qt") : m_Engine;
+}
+
 void AudioPlayer::SetPlaybackMode(bool p_Shuffle)
 {
   m_Shuffle = p_Shuffle;
+  if (m_Shuffle)
+  {
+    m_ShuffleOrder.SetCurrent(m_CurrentIndex);
+  }
+
   emit PlaybackModeUpdated(m_Shuffle);
+  PrepareNextTracks();
 }
 
 void AudioPlayer::GetPlaybackMode(bool& p_Shuffle)
@@ -145,22 +286,34 @@ void AudioPlayer::GetPlaybackMode(bool& p_Shuffle)
 
 void AudioPlayer::ToggleShuffle()
 {
-  m_Shuffle = !m_Shuffle;
-  emit PlaybackModeUpdated(m_Shuffle);
+  SetPlaybackMode(!m_Shuffle);
 }
 
 void AudioPlayer::ExternalEdit(int p_SelectedIndex)
 {
   const bool editingCurrent = (p_SelectedIndex == m_CurrentIndex);
+  if (m_PlayListPaths.at(p_SelectedIndex) == m_PreloadedTrack)
+  {
+    ClearPreload();
+  }
+
   if (editingCurrent)
   {
+    m_PositionUpdateTimer.invalidate();
+
     // Release the file handle so idntag can safely rewrite it, and so the
     // decoder is not reading shifted byte offsets while tags are in flux.
-    m_MediaPlayer.stop();
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-    m_MediaPlayer.setSource(QUrl());
+    if (m_AudioEngine != nullptr)
+    {
+      m_AudioEngine->SetSource(QString());
+    }
+#endif
+    m_MediaPlayer->stop();
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+    m_MediaPlayer->setSource(QUrl());
 #else
-    m_MediaPlayer.setMedia(QMediaContent());
+    m_MediaPlayer->setMedia(QMediaContent());
 #endif
   }
 
@@ -171,11 +324,20 @@ void AudioPlayer::ExternalEdit(int p_SelectedIndex)
   if (editingCurrent)
   {
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-    m_MediaPlayer.setSource(QUrl::fromLocalFile(selectedTrackPath));
+    if (m_AudioEngine != nullptr)
+    {
+      m_AudioEngine->SetSource(selectedTrackPath);
+      m_AudioEngine->Play();
+    }
+    else
+    {
+      m_MediaPlayer->setSource(QUrl::fromLocalFile(selectedTrackPath));
+      m_MediaPlayer->play();
+    }
 #else
-    m_MediaPlayer.setMedia(QUrl::fromLocalFile(selectedTrackPath));
+    m_MediaPlayer->setMedia(QUrl::fromLocalFile(selectedTrackPath));
+    m_MediaPlayer->play();
 #endif
-    m_MediaPlayer.play();
   }
 
   if (result)
@@ -192,68 +354,229 @@ void AudioPlayer::ExternalEdit(int p_SelectedIndex)
 
 void AudioPlayer::VolumeUp()
 {
-#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  float volume = qBound(0.0, m_MediaPlayer.audioOutput()->volume() + 0.05, 1.0);
-  m_MediaPlayer.audioOutput()->setVolume(volume);
-  emit VolumeChanged((int)round(volume * 100.0));
-#else
-  int volume = qBound(0, m_MediaPlayer.volume() + 5, 100);
-  m_MediaPlayer.setVolume(volume);
-  emit VolumeChanged(volume);
-#endif
+  SetOutputVolume(m_Volume + 0.05f);
 }
 
 void AudioPlayer::VolumeDown()
 {
-#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  float volume = qBound(0.0, m_MediaPlayer.audioOutput()->volume() - 0.05, 1.0);
-  m_MediaPlayer.audioOutput()->setVolume(volume);
-  emit VolumeChanged((int)round(volume * 100.0));
-#else
-  int volume = qBound(0, m_MediaPlayer.volume() - 5, 100);
-  m_MediaPlayer.setVolume(volume);
-  emit VolumeChanged(volume);
-#endif
+  SetOutputVolume(m_Volume - 0.05f);
 }
 
 void AudioPlayer::SkipBackward()
 {
-  m_MediaPlayer.pause();
-  m_MediaPlayer.setPosition(qBound(0ll, m_MediaPlayer.position() - 3000, m_MediaPlayer.duration()));
-  m_MediaPlayer.play();
-  m_Spectrum->SetPaused(false);
+  SeekPosition(Position() - 3000, true /*p_Play*/);
 }
 
 void AudioPlayer::SkipForward()
 {
-  m_MediaPlayer.pause();
-  m_MediaPlayer.setPosition(qBound(0ll, m_MediaPlayer.position() + 3000, m_MediaPlayer.duration()));
-  m_MediaPlayer.play();
-  m_Spectrum->SetPaused(false);
+  SeekPosition(Position() + 3000, true /*p_Play*/);
 }
 
 void AudioPlayer::SetVolume(int p_VolumePercentage)
 {
-#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  float volume = qBound(0.0, p_VolumePercentage / 100.0, 1.0);
-  m_MediaPlayer.audioOutput()->setVolume(volume);
-  emit VolumeChanged((int)round(volume * 100.0));
-#else
-  int volume = qBound(0, p_VolumePercentage, 100);
-  m_MediaPlayer.setVolume(volume);
-  emit VolumeChanged(volume);
-#endif
+  SetOutputVolume(p_VolumePercentage / 100.0f);
 }
 
 void AudioPlayer::GetVolume(int& p_Volume)
 {
+  p_Volume = (int)round(m_Volume * 100.0);
+}
+
+void AudioPlayer::SetCrossfade(int p_Seconds)
+{
+  m_CrossfadeMs = qBound(0, p_Seconds, kMaxCrossfadeSec) * 1000;
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  p_Volume = (int)round(m_MediaPlayer.audioOutput()->volume() * 100.0);
-#else
-  p_Volume = m_MediaPlayer.volume();
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetCrossfade(m_CrossfadeMs);
+  }
 #endif
 }
 
+void AudioPlayer::GetCrossfade(int& p_Seconds)
+{
+  p_Seconds = m_CrossfadeMs / 1000;
+}
+
+void AudioPlayer::SetReplayGain(const QString& p_Mode)
+{
+  if ((p_Mode != "track") && (p_Mode != "album"))
+  {
+    if (p_Mode != "off")
+    {
+      Log::Warning("Unsupported replaygain mode %s", p_Mode.toStdString().c_str());
+    }
+
+    m_ReplayGain = "off";
+    return;
+  }
+
+  m_ReplayGain = p_Mode;
+  if (m_LoudnessScanner == nullptr)
+  {
+    m_LoudnessScanner = new LoudnessScanner(this);
+    connect(m_LoudnessScanner, &LoudnessScanner::LoudnessUpdated, this, &AudioPlayer::OnLoudnessUpdated);
+  }
+
+  m_LoudnessScanner->SetWriteTags(m_ReplayGainTags);
+  if (!m_PlayListPaths.isEmpty())
+  {
+    m_LoudnessScanner->Scan(m_PlayListPaths);
+  }
+}
+
+void AudioPlayer::GetReplayGain(QString& p_Mode)
+{
+  p_Mode = m_ReplayGain;
+}
+
+void AudioPlayer::SetReplayGainTags(bool p_WriteTags)
+{
+  m_ReplayGainTags = p_WriteTags;
+  if (m_LoudnessScanner != nullptr)
+  {
+    m_LoudnessScanner->SetWriteTags(p_WriteTags);
+  }
+}
+
+void AudioPlayer::GetReplayGainTags(bool& p_WriteTags)
+{
+  p_WriteTags = m_ReplayGainTags;
+}
+
+void AudioPlayer::SetShuffleSpread(const QString& p_Spread)
+{
+  if (!ShuffleOrder::ParseSpread(p_Spread, m_ShuffleSpread))
+  {
+    Log::Warning("Unsupported shuffle spread %s", p_Spread.toStdString().c_str());
+    m_ShuffleSpread = ShuffleOrder::SpreadOff;
+  }
+
+  m_ShuffleOrder.SetSpread(m_ShuffleSpread);
+}
+
+void AudioPlayer::GetShuffleSpread(QString& p_Spread)
+{
+  p_Spread = ShuffleOrder::SpreadName(m_ShuffleSpread);
+}
+
+void AudioPlayer::SetSmartShuffle(bool p_SmartShuffle)
+{
+  m_SmartShuffle = p_SmartShuffle;
+  m_SmartNextIndex = -1;
+  m_SamplerCycle = -1;
+}
+
+void AudioPlayer::GetSmartShuffle(bool& p_SmartShuffle)
+{
+  p_SmartShuffle = m_SmartShuffle;
+}
+
+void AudioPlayer::SetShuffleState(const QStringList& p_Order, int p_Cursor)
+{
+  // Merged with the playlist once it is set
+  m_ShuffleOrder.Restore(p_Order, p_Cursor);
+}
+
+void AudioPlayer::GetShuffleState(QStringList& p_Order, int& p_Cursor)
+{
+  m_ShuffleOrder.Save(p_Order, p_Cursor);
+}
+
+void AudioPlayer::SetPrefetch(int p_Megabytes)
+{
+  m_PrefetchMb = qBound(0, p_Megabytes, kMaxPrefetchMb);
+  delete m_Prefetcher;
+  m_Prefetcher = nullptr;
+  if (m_PrefetchMb > 0)
+  {
+    m_Prefetcher = new Prefetcher(static_cast<qint64>(m_PrefetchMb) * 1024 * 1024, this);
+    PrepareNextTracks();
+  }
+}
+
+void AudioPlayer::GetPrefetch(int& p_Megabytes)
+{
+  p_Megabytes = m_PrefetchMb;
+}
+
+void AudioPlayer::SetEqualizerPreset(const QString& p_Preset)
+{
+  if (!EqualizerPresets().contains(p_Preset))
+  {
+    Log::Warning("Unsupported equalizer preset \"%s\", using flat", p_Preset.toStdString().c_str());
+    m_EqualizerPreset = "flat";
+  }
+  else
+  {
+    m_EqualizerPreset = p_Preset;
+  }
+
+  ApplyEqualizer();
+}
+
+void AudioPlayer::GetEqualizerPreset(QString& p_Preset)
+{
+  p_Preset = m_EqualizerPreset;
+}
+
+void AudioPlayer::SetEqualizerCustom(const QString& p_Gains)
+{
+  // Comma separated gains in dB, lowest band first
+  m_EqualizerCustom.clear();
+  if (p_Gains.trimmed().isEmpty()) return;
+
+  const QStringList gains = p_Gains.split(",");
+  for (const QString& gain : gains)
+  {
+    bool ok = false;
+    const float gainDb = gain.trimmed().toFloat(&ok);
+    if (!ok || (m_EqualizerCustom.size() >= Equalizer::kBands))
+    {
+      Log::Warning("Invalid custom equalizer gains \"%s\"", p_Gains.toStdString().c_str());
+      m_EqualizerCustom.clear();
+      break;
+    }
+
+    m_EqualizerCustom.append(gainDb);
+  }
+}
+
+void AudioPlayer::GetEqualizerCustom(QString& p_Gains)
+{
+  QStringList gains;
+  for (const float gainDb : m_EqualizerCustom)
+  {
+    gains << QString::number(gainDb);
+  }
+
+  p_Gains = gains.join(",");
+}
+
+void AudioPlayer::SetEqualizerFolders(const QVariantMap& p_Folders)
+{
+  m_EqualizerFolders = p_Folders;
+  ApplyEqualizer();
+}
+
+void AudioPlayer::GetEqualizerFolders(QVariantMap& p_Folders)
+{
+  p_Folders = m_EqualizerFolders;
+}
+
+void AudioPlayer::SetSpeed(float p_Speed)
+{
+  // Whole steps only, within the range supported by time stretching
+  const float speed = qRound(p_Speed / kSpeedStep) * kSpeedStep;
+  m_Speed = qBound(TimeStretch::kMinSpeed, speed, TimeStretch::kMaxSpeed);
+  ApplySpeed();
+}
+
+void AudioPlayer::GetSpeed(float& p_Speed)
+{
+  p_Speed = m_Speed;
+}
+
 void AudioPlayer::GetCurrentTrack(QString& p_CurrentTrack)
 {
   p_CurrentTrack = m_CurrentTrack;
@@ -262,7 +585,7 @@ void AudioPlayer::GetCurrentTrack(QString& p_CurrentTrack)
 void AudioPlayer::GetQueuePaths(QVector<QString>& p_QueuePaths)
 {
   p_QueuePaths.clear();
-  for (int idx : m_Queue)
+  for (int idx : m_Queue.ToVector())
   {
     if ((idx >= 0) && (idx < m_PlayListPaths.size()))
     {
@@ -273,30 +596,98 @@ void AudioPlayer::GetQueuePaths(QVector<QString>& p_QueuePaths)
 
 void AudioPlayer::SetQueuePaths(const QVector<QString>& p_QueuePaths)
 {
-  m_Queue.clear();
+  QHash<QString, int> indices;
+  indices.reserve(m_PlayListPaths.size());
+  for (int i = m_PlayListPaths.size() - 1; i >= 0; --i)
+  {
+    indices.insert(m_PlayListPaths.at(i), i);
+  }
+
+  m_Queue.Clear();
   for (const QString& path : p_QueuePaths)
   {
-    const int idx = m_PlayListPaths.indexOf(path);
+    const int idx = indices.value(path, -1);
     if (idx >= 0)
     {
-      m_Queue.append(idx);
+      m_Queue.Append(idx);
     }
   }
-  emit QueueUpdated(m_Queue);
+  emit QueueUpdated(&m_Queue);
+  PrepareNextTracks();
 }
 
 bool AudioPlayer::IsInited()
 {
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  return (m_MediaPlayer.audioOutput() != nullptr);
+  return (m_MediaPlayer->audioOutput() != nullptr);
 #else
   return true;
 #endif
 }
 
+const PlaybackClock* AudioPlayer::GetPlaybackClock() const
+{
+  return m_PlaybackClock;
+}
+
 void AudioPlayer::SetPosition(int p_PositionPercentage)
 {
-  m_MediaPlayer.setPosition(qBound(0ll, (p_PositionPercentage * m_MediaPlayer.duration()) / 100ll, m_MediaPlayer.duration()));
+  SeekPosition((p_PositionPercentage * Duration()) / 100ll, false /*p_Play*/);
+}
+
+void AudioPlayer::SeekPosition(qint64 p_PositionMs, bool p_Play)
+{
+  m_PositionUpdateTimer.invalidate();
+  const qint64 position = qBound(0ll, p_PositionMs, Duration());
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetPosition(position);
+    if (p_Play)
+    {
+      m_AudioEngine->Play();
+    }
+  }
+  else
+#endif
+  {
+    if (p_Play)
+    {
+      m_MediaPlayer->pause();
+    }
+
+    m_MediaPlayer->setPosition(position);
+    if (p_Play)
+    {
+      m_MediaPlayer->play();
+    }
+  }
+
+  m_PlaybackClock->Seek(position);
+  if (p_Play)
+  {
+    m_Spectrum->SetPaused(false);
+  }
+
+  m_Spectrum->Seek(position, Duration());
+}
+
+qint64 AudioPlayer::Position() const
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr) return m_AudioEngine->Position();
+#endif
+
+  return m_MediaPlayer->position();
+}
+
+qint64 AudioPlayer::Duration() const
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr) return m_AudioEngine->Duration();
+#endif
+
+  return m_MediaPlayer->duration();
 }
 
 void AudioPlayer::OnMediaStatusChanged(QMediaPlayer::MediaStatus p_MediaStatus)
@@ -310,15 +701,27 @@ void AudioPlayer::OnMediaStatusChanged(QMediaPlayer::MediaStatus p_MediaStatus)
   Log::Debug("OnMediaStatusChanged: %s (%d) track=%s", statusName, idx,
              m_CurrentTrack.toStdString().c_str());
 
-  if (p_MediaStatus == QMediaPlayer::EndOfMedia)
+  if (p_MediaStatus == QMediaPlayer::StalledMedia)
+  {
+    PlaybackStats::Record(PlaybackStats::DecoderStall, m_CurrentTrack);
+  }
+  else if (p_MediaStatus == QMediaPlayer::EndOfMedia)
   {
+    m_PlayStats.TrackEnded();
+    if (m_Prefetcher != nullptr)
+    {
+      m_Prefetcher->TrackPlayed(m_CurrentTrack);
+    }
+
+    // Time the handoff to the next track, reported on its first position
+    m_HandoffTimer.start();
     Next();
   }
   else if (p_MediaStatus == QMediaPlayer::InvalidMedia)
   {
     Log::Warning("InvalidMedia for track=%s error=%s",
                  m_CurrentTrack.toStdString().c_str(),
-                 m_MediaPlayer.errorString().toStdString().c_str());
+                 m_MediaPlayer->errorString().toStdString().c_str());
     Next();
   }
 }
@@ -336,64 +739,124 @@ void AudioPlayer::OnAudioOutputsChanged()
   if (newDevice.isNull())
   {
     Log::Warning("Audio output device lost, no available output devices");
-    m_MediaPlayer.stop();
+    PlaybackStats::Record(PlaybackStats::DeviceRestart, "no output device");
+    if (m_AudioEngine != nullptr)
+    {
+      m_AudioEngine->Stop();
+    }
+
+    m_MediaPlayer->stop();
     return;
   }
 
   Log::Info("Audio output device changed, switching to: %s",
             newDevice.description().toStdString().c_str());
+  PlaybackStats::Record(PlaybackStats::DeviceRestart, newDevice.description());
   m_AudioOutput->setDevice(newDevice);
+  m_NextAudioOutput->setDevice(newDevice);
+
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetDevice(newDevice);
+    return;
+  }
 
-  // Re-start playback on the new device if we were playing
-  if (m_MediaPlayer.playbackState() == QMediaPlayer::PlayingState)
+  // QAudioOutput re-binds the sink of a playing player without re-opening
+  // the source. Re-open only as a fallback, if playback does not continue.
+  if (m_MediaPlayer->playbackState() == QMediaPlayer::PlayingState)
   {
-    qint64 pos = m_MediaPlayer.position();
-    m_MediaPlayer.stop();
-    m_MediaPlayer.setSource(QUrl::fromLocalFile(m_CurrentTrack));
-    m_MediaPlayer.setPosition(pos);
-    m_MediaPlayer.play();
+    const qint64 pos = m_MediaPlayer->position();
+    const QString track = m_CurrentTrack;
+    QTimer::singleShot(kDeviceCheckMs, this, [this, pos, track]()
+    {
+      if ((m_AudioEngine != nullptr) || (m_CurrentTrack != track) ||
+          (m_MediaPlayer->playbackState() != QMediaPlayer::PlayingState) ||
+          (m_MediaPlayer->position() != pos)) return;
+
+      Log::Warning("Playback stalled after output device change, re-opening track");
+      m_MediaPlayer->stop();
+      m_MediaPlayer->setSource(QUrl::fromLocalFile(m_CurrentTrack));
+      m_MediaPlayer->setPosition(pos);
+      m_MediaPlayer->play();
+    });
   }
 }
 #else
 void AudioPlayer::OnErrorOccurred(QMediaPlayer::Error p_Error)
 {
   Log::Warning("QMediaPlayer error %d: %s (track=%s)", static_cast<int>(p_Error),
-               m_MediaPlayer.errorString().toStdString().c_str(),
+               m_MediaPlayer->errorString().toStdString().c_str(),
                m_CurrentTrack.toStdString().c_str());
 }
 #endif
 
 void AudioPlayer::Play()
 {
-  m_MediaPlayer.play();
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->Play();
+  }
+  else
+#endif
+  {
+    m_MediaPlayer->play();
+  }
+
   m_Spectrum->SetPaused(false);
   if (m_Spectrum->IsRunning())
   {
-    m_Spectrum->StartTrack(m_CurrentTrack);
+    m_Spectrum->StartTrack(m_CurrentTrack, Position(), Duration());
   }
 }
 
 void AudioPlayer::Stop()
 {
-  m_MediaPlayer.stop();
+  StopCrossfade();
+  m_PositionUpdateTimer.invalidate();
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->Stop();
+  }
+#endif
+  m_MediaPlayer->stop();
   m_Spectrum->StartDecay();
 }
 
 void AudioPlayer::Pause()
 {
+  m_PositionUpdateTimer.invalidate();
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  switch (m_MediaPlayer.playbackState())
+  if (m_AudioEngine != nullptr)
+  {
+    if (m_AudioEngine->IsPlaying())
+    {
+      m_AudioEngine->Pause();
+      m_Spectrum->SetPaused(true);
+    }
+    else if (!m_AudioEngine->IsStopped())
+    {
+      m_AudioEngine->Play();
+      m_Spectrum->SetPaused(false);
+    }
+
+    return;
+  }
+
+  switch (m_MediaPlayer->playbackState())
 #else
-  switch (m_MediaPlayer.state())
+  switch (m_MediaPlayer->state())
 #endif
   {
     case QMediaPlayer::PlayingState:
-      m_MediaPlayer.pause();
+      StopCrossfade();
+      m_MediaPlayer->pause();
       m_Spectrum->SetPaused(true);
       break;
 
     case QMediaPlayer::PausedState:
-      m_MediaPlayer.play();
+      m_MediaPlayer->play();
       m_Spectrum->SetPaused(false);
       break;
 
@@ -407,15 +870,9 @@ void AudioPlayer::Previous()
 {
   if (m_Shuffle)
   {
-    if (!m_CurrentIndexHistory.empty())
-    {
-      m_CurrentIndex = m_CurrentIndexHistory.front();
-      m_CurrentIndexHistory.removeFirst();
-    }
-    else
-    {
-      --m_CurrentIndex;
-    }
+    // Start of the shuffle cycle restarts the current track
+    const int index = m_ShuffleOrder.Previous();
+    m_CurrentIndex = (index >= 0) ? index : m_CurrentIndex;
   }
   else
   {
@@ -428,26 +885,202 @@ void AudioPlayer::Previous()
 void AudioPlayer::Next()
 {
   Log::Debug("Next() called, currentIndex=%d", m_CurrentIndex);
-  if (!m_Queue.isEmpty())
-  {
-    m_CurrentIndex = m_Queue.takeFirst();
-    emit QueueUpdated(m_Queue);
-  }
-  else if (m_Shuffle && (m_PlayListPaths.size() > 2))
+  AdvanceIndex();
+  OnMediaChanged(true /*p_Forward*/);
+}
+
+void AudioPlayer::AdvanceIndex()
+{
+  if (!m_Queue.IsEmpty())
+  {
+    m_CurrentIndex = m_Queue.TakeFront();
+    emit QueueUpdated(&m_Queue);
+  }
+  else if (m_Shuffle && m_SmartShuffle)
+  {
+    // Use the pick drawn ahead of time, moved into the order on change
+    m_CurrentIndex = PeekSmartIndex();
+    m_SmartNextIndex = -1;
+  }
+  else if (m_Shuffle)
+  {
+    // Next in the precomputed order, which may already be pre-opened
+    m_CurrentIndex = m_ShuffleOrder.Next();
+  }
+  else
+  {
+    ++m_CurrentIndex;
+  }
+}
+
+int AudioPlayer::PeekNextIndex()
+{
+  if (m_PlayListPaths.empty()) return -1;
+
+  if (!m_Queue.IsEmpty())
+  {
+    return m_Queue.Front();
+  }
+  else if (m_Shuffle)
+  {
+    return m_SmartShuffle ? PeekSmartIndex() : m_ShuffleOrder.PeekNext();
+  }
+  else
+  {
+    return (m_CurrentIndex + 1) % m_PlayListPaths.size();
+  }
+}
+
+int AudioPlayer::PeekPreviousIndex() const
+{
+  if (m_PlayListPaths.empty()) return -1;
+
+  if (m_Shuffle)
   {
-    int newIndex = m_CurrentIndex;
-    while (newIndex == m_CurrentIndex)
+    const int index = m_ShuffleOrder.PeekPrevious();
+    return (index >= 0) ? index : m_CurrentIndex;
+  }
+
+  return (m_CurrentIndex > 0) ? (m_CurrentIndex - 1) : (m_PlayListPaths.size() - 1);
+}
+
+int AudioPlayer::PeekSmartIndex()
+{
+  // Order starts a new cycle once all tracks are played, and provides the
+  // fallback pick
+  const int fallback = m_ShuffleOrder.PeekNext();
+  if ((m_SmartNextIndex >= 0) && (m_SmartNextIndex != m_CurrentIndex) &&
+      !m_ShuffleOrder.IsPlayed(m_SmartNextIndex))
+  {
+    return m_SmartNextIndex;
+  }
+
+  // Weights are computed once per playlist, and then updated per track as
+  // its statistics change
+  if (m_Weights.size() != static_cast<size_t>(m_PlayListPaths.size()))
+  {
+    QElapsedTimer timer;
+    timer.start();
+    m_Weights.resize(m_PlayListPaths.size());
+    for (int index = 0; index < m_PlayListPaths.size(); ++index)
     {
-      newIndex = rand() % m_PlayListPaths.size();
+      UpdateWeight(index);
     }
 
-    m_CurrentIndex = newIndex;
+    m_SamplerCycle = -1;
+    Log::Debug("Smart shuffle weights for %d tracks in %lld ms", m_PlayListPaths.size(), timer.elapsed());
+  }
+
+  // Draws are from the tracks not yet played in the cycle, so that weights
+  // decide which of them come first. The table is rebuilt from the remaining
+  // tracks when a draw hits one played since it was built.
+  m_SmartNextIndex = fallback;
+  for (int i = 0; i < 2; ++i)
+  {
+    if (m_SamplerCycle != m_ShuffleOrder.Cycle())
+    {
+      BuildSampler();
+    }
+
+    const int sample = m_Sampler.Sample();
+    const int index = (sample >= 0) ? m_SamplerIndices.at(sample) : -1;
+    if ((index >= 0) && (index != m_CurrentIndex) && !m_ShuffleOrder.IsPlayed(index))
+    {
+      m_SmartNextIndex = index;
+      break;
+    }
+
+    m_SamplerCycle = -1;
+  }
+
+  return m_SmartNextIndex;
+}
+
+void AudioPlayer::BuildSampler()
+{
+  std::vector<float> weights;
+  m_SamplerIndices.clear();
+  for (int index = 0; index < m_PlayListPaths.size(); ++index)
+  {
+    if ((index != m_CurrentIndex) && !m_ShuffleOrder.IsPlayed(index))
+    {
+      m_SamplerIndices.append(index);
+      weights.push_back(m_Weights[index]);
+    }
+  }
+
+  m_Sampler.Build(weights);
+  m_SamplerCycle = m_ShuffleOrder.Cycle();
+}
+
+void AudioPlayer::UpdateWeight(int p_Index)
+{
+  if ((p_Index < 0) || (static_cast<size_t>(p_Index) >= m_Weights.size())) return;
+
+  m_Weights[p_Index] = m_PlayStats.Weight(m_PlayListPaths.at(p_Index), QDateTime::currentSecsSinceEpoch());
+}
+
+void AudioPlayer::TrackPlayed(int p_Index)
+{
+  if ((p_Index < 0) || (p_Index >= m_PlayListPaths.size())) return;
+
+  m_PlayStats.TrackPlayed(m_PlayListPaths.at(p_Index));
+  UpdateWeight(p_Index);
+}
+
+void AudioPlayer::CycleEqualizer()
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine == nullptr)
+#endif
+  {
+    Log::Info("Equalizer requires the native audio engine");
+    return;
+  }
+
+  // Changes the profile of the current track folder if it has one
+  const QStringList presets = EqualizerPresets();
+  const QString preset = m_EqualizerFolder.isEmpty() ? m_EqualizerPreset
+                                                     : m_EqualizerFolders.value(m_EqualizerFolder).toString();
+  const QString nextPreset = presets.at((presets.indexOf(preset) + 1) % presets.size());
+  if (m_EqualizerFolder.isEmpty())
+  {
+    m_EqualizerPreset = nextPreset;
   }
   else
   {
-    ++m_CurrentIndex;
+    m_EqualizerFolders.insert(m_EqualizerFolder, nextPreset);
   }
-  OnMediaChanged(true /*p_Forward*/);
+
+  ApplyEqualizer();
+}
+
+void AudioPlayer::ToggleEqualizerFolder()
+{
+  if (m_CurrentTrack.isEmpty()) return;
+
+  // Remove the profile in effect for the current track, or add one for its
+  // folder starting from the current preset
+  if (!m_EqualizerFolder.isEmpty())
+  {
+    m_EqualizerFolders.remove(m_EqualizerFolder);
+  }
+  else
+  {
+    m_EqualizerFolders.insert(QFileInfo(m_CurrentTrack).absolutePath(), m_EqualizerPreset);
+  }
+
+  ApplyEqualizer();
+}
+
+void AudioPlayer::SpeedUp()
+{
+  SetSpeed(m_Speed + kSpeedStep);
+}
+
+void AudioPlayer::SpeedDown()
+{
+  SetSpeed(m_Speed - kSpeedStep);
 }
 
 void AudioPlayer::SetCurrentIndex(int p_CurrentIndex)
@@ -459,23 +1092,53 @@ void AudioPlayer::SetCurrentIndex(int p_CurrentIndex)
 void AudioPlayer::EnqueueTrack(int p_Index)
 {
   if ((p_Index < 0) || (p_Index >= m_PlayListPaths.size())) return;
-  if (!m_Queue.isEmpty() && (m_Queue.last() == p_Index)) return;
-  m_Queue.append(p_Index);
-  emit QueueUpdated(m_Queue);
+  if (!m_Queue.IsEmpty() && (m_Queue.Back() == p_Index)) return;
+  m_Queue.Append(p_Index);
+  emit QueueUpdated(&m_Queue);
+  PrepareNextTracks();
+}
+
+void AudioPlayer::EnqueueTracks(const QVector<int>& p_Indices)
+{
+  QVector<int> indices;
+  indices.reserve(p_Indices.size());
+  for (int idx : p_Indices)
+  {
+    if ((idx >= 0) && (idx < m_PlayListPaths.size()))
+    {
+      indices.append(idx);
+    }
+  }
+
+  if (indices.isEmpty()) return;
+  m_Queue.Append(indices);
+  emit QueueUpdated(&m_Queue);
+  PrepareNextTracks();
 }
 
 void AudioPlayer::UnenqueueTrack(int p_Index)
 {
-  const int removed = m_Queue.removeAll(p_Index);
+  const int removed = m_Queue.RemoveAll(p_Index);
   if (removed == 0) return;
-  emit QueueUpdated(m_Queue);
+  emit QueueUpdated(&m_Queue);
+  PrepareNextTracks();
 }
 
 void AudioPlayer::SetAnalyzerEnabled(bool p_Enabled)
 {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+  m_MediaPlayer->setAudioBufferOutput(p_Enabled ? m_AudioBufferOutput.get() : nullptr);
+#endif
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetTapEnabled(p_Enabled);
+  }
+#endif
+
   if (p_Enabled)
   {
-    m_Spectrum->StartTrack(m_CurrentTrack);
+    m_Spectrum->StartTrack(m_CurrentTrack, Position(), Duration());
   }
   else
   {
@@ -483,10 +1146,24 @@ void AudioPlayer::SetAnalyzerEnabled(bool p_Enabled)
   }
 }
 
-void AudioPlayer::OnMediaChanged(bool p_Forward)
+void AudioPlayer::SetAnalyzerFrameRate(int p_Fps)
+{
+  m_Spectrum->SetFrameRate(p_Fps);
+}
+
+void AudioPlayer::SetAnalyzerBandCount(int p_BandCount)
+{
+  m_Spectrum->SetBandCount(p_BandCount);
+}
+
+void AudioPlayer::OnMediaChanged(bool p_Forward, bool p_Crossfade /* = false */)
 {
   if (m_PlayListPaths.empty()) return;
 
+  // Cut any fade in progress short
+  StopCrossfade();
+  m_PositionUpdateTimer.invalidate();
+
   if (m_CurrentIndex >= m_PlayListPaths.size())
   {
     m_CurrentIndex = 0;
@@ -497,34 +1174,527 @@ void AudioPlayer::OnMediaChanged(bool p_Forward)
   }
 
   m_CurrentTrack = m_PlayListPaths.at(m_CurrentIndex);
+
+  // Track left before its played point, other than by reaching its end, is
+  // counted as skipped, which lowers its shuffle weight
+  if (!m_PlayStats.TrackStarted(m_CurrentTrack).isEmpty())
+  {
+    UpdateWeight(m_StartedIndex);
+  }
+
+  m_StartedIndex = m_CurrentIndex;
+  if (m_LoudnessScanner != nullptr)
+  {
+    // Measure upcoming tracks ahead of the rest of the playlist, and leave
+    // their tags alone while they are open
+    QStringList busyTracks = { m_CurrentTrack };
+    const int nextIndex = PeekNextIndex();
+    if (nextIndex >= 0)
+    {
+      busyTracks << m_PlayListPaths.at(nextIndex);
+      m_LoudnessScanner->Prioritize(m_PlayListPaths.at(nextIndex));
+    }
+
+    m_LoudnessScanner->Prioritize(m_CurrentTrack);
+    m_LoudnessScanner->SetBusyTracks(busyTracks);
+  }
+
+  // Gain is picked at track start, and ramped to the measured one if the
+  // track is measured while playing. The outgoing track keeps its own gain
+  // while fading out.
+  m_GainTimer.stop();
+  m_OutgoingGain = m_TrackGain;
+  m_TrackGain = ReplayGainFactor(m_CurrentTrack);
+  ApplyEqualizer();
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  m_MediaPlayer.setSource(QUrl::fromLocalFile(m_CurrentTrack));
-#else
-  m_MediaPlayer.setMedia(QUrl::fromLocalFile(m_CurrentTrack));
+  if (m_AudioEngine != nullptr)
+  {
+    // Engine has already continued into the track if it was queued
+    if (!m_EngineAdvanced || (m_AudioEngine->Source() != m_CurrentTrack))
+    {
+      m_AudioEngine->SetSource(m_CurrentTrack);
+    }
+
+    ApplyVolume();
+    m_PlaybackClock->Seek(m_AudioEngine->Position());
+    m_AudioEngine->Play();
+  }
+  else
 #endif
-  m_MediaPlayer.play();
+  {
+    PlayMediaPlayerTrack(p_Crossfade);
+  }
 
   if (m_Spectrum->IsRunning())
   {
-    m_Spectrum->StartTrack(m_CurrentTrack);
+    m_Spectrum->StartTrack(m_CurrentTrack, 0, Duration());
   }
 
-  if (p_Forward)
+  if (m_Shuffle && p_Forward)
   {
-    m_CurrentIndexHistory.push_front(m_CurrentIndex);
-    while (m_CurrentIndexHistory.size() > 1000)
-    {
-      // restrict max history kept
-      m_CurrentIndexHistory.removeLast();
-    }
+    // Queued or selected tracks are moved into the order, so that they are
+    // not played again in the same cycle
+    m_ShuffleOrder.SetCurrent(m_CurrentIndex);
   }
 
+  PrepareNextTracks();
+
   emit CurrentIndexChanged(m_CurrentIndex);
 #ifdef HAS_GUI
   emit TrackChanged(m_CurrentTrack);
 #endif
 }
 
+void AudioPlayer::PlayMediaPlayerTrack(bool p_Crossfade)
+{
+  const bool preloaded = (m_CurrentTrack == m_PreloadedTrack) &&
+    (m_NextMediaPlayer->mediaStatus() != QMediaPlayer::InvalidMedia);
+  if (preloaded)
+  {
+    // Next track is already opened and buffered, start it in place of the
+    // current one
+    SwapMediaPlayers(p_Crossfade /*p_KeepOutgoing*/);
+  }
+  else
+  {
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+    m_MediaPlayer->setSource(QUrl::fromLocalFile(m_CurrentTrack));
+#else
+    m_MediaPlayer->setMedia(QUrl::fromLocalFile(m_CurrentTrack));
+#endif
+  }
+
+  if (preloaded && p_Crossfade)
+  {
+    // Outgoing track is left playing, fading out over its remaining time
+    m_FadeDurationMs = qMax(1ll, m_NextMediaPlayer->duration() - m_NextMediaPlayer->position());
+    m_FadeElapsed.start();
+    m_FadeTimer.start();
+  }
+
+  ApplyVolume();
+  m_PlaybackClock->Seek(0);
+  m_MediaPlayer->play();
+  m_HandoffPreloaded = preloaded;
+}
+
+void AudioPlayer::OnPositionChanged(qint64 p_Position)
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  const qint64 lateMs = (m_AudioEngine != nullptr) ? kLateEnginePositionMs : kLatePositionMs;
+#else
+  const qint64 lateMs = kLatePositionMs;
+#endif
+  if (m_PositionUpdateTimer.isValid())
+  {
+    const qint64 intervalMs = m_PositionUpdateTimer.restart();
+    if (intervalMs > lateMs)
+    {
+      PlaybackStats::Record(PlaybackStats::LatePosition, QString("%1 ms").arg(intervalMs));
+    }
+  }
+  else
+  {
+    m_PositionUpdateTimer.start();
+  }
+
+  if (m_HandoffTimer.isValid() && (p_Position > 0))
+  {
+    // Time from end of previous track until first audio of this one, less
+    // what has already been played
+    const qint64 gapMs = qMax(0ll, m_HandoffTimer.elapsed() - p_Position);
+    m_HandoffTimer.invalidate();
+    Log::Info("Track handoff gap %lld ms (preloaded=%d) track=%s", gapMs, m_HandoffPreloaded,
+              m_CurrentTrack.toStdString().c_str());
+  }
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    // Queue next track in the engine, for it to continue without a gap or
+    // crossfade into it
+    const qint64 duration = m_AudioEngine->Duration();
+    const int nextIndex = PeekNextIndex();
+    if ((duration > 0) && ((duration - p_Position) <= (kPreloadLeadMs + m_CrossfadeMs)) && (nextIndex >= 0))
+    {
+      m_AudioEngine->SetNextSource(m_PlayListPaths.at(nextIndex));
+    }
+
+    return;
+  }
+#endif
+
+  // Next player is busy with the outgoing track during a crossfade
+  if (m_FadeTimer.isActive()) return;
+
+  const qint64 duration = m_MediaPlayer->duration();
+  const qint64 remaining = duration - p_Position;
+  if ((duration <= 0) || (remaining > (kPreloadLeadMs + m_CrossfadeMs))) return;
+
+  const int nextIndex = PeekNextIndex();
+  if (nextIndex < 0) return;
+
+  const QString& nextTrack = m_PlayListPaths.at(nextIndex);
+  if (nextTrack != m_PreloadedTrack)
+  {
+    PreloadTrack(nextTrack);
+    return;
+  }
+
+  // Start crossfade once the next track is buffered, unless the current
+  // track is too short to fade out of
+  const QMediaPlayer::MediaStatus nextStatus = m_NextMediaPlayer->mediaStatus();
+  const bool nextReady = (nextStatus == QMediaPlayer::LoadedMedia) ||
+    (nextStatus == QMediaPlayer::BufferingMedia) || (nextStatus == QMediaPlayer::BufferedMedia);
+  if ((m_CrossfadeMs > 0) && (remaining <= m_CrossfadeMs) && (duration > (2 * m_CrossfadeMs)) && nextReady)
+  {
+    Log::Debug("Crossfade to track=%s over %lld ms", nextTrack.toStdString().c_str(), remaining);
+    m_PlayStats.TrackEnded();
+    m_FadingTrack = m_CurrentTrack;
+    AdvanceIndex();
+    OnMediaChanged(true /*p_Forward*/, true /*p_Crossfade*/);
+  }
+}
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+void AudioPlayer::OnEngineTrackAdvanced(const QString& p_Track)
+{
+  m_PlayStats.TrackEnded();
+  if (m_Prefetcher != nullptr)
+  {
+    m_Prefetcher->TrackPlayed(m_CurrentTrack);
+  }
+
+  const int nextIndex = PeekNextIndex();
+  if ((nextIndex >= 0) && (m_PlayListPaths.at(nextIndex) == p_Track))
+  {
+    AdvanceIndex();
+  }
+  else
+  {
+    // Queue or playlist changed after the track was handed to the engine
+    const int index = m_PlayListPaths.indexOf(p_Track);
+    if (index >= 0)
+    {
+      m_CurrentIndex = index;
+    }
+  }
+
+  m_EngineAdvanced = true;
+  OnMediaChanged(true /*p_Forward*/);
+  m_EngineAdvanced = false;
+}
+#endif
+
+void AudioPlayer::OnFadeTimer()
+{
+  if (m_FadeElapsed.elapsed() >= m_FadeDurationMs)
+  {
+    // Outgoing track has played out
+    if (m_Prefetcher != nullptr)
+    {
+      m_Prefetcher->TrackPlayed(m_FadingTrack);
+    }
+
+    StopCrossfade();
+  }
+  else
+  {
+    ApplyVolume();
+  }
+}
+
+void AudioPlayer::StopCrossfade()
+{
+  if (!m_FadeTimer.isActive()) return;
+
+  m_FadeTimer.stop();
+  ClearPreload();
+  ApplyVolume();
+}
+
+void AudioPlayer::SetOutputVolume(float p_Volume)
+{
+  m_Volume = qBound(0.0f, p_Volume, 1.0f);
+  ApplyVolume();
+  emit VolumeChanged((int)round(m_Volume * 100.0));
+}
+
+void AudioPlayer::ApplyVolume()
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    // Track gain is applied per stream in the engine, which mixes crossfades
+    m_AudioEngine->SetVolume(m_Volume);
+    m_AudioEngine->SetTrackGain(m_TrackGain);
+  }
+#endif
+
+  // Equal-power ramps during crossfade, otherwise next player is kept muted
+  float gainIn = 1.0f;
+  float gainOut = 0.0f;
+  if (m_FadeTimer.isActive())
+  {
+    const float t = qBound(0.0f, (float)m_FadeElapsed.elapsed() / (float)m_FadeDurationMs, 1.0f);
+    gainIn = sinf(t * (float)M_PI_2);
+    gainOut = cosf(t * (float)M_PI_2);
+  }
+
+  SetPlayerVolume(m_MediaPlayer, m_Volume * gainIn * m_TrackGain);
+  SetPlayerVolume(m_NextMediaPlayer, m_Volume * gainOut * m_OutgoingGain);
+}
+
+void AudioPlayer::OnLoudnessUpdated(const QString& p_Track)
+{
+  if (p_Track != m_CurrentTrack) return;
+
+  const float gain = ReplayGainFactor(p_Track);
+  if (gain == (m_GainTimer.isActive() ? m_GainTo : m_TrackGain)) return;
+
+  Log::Debug("Track gain %.3f -> %.3f track=%s", m_TrackGain, gain, p_Track.toStdString().c_str());
+  m_GainFrom = m_TrackGain;
+  m_GainTo = gain;
+  m_GainElapsed.start();
+  m_GainTimer.start();
+}
+
+void AudioPlayer::OnGainTimer()
+{
+  const float t = qBound(0.0f, (float)m_GainElapsed.elapsed() / (float)kGainRampMs, 1.0f);
+  m_TrackGain = m_GainFrom + ((m_GainTo - m_GainFrom) * t);
+  if (t >= 1.0f)
+  {
+    m_GainTimer.stop();
+  }
+
+  ApplyVolume();
+}
+
+float AudioPlayer::ReplayGainFactor(const QString& p_Track) const
+{
+  LoudnessInfo info;
+  if ((m_ReplayGain == "off") || (m_LoudnessScanner == nullptr) ||
+      !m_LoudnessScanner->Find(p_Track, info))
+  {
+    return 1.0f;
+  }
+
+  const bool album = (m_ReplayGain == "album") && info.albumValid;
+  const double lufs = album ? info.albumLufs : info.trackLufs;
+  const double peak = album ? info.albumPeak : info.trackPeak;
+
+  // Only attenuate, as the volume is already the upper limit of the output,
+  // and never beyond what the peak allows
+  double factor = pow(10.0, LoudnessMeter::GainDb(lufs) / 20.0);
+  if (peak > 0.0)
+  {
+    factor = qMin(factor, 1.0 / peak);
+  }
+
+  return (float)qMin(factor, 1.0);
+}
+
+void AudioPlayer::ApplyEqualizer()
+{
+  // Profile of the nearest folder of the current track, if any
+  m_EqualizerFolder.clear();
+  QString preset = m_EqualizerPreset;
+  if (!m_CurrentTrack.isEmpty() && !m_EqualizerFolders.isEmpty())
+  {
+    QDir dir = QFileInfo(m_CurrentTrack).absoluteDir();
+    do
+    {
+      auto it = m_EqualizerFolders.constFind(dir.absolutePath());
+      if (it != m_EqualizerFolders.constEnd())
+      {
+        m_EqualizerFolder = it.key();
+        preset = it.value().toString();
+        break;
+      }
+    }
+    while (dir.cdUp());
+  }
+
+  QVector<float> gains;
+  if (!EqualizerGains(preset, gains))
+  {
+    preset = "flat";
+    EqualizerGains(preset, gains);
+  }
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetEqualizer(gains);
+    emit EqualizerUpdated(m_EqualizerFolder.isEmpty() ? preset : (preset + "*"));
+    return;
+  }
+#endif
+
+  emit EqualizerUpdated(QString());
+}
+
+void AudioPlayer::ApplySpeed()
+{
+  m_PlaybackClock->SetSpeed(m_Speed);
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if (m_AudioEngine != nullptr)
+  {
+    m_AudioEngine->SetSpeed(m_Speed);
+    emit SpeedUpdated(m_Speed);
+    return;
+  }
+#endif
+
+  // Pitch handling of QMediaPlayer rate depends on backend
+  m_MediaPlayer->setPlaybackRate(m_Speed);
+  m_NextMediaPlayer->setPlaybackRate(m_Speed);
+  emit SpeedUpdated(m_Speed);
+}
+
+QStringList AudioPlayer::EqualizerPresets() const
+{
+  QStringList presets = Equalizer::PresetNames();
+  if (!m_EqualizerCustom.isEmpty())
+  {
+    presets << "custom";
+  }
+
+  return presets;
+}
+
+bool AudioPlayer::EqualizerGains(const QString& p_Preset, QVector<float>& p_GainsDb) const
+{
+  if ((p_Preset == "custom") && !m_EqualizerCustom.isEmpty())
+  {
+    p_GainsDb = m_EqualizerCustom;
+    return true;
+  }
+
+  return Equalizer::PresetGains(p_Preset, p_GainsDb);
+}
+
+void AudioPlayer::SetPlayerVolume(QMediaPlayer* p_MediaPlayer, float p_Volume)
+{
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  p_MediaPlayer->audioOutput()->setVolume(p_Volume);
+#else
+  p_MediaPlayer->setVolume((int)round(p_Volume * 100.0));
+#endif
+}
+
+void AudioPlayer::PrepareNextTracks()
+{
+  const int nextIndex = PeekNextIndex();
+  if ((m_Prefetcher != nullptr) && (nextIndex >= 0))
+  {
+    m_Prefetcher->SetNextTrack(m_PlayListPaths.at(nextIndex));
+  }
+
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  if ((m_AudioEngine != nullptr) && (nextIndex >= 0))
+  {
+    // Decode heads of the tracks a skip or restart would play, for them to
+    // start without waiting for the decoder
+    const int previousIndex = PeekPreviousIndex();
+    QStringList headTracks = { m_PlayListPaths.at(nextIndex), m_CurrentTrack };
+    if (previousIndex >= 0)
+    {
+      headTracks << m_PlayListPaths.at(previousIndex);
+    }
+
+    m_AudioEngine->SetHeadTracks(headTracks);
+  }
+#endif
+}
+
+void AudioPlayer::PreloadTrack(const QString& p_Track)
+{
+  Log::Debug("Preloading next track=%s", p_Track.toStdString().c_str());
+  m_PreloadedTrack = p_Track;
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  m_NextMediaPlayer->setSource(QUrl::fromLocalFile(p_Track));
+#else
+  m_NextMediaPlayer->setMedia(QUrl::fromLocalFile(p_Track));
+#endif
+
+  // Pausing a stopped player starts its decoder, filling its buffers
+  // without producing any output
+  m_NextMediaPlayer->pause();
+}
+
+void AudioPlayer::ClearPreload()
+{
+  m_PreloadedTrack.clear();
+  m_NextMediaPlayer->stop();
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  m_NextMediaPlayer->setSource(QUrl());
+#else
+  m_NextMediaPlayer->setMedia(QMediaContent());
+#endif
+}
+
+void AudioPlayer::SwapMediaPlayers(bool p_KeepOutgoing)
+{
+  DisconnectMediaPlayer(m_MediaPlayer);
+  std::swap(m_MediaPlayer, m_NextMediaPlayer);
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  m_AudioOutput.swap(m_NextAudioOutput);
+#endif
+  ConnectMediaPlayer(m_MediaPlayer);
+
+  // Duration was reported while the player was still disconnected
+  emit DurationChanged(m_MediaPlayer->duration());
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+  QAudioBufferOutput* audioBufferOutput = m_NextMediaPlayer->audioBufferOutput();
+  m_NextMediaPlayer->setAudioBufferOutput(nullptr);
+  m_MediaPlayer->setAudioBufferOutput(audioBufferOutput);
+#endif
+
+  if (p_KeepOutgoing)
+  {
+    m_PreloadedTrack.clear();
+  }
+  else
+  {
+    ClearPreload();
+  }
+}
+
+void AudioPlayer::ConnectMediaPlayer(QMediaPlayer* p_MediaPlayer)
+{
+  connect(p_MediaPlayer, &QMediaPlayer::mediaStatusChanged, this, &AudioPlayer::OnMediaStatusChanged);
+  connect(p_MediaPlayer, &QMediaPlayer::positionChanged, this, &AudioPlayer::PositionChanged);
+  connect(p_MediaPlayer, &QMediaPlayer::positionChanged, this, &AudioPlayer::OnPositionChanged);
+  connect(p_MediaPlayer, &QMediaPlayer::durationChanged, this, &AudioPlayer::DurationChanged);
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  connect(p_MediaPlayer, &QMediaPlayer::errorOccurred, this, &AudioPlayer::OnErrorOccurred);
+#else
+  connect(p_MediaPlayer, QOverload<QMediaPlayer::Error>::of(&QMediaPlayer::error), this, &AudioPlayer::OnErrorOccurred);
+#endif
+
+  connect(p_MediaPlayer, &QMediaPlayer::positionChanged, m_PlaybackClock, &PlaybackClock::Update);
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+  connect(p_MediaPlayer, &QMediaPlayer::playbackStateChanged, this, [this](QMediaPlayer::PlaybackState p_State)
+#else
+  connect(p_MediaPlayer, &QMediaPlayer::stateChanged, this, [this](QMediaPlayer::State p_State)
+#endif
+  {
+    m_PlaybackClock->SetPlaying(p_State == QMediaPlayer::PlayingState);
+  });
+
+  connect(p_MediaPlayer, &QMediaPlayer::durationChanged, m_Spectrum, &Spectrum::SetDuration);
+}
+
+void AudioPlayer::DisconnectMediaPlayer(QMediaPlayer* p_MediaPlayer)
+{
+  disconnect(p_MediaPlayer, nullptr, this, nullptr);
+  disconnect(p_MediaPlayer, nullptr, m_PlaybackClock, nullptr);
+  disconnect(p_MediaPlayer, nullptr, m_Spectrum, nullptr);
+}
+
 void AudioPlayer::ListFiles(const std::string& p_Path, std::vector<std::string>& p_Files)
 {
   DIR* dir = opendir(p_Path.c_str());
@@ -10,16 +10,31 @@
 
 #include <QtGlobal>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QMediaPlayer>
+#include <QTimer>
+#include <QVariantMap>
 
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
 #include <QMediaDevices>
 #endif
 
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAudioBufferOutput>
+#endif
+
 #include <string>
 #include <vector>
 
+#include "aliassampler.h"
+#include "audioengine.h"
+#include "loudnessscanner.h"
+#include "playbackclock.h"
+#include "playqueue.h"
+#include "playstats.h"
+#include "prefetcher.h"
+#include "shuffleorder.h"
 #include "spectrum.h"
 
 class AudioPlayer : public QObject
@@ -37,6 +52,32 @@ public:
   void SetQueuePaths(const QVector<QString>& p_QueuePaths);
   bool IsInited();
   void Shutdown();
+  const PlaybackClock* GetPlaybackClock() const;
+  void SetAnalyzerFrameRate(int p_Fps);
+  void SetEngine(const QString& p_Engine);
+  void GetEngine(QString& p_Engine);
+  void SetCrossfade(int p_Seconds);
+  void GetCrossfade(int& p_Seconds);
+  void SetReplayGain(const QString& p_Mode);
+  void GetReplayGain(QString& p_Mode);
+  void SetReplayGainTags(bool p_WriteTags);
+  void GetReplayGainTags(bool& p_WriteTags);
+  void SetShuffleSpread(const QString& p_Spread);
+  void GetShuffleSpread(QString& p_Spread);
+  void SetSmartShuffle(bool p_SmartShuffle);
+  void GetSmartShuffle(bool& p_SmartShuffle);
+  void SetShuffleState(const QStringList& p_Order, int p_Cursor);
+  void GetShuffleState(QStringList& p_Order, int& p_Cursor);
+  void SetPrefetch(int p_Megabytes);
+  void GetPrefetch(int& p_Megabytes);
+  void SetEqualizerPreset(const QString& p_Preset);
+  void GetEqualizerPreset(QString& p_Preset);
+  void SetEqualizerCustom(const QString& p_Gains);
+  void GetEqualizerCustom(QString& p_Gains);
+  void SetEqualizerFolders(const QVariantMap& p_Folders);
+  void GetEqualizerFolders(QVariantMap& p_Folders);
+  void SetSpeed(float p_Speed);
+  void GetSpeed(float& p_Speed);
 
 signals:
 
@@ -51,7 +92,9 @@ signals:
   void PlaybackModeUpdated(bool p_Shuffle);
   void RefreshTrackData(int p_TrackIndex);
   void SpectrumChanged(const QVector<float>& p_Spectrum);
-  void QueueUpdated(const QVector<int>& p_Queue);
+  void QueueUpdated(const PlayQueue* p_Queue);
+  void EqualizerUpdated(const QString& p_Preset);
+  void SpeedUpdated(float p_Speed);
 #ifdef HAS_GUI
   void TrackChanged(const QString& p_TrackPath);
   void RefreshLyrics(const QString& p_TrackPath);
@@ -75,34 +118,115 @@ public slots:
   void Next();
   void SetCurrentIndex(int);
   void SetAnalyzerEnabled(bool p_Enabled);
+  void SetAnalyzerBandCount(int p_BandCount);
   void EnqueueTrack(int p_Index);
+  void EnqueueTracks(const QVector<int>& p_Indices);
   void UnenqueueTrack(int p_Index);
+  void TrackPlayed(int p_Index);
+  void CycleEqualizer();
+  void ToggleEqualizerFolder();
+  void SpeedUp();
+  void SpeedDown();
 
 private slots:
   void OnMediaStatusChanged(QMediaPlayer::MediaStatus p_MediaStatus);
+  void OnPositionChanged(qint64 p_Position);
+  void OnFadeTimer();
+  void OnLoudnessUpdated(const QString& p_Track);
+  void OnGainTimer();
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
   void OnErrorOccurred(QMediaPlayer::Error p_Error, const QString& p_ErrorString);
   void OnAudioOutputsChanged();
+  void OnEngineTrackAdvanced(const QString& p_Track);
 #else
   void OnErrorOccurred(QMediaPlayer::Error p_Error);
 #endif
 
 private:
-  void OnMediaChanged(bool p_Forward);
+  void OnMediaChanged(bool p_Forward, bool p_Crossfade = false);
+  void PlayMediaPlayerTrack(bool p_Crossfade);
+  void SeekPosition(qint64 p_PositionMs, bool p_Play);
+  qint64 Position() const;
+  qint64 Duration() const;
+  void AdvanceIndex();
+  int PeekNextIndex();
+  int PeekPreviousIndex() const;
+  int PeekSmartIndex();
+  void BuildSampler();
+  void UpdateWeight(int p_Index);
+  void PrepareNextTracks();
+  void PreloadTrack(const QString& p_Track);
+  void ClearPreload();
+  void SwapMediaPlayers(bool p_KeepOutgoing);
+  void StopCrossfade();
+  void SetOutputVolume(float p_Volume);
+  void ApplyVolume();
+  float ReplayGainFactor(const QString& p_Track) const;
+  void ApplyEqualizer();
+  void ApplySpeed();
+  QStringList EqualizerPresets() const;
+  bool EqualizerGains(const QString& p_Preset, QVector<float>& p_GainsDb) const;
+  static void SetPlayerVolume(QMediaPlayer* p_MediaPlayer, float p_Volume);
+  void ConnectMediaPlayer(QMediaPlayer* p_MediaPlayer);
+  void DisconnectMediaPlayer(QMediaPlayer* p_MediaPlayer);
   static void ListFiles(const std::string& p_Path, std::vector<std::string>& p_Files);
   static bool IsSupportedFileType(const QString& p_Path);
 
 private:
-  QMediaPlayer m_MediaPlayer;
+  QMediaPlayer* m_MediaPlayer = nullptr;
+  QMediaPlayer* m_NextMediaPlayer = nullptr;
+  QString m_PreloadedTrack;
+  QElapsedTimer m_HandoffTimer;
+  bool m_HandoffPreloaded = false;
+  QElapsedTimer m_PositionUpdateTimer;
+  float m_Volume = 1.0f;
+  int m_CrossfadeMs = 0;
+  qint64 m_FadeDurationMs = 0;
+  QElapsedTimer m_FadeElapsed;
+  QTimer m_FadeTimer;
   QVector<QString> m_PlayListPaths;
   bool m_Shuffle = false;
   int m_CurrentIndex = 0;
   QString m_CurrentTrack;
-  QList<int> m_CurrentIndexHistory;
-  QVector<int> m_Queue;
+  ShuffleOrder m_ShuffleOrder;
+  ShuffleOrder::Spread m_ShuffleSpread = ShuffleOrder::SpreadOff;
+  bool m_SmartShuffle = false;
+  int m_SmartNextIndex = -1;
+  AliasSampler m_Sampler;
+  QVector<int> m_SamplerIndices;
+  int m_SamplerCycle = -1;
+  std::vector<float> m_Weights;
+  int m_StartedIndex = -1;
+  PlayStats m_PlayStats;
+  PlayQueue m_Queue;
+  PlaybackClock* m_PlaybackClock = nullptr;
   Spectrum* m_Spectrum = nullptr;
+  QString m_Engine;
+  LoudnessScanner* m_LoudnessScanner = nullptr;
+  QString m_ReplayGain = "off";
+  bool m_ReplayGainTags = false;
+  float m_TrackGain = 1.0f;
+  float m_OutgoingGain = 1.0f;
+  float m_GainFrom = 1.0f;
+  float m_GainTo = 1.0f;
+  QElapsedTimer m_GainElapsed;
+  QTimer m_GainTimer;
+  Prefetcher* m_Prefetcher = nullptr;
+  int m_PrefetchMb = 0;
+  QString m_FadingTrack;
+  QString m_EqualizerPreset = "flat";
+  QVector<float> m_EqualizerCustom;
+  QVariantMap m_EqualizerFolders;
+  QString m_EqualizerFolder;
+  float m_Speed = 1.0f;
 #if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
   QScopedPointer<QAudioOutput> m_AudioOutput;
+  QScopedPointer<QAudioOutput> m_NextAudioOutput;
   QMediaDevices m_MediaDevices;
+  AudioEngine* m_AudioEngine = nullptr;
+  bool m_EngineAdvanced = false;
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+  QScopedPointer<QAudioBufferOutput> m_AudioBufferOutput;
 #endif
 };
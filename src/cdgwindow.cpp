@@ -28,6 +28,7 @@
 #endif
 
 static const bool s_SmoothScaling = true;
+static const int s_PositionIntervalMs = 20;
 
 CdgWindow::CdgWindow(QWidget* p_Parent)
   : QWidget(p_Parent)
@@ -37,6 +38,21 @@ CdgWindow::CdgWindow(QWidget* p_Parent)
   setWindowTitle("namp cdg");
   resize(CDG_WIDTH * 2, CDG_HEIGHT * 2);
   setMinimumSize(CDG_WIDTH, CDG_HEIGHT);
+
+  // Sample playback clock at own frame rate while visible
+  m_PositionTimer.setInterval(s_PositionIntervalMs);
+  connect(&m_PositionTimer, &QTimer::timeout, this, [this]()
+  {
+    if (m_PlaybackClock != nullptr)
+    {
+      UpdatePosition(m_PlaybackClock->AudiblePosition());
+    }
+  });
+}
+
+void CdgWindow::SetPlaybackClock(const PlaybackClock* p_PlaybackClock)
+{
+  m_PlaybackClock = p_PlaybackClock;
 }
 
 void CdgWindow::TrackChanged(const QString& p_TrackPath)
@@ -89,7 +105,7 @@ void CdgWindow::TrackChanged(const QString& p_TrackPath)
   }
 }
 
-void CdgWindow::PositionChanged(qint64 p_PositionMs)
+void CdgWindow::UpdatePosition(qint64 p_PositionMs)
 {
   if (!m_HasCdg || !isVisible()) return;
 
@@ -209,6 +225,7 @@ void CdgWindow::closeEvent(QCloseEvent* p_Event)
 void CdgWindow::showEvent(QShowEvent* p_Event)
 {
   QWidget::showEvent(p_Event);
+  m_PositionTimer.start();
 #ifdef __APPLE__
   ShowDockIcon();
 #endif
@@ -217,6 +234,7 @@ void CdgWindow::showEvent(QShowEvent* p_Event)
 void CdgWindow::hideEvent(QHideEvent* p_Event)
 {
   QWidget::hideEvent(p_Event);
+  m_PositionTimer.stop();
 #ifdef __APPLE__
   HideDockIcon();
 #endif
@@ -10,9 +10,11 @@
 
 #include <QByteArray>
 #include <QImage>
+#include <QTimer>
 #include <QWidget>
 
 #include "cdg.h"
+#include "playbackclock.h"
 
 class CdgWindow : public QWidget
 {
@@ -22,10 +24,10 @@ public:
   CdgWindow(QWidget* p_Parent = nullptr);
   void SetEnabled(bool p_Enabled);
   void GetEnabled(bool& p_Enabled);
+  void SetPlaybackClock(const PlaybackClock* p_PlaybackClock);
 
 public slots:
   void TrackChanged(const QString& p_TrackPath);
-  void PositionChanged(qint64 p_PositionMs);
   void ToggleCdg();
   void ToggleFullScreen();
 
@@ -40,6 +42,7 @@ protected:
   void keyPressEvent(QKeyEvent* p_Event) override;
 
 private:
+  void UpdatePosition(qint64 p_PositionMs);
   void RenderFrame();
 
   CDG m_Decoder;
@@ -49,4 +52,6 @@ private:
   QImage m_Image;
   bool m_HasCdg = false;
   bool m_Enabled = true;
+  QTimer m_PositionTimer;
+  const PlaybackClock* m_PlaybackClock = nullptr;
 };
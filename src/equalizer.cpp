@@ -0,0 +1,290 @@
+// equalizer.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "equalizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static const float kFrequencies[Equalizer::kBands] =
+{
+  31.25f, 62.5f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f
+};
+
+// One octave bandwidth
+static const float kQ = 1.41f;
+
+static const float kMinGainDb = -12.0f;
+static const float kMaxGainDb = 12.0f;
+
+// State below which a decaying filter is set to silence, as denormal floats
+// are slow to compute with
+static const float kDenormal = 1.0e-15f;
+
+// Audio processed per load measurement
+static const qint64 kLoadWindowNs = 1000000000ll;
+
+struct EqualizerPreset
+{
+  const char* name;
+  float gains[Equalizer::kBands];
+};
+
+static const EqualizerPreset kPresets[] =
+{
+  { "flat", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+  { "bass", { 6, 5, 4, 2, 0, 0, 0, 0, 0, 0 } },
+  { "treble", { 0, 0, 0, 0, 0, 0, 2, 4, 5, 6 } },
+  { "vocal", { -2, -2, -1, 1, 3, 3, 2, 1, 0, -1 } },
+  { "rock", { 4, 3, 2, 0, -1, -1, 0, 2, 3, 4 } },
+  { "classical", { 0, 0, 0, 0, 0, 0, -2, -3, -3, -4 } },
+};
+
+Equalizer::Equalizer()
+{
+}
+
+void Equalizer::SetSampleRate(int p_SampleRate)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PendingSampleRate = p_SampleRate;
+  m_Changed.store(true, std::memory_order_release);
+}
+
+void Equalizer::SetGains(const QVector<float>& p_GainsDb)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PendingGains = p_GainsDb;
+  m_Changed.store(true, std::memory_order_release);
+}
+
+void Equalizer::Process(float* p_Samples, size_t p_Frames)
+{
+  // Settings being changed are picked up by a later block
+  if (m_Changed.load(std::memory_order_acquire) && m_Mutex.tryLock())
+  {
+    UpdateFilters();
+    m_Changed.store(false, std::memory_order_relaxed);
+    m_Mutex.unlock();
+  }
+
+  if (m_SampleRate <= 0) return;
+
+  const qint64 audioNs = (static_cast<qint64>(p_Frames) * 1000000000ll) / m_SampleRate;
+  if ((m_BandCount == 0) && (m_Preamp == 1.0f))
+  {
+    m_AudioNs.fetch_add(audioNs, std::memory_order_relaxed);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  float* samples = p_Samples;
+
+#if defined(__SSE__) || defined(_M_X64)
+  __m128 b0[kBands], b1[kBands], b2[kBands], a1[kBands], a2[kBands], z1[kBands], z2[kBands];
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    const Band& band = m_Bands[b];
+    b0[b] = _mm_setr_ps(band.b0[0], band.b0[1], 0.0f, 0.0f);
+    b1[b] = _mm_setr_ps(band.b1[0], band.b1[1], 0.0f, 0.0f);
+    b2[b] = _mm_setr_ps(band.b2[0], band.b2[1], 0.0f, 0.0f);
+    a1[b] = _mm_setr_ps(band.a1[0], band.a1[1], 0.0f, 0.0f);
+    a2[b] = _mm_setr_ps(band.a2[0], band.a2[1], 0.0f, 0.0f);
+    z1[b] = _mm_setr_ps(band.z1[0], band.z1[1], 0.0f, 0.0f);
+    z2[b] = _mm_setr_ps(band.z2[0], band.z2[1], 0.0f, 0.0f);
+  }
+
+  const __m128 preamp = _mm_set1_ps(m_Preamp);
+  for (size_t i = 0; i < p_Frames; ++i, samples += 2)
+  {
+    // Transposed direct form II, left and right in the two low lanes
+    __m128 x = _mm_mul_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(samples)), preamp);
+    for (int b = 0; b < m_BandCount; ++b)
+    {
+      const __m128 y = _mm_add_ps(_mm_mul_ps(b0[b], x), z1[b]);
+      z1[b] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(b1[b], x), z2[b]), _mm_mul_ps(a1[b], y));
+      z2[b] = _mm_sub_ps(_mm_mul_ps(b2[b], x), _mm_mul_ps(a2[b], y));
+      x = y;
+    }
+
+    _mm_storel_pi(reinterpret_cast<__m64*>(samples), x);
+  }
+
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    float state[4];
+    _mm_storeu_ps(state, z1[b]);
+    m_Bands[b].z1[0] = state[0];
+    m_Bands[b].z1[1] = state[1];
+    _mm_storeu_ps(state, z2[b]);
+    m_Bands[b].z2[0] = state[0];
+    m_Bands[b].z2[1] = state[1];
+  }
+#elif defined(__ARM_NEON)
+  float32x2_t b0[kBands], b1[kBands], b2[kBands], a1[kBands], a2[kBands], z1[kBands], z2[kBands];
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    const Band& band = m_Bands[b];
+    b0[b] = vld1_f32(band.b0);
+    b1[b] = vld1_f32(band.b1);
+    b2[b] = vld1_f32(band.b2);
+    a1[b] = vld1_f32(band.a1);
+    a2[b] = vld1_f32(band.a2);
+    z1[b] = vld1_f32(band.z1);
+    z2[b] = vld1_f32(band.z2);
+  }
+
+  for (size_t i = 0; i < p_Frames; ++i, samples += 2)
+  {
+    // Transposed direct form II, left and right in the two lanes
+    float32x2_t x = vmul_n_f32(vld1_f32(samples), m_Preamp);
+    for (int b = 0; b < m_BandCount; ++b)
+    {
+      const float32x2_t y = vmla_f32(z1[b], b0[b], x);
+      z1[b] = vmls_f32(vmla_f32(z2[b], b1[b], x), a1[b], y);
+      z2[b] = vmls_f32(vmul_f32(b2[b], x), a2[b], y);
+      x = y;
+    }
+
+    vst1_f32(samples, x);
+  }
+
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    vst1_f32(m_Bands[b].z1, z1[b]);
+    vst1_f32(m_Bands[b].z2, z2[b]);
+  }
+#else
+  for (size_t i = 0; i < p_Frames; ++i, samples += 2)
+  {
+    for (int ch = 0; ch < 2; ++ch)
+    {
+      // Transposed direct form II
+      float x = samples[ch] * m_Preamp;
+      for (int b = 0; b < m_BandCount; ++b)
+      {
+        Band& band = m_Bands[b];
+        const float y = (band.b0[ch] * x) + band.z1[ch];
+        band.z1[ch] = (band.b1[ch] * x) + band.z2[ch] - (band.a1[ch] * y);
+        band.z2[ch] = (band.b2[ch] * x) - (band.a2[ch] * y);
+        x = y;
+      }
+
+      samples[ch] = x;
+    }
+  }
+#endif
+
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    for (int ch = 0; ch < 2; ++ch)
+    {
+      if (std::fabs(m_Bands[b].z1[ch]) < kDenormal) m_Bands[b].z1[ch] = 0.0f;
+      if (std::fabs(m_Bands[b].z2[ch]) < kDenormal) m_Bands[b].z2[ch] = 0.0f;
+    }
+  }
+
+  const qint64 busyNs =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  m_BusyNs.fetch_add(busyNs, std::memory_order_relaxed);
+  m_AudioNs.fetch_add(audioNs, std::memory_order_relaxed);
+}
+
+bool Equalizer::TakeLoad(float& p_Load)
+{
+  if (m_AudioNs.load(std::memory_order_relaxed) < kLoadWindowNs) return false;
+
+  const qint64 audioNs = m_AudioNs.exchange(0, std::memory_order_relaxed);
+  const qint64 busyNs = m_BusyNs.exchange(0, std::memory_order_relaxed);
+  p_Load = static_cast<float>(busyNs) / static_cast<float>(audioNs);
+  return true;
+}
+
+QStringList Equalizer::PresetNames()
+{
+  QStringList names;
+  for (const EqualizerPreset& preset : kPresets)
+  {
+    names << preset.name;
+  }
+
+  return names;
+}
+
+bool Equalizer::PresetGains(const QString& p_Name, QVector<float>& p_GainsDb)
+{
+  for (const EqualizerPreset& preset : kPresets)
+  {
+    if (p_Name == preset.name)
+    {
+      p_GainsDb = QVector<float>(preset.gains, preset.gains + kBands);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Equalizer::UpdateFilters()
+{
+  // Filter state is kept across gain changes, and cleared on rate change
+  const bool rateChanged = (m_PendingSampleRate != m_SampleRate);
+  m_SampleRate = m_PendingSampleRate;
+
+  Band bands[kBands] = {};
+  int bandCount = 0;
+  float maxGainDb = 0.0f;
+  for (int i = 0; (i < kBands) && (i < m_PendingGains.size()) && (m_SampleRate > 0); ++i)
+  {
+    const float gainDb = qBound(kMinGainDb, m_PendingGains.at(i), kMaxGainDb);
+    if ((gainDb == 0.0f) || (kFrequencies[i] >= (0.45f * m_SampleRate))) continue;
+
+    // Peaking filter, from the Audio EQ Cookbook by Robert Bristow-Johnson
+    const float a = powf(10.0f, gainDb / 40.0f);
+    const float w0 = (2.0f * static_cast<float>(M_PI) * kFrequencies[i]) / m_SampleRate;
+    const float alpha = sinf(w0) / (2.0f * kQ);
+    const float a0 = 1.0f + (alpha / a);
+    Band& band = bands[bandCount];
+    band.index = i;
+    for (int ch = 0; ch < 2; ++ch)
+    {
+      band.b0[ch] = (1.0f + (alpha * a)) / a0;
+      band.b1[ch] = (-2.0f * cosf(w0)) / a0;
+      band.b2[ch] = (1.0f - (alpha * a)) / a0;
+      band.a1[ch] = (-2.0f * cosf(w0)) / a0;
+      band.a2[ch] = (1.0f - (alpha / a)) / a0;
+    }
+
+    // State of a band that was already active is carried over
+    for (int b = 0; (b < m_BandCount) && !rateChanged; ++b)
+    {
+      if (m_Bands[b].index == i)
+      {
+        std::copy(m_Bands[b].z1, m_Bands[b].z1 + 2, band.z1);
+        std::copy(m_Bands[b].z2, m_Bands[b].z2 + 2, band.z2);
+        break;
+      }
+    }
+
+    maxGainDb = qMax(maxGainDb, gainDb);
+    ++bandCount;
+  }
+
+  std::copy(bands, bands + kBands, m_Bands);
+  m_BandCount = bandCount;
+
+  // Headroom for the largest boost, so that boosted bands do not clip
+  m_Preamp = powf(10.0f, -maxGainDb / 20.0f);
+}
@@ -0,0 +1,73 @@
+// equalizer.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+// Ten band equalizer as a cascade of peaking biquad filters at octave spaced
+// frequencies, for interleaved stereo float audio. Both channels of a frame
+// are filtered together in SIMD lanes, using SSE or NEON where available.
+// Gains are set from the GUI thread and picked up by the audio thread at the
+// start of the next block.
+class Equalizer
+{
+public:
+  static const int kBands = 10;
+
+  Equalizer();
+
+  void SetSampleRate(int p_SampleRate);
+  void SetGains(const QVector<float>& p_GainsDb);
+  void Process(float* p_Samples, size_t p_Frames);
+
+  // Fraction of a core spent processing per second of audio, available once
+  // per second of processed audio
+  bool TakeLoad(float& p_Load);
+
+  static QStringList PresetNames();
+  static bool PresetGains(const QString& p_Name, QVector<float>& p_GainsDb);
+
+private:
+  void UpdateFilters();
+
+private:
+  // Filter coefficients (a0 normalized to 1) and state, two lanes per band
+  // for left and right channel
+  struct Band
+  {
+    int index;
+    float b0[2];
+    float b1[2];
+    float b2[2];
+    float a1[2];
+    float a2[2];
+    float z1[2];
+    float z2[2];
+  };
+
+  // Pending settings, guarded by mutex
+  QMutex m_Mutex;
+  QVector<float> m_PendingGains;
+  int m_PendingSampleRate = 0;
+  std::atomic<bool> m_Changed{false};
+
+  // Audio thread only
+  Band m_Bands[kBands];
+  int m_BandCount = 0;
+  float m_Preamp = 1.0f;
+  int m_SampleRate = 0;
+
+  std::atomic<qint64> m_BusyNs{0};
+  std::atomic<qint64> m_AudioNs{0};
+};
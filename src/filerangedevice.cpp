@@ -0,0 +1,65 @@
+// filerangedevice.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "filerangedevice.h"
+
+FileRangeDevice::FileRangeDevice(const QString& p_Path, qint64 p_Offset, QObject* p_Parent)
+  : QIODevice(p_Parent)
+  , m_File(p_Path)
+  , m_Offset(p_Offset)
+{
+}
+
+bool FileRangeDevice::open(OpenMode p_Mode)
+{
+  if (p_Mode & QIODevice::WriteOnly) return false;
+
+  if (!m_File.open(QIODevice::ReadOnly)) return false;
+
+  m_Offset = qBound(0ll, m_Offset, m_File.size());
+  if (!m_File.seek(m_Offset))
+  {
+    m_File.close();
+    return false;
+  }
+
+  return QIODevice::open(p_Mode);
+}
+
+void FileRangeDevice::close()
+{
+  QIODevice::close();
+  m_File.close();
+}
+
+bool FileRangeDevice::isSequential() const
+{
+  return false;
+}
+
+qint64 FileRangeDevice::size() const
+{
+  return m_File.size() - m_Offset;
+}
+
+bool FileRangeDevice::seek(qint64 p_Pos)
+{
+  if (!QIODevice::seek(p_Pos)) return false;
+
+  return m_File.seek(m_Offset + p_Pos);
+}
+
+qint64 FileRangeDevice::readData(char* p_Data, qint64 p_MaxSize)
+{
+  return m_File.read(p_Data, p_MaxSize);
+}
+
+qint64 FileRangeDevice::writeData(const char* /*p_Data*/, qint64 /*p_MaxSize*/)
+{
+  return -1;
+}
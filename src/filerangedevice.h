@@ -0,0 +1,34 @@
+// filerangedevice.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QFile>
+#include <QIODevice>
+
+// Read-only device exposing the part of a file from a given byte offset, so
+// that a decoder can be started mid-file.
+class FileRangeDevice : public QIODevice
+{
+public:
+  FileRangeDevice(const QString& p_Path, qint64 p_Offset, QObject* p_Parent = nullptr);
+
+  bool open(OpenMode p_Mode) override;
+  void close() override;
+  bool isSequential() const override;
+  qint64 size() const override;
+  bool seek(qint64 p_Pos) override;
+
+protected:
+  qint64 readData(char* p_Data, qint64 p_MaxSize) override;
+  qint64 writeData(const char* p_Data, qint64 p_MaxSize) override;
+
+private:
+  QFile m_File;
+  qint64 m_Offset = 0;
+};
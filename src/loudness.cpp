@@ -0,0 +1,443 @@
+// loudness.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "loudness.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Gating thresholds of BS.1770
+static const double kAbsoluteGateLufs = -70.0;
+static const double kRelativeGateLu = -10.0;
+
+// Taps per phase of the true peak interpolation filter (a multiple of four,
+// for the vectorized dot product)
+static const int kPeakTapsPerPhase = 12;
+
+// Interpolated value of one phase, from the latest samples (newest first)
+static float PeakDot(const float* p_Taps, const float* p_Window)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+  __m128 acc = _mm_setzero_ps();
+  for (int k = 0; k < kPeakTapsPerPhase; k += 4)
+  {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p_Taps + k), _mm_loadu_ps(p_Window + k)));
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__ARM_NEON)
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (int k = 0; k < kPeakTapsPerPhase; k += 4)
+  {
+    acc = vmlaq_f32(acc, vld1q_f32(p_Taps + k), vld1q_f32(p_Window + k));
+  }
+
+  float lanes[4];
+  vst1q_f32(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+  float value = 0.0f;
+  for (int k = 0; k < kPeakTapsPerPhase; ++k)
+  {
+    value += p_Taps[k] * p_Window[k];
+  }
+
+  return value;
+#endif
+}
+
+void LoudnessMeter::Reset(int p_SampleRate, int p_Channels)
+{
+  m_SampleRate = p_SampleRate;
+  m_Channels = p_Channels;
+
+  // K-weighting, a high shelf modelling the head followed by a high pass,
+  // with coefficients derived for the actual sample rate
+  {
+    const double f0 = 1681.974450955533;
+    const double gainDb = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = tan(M_PI * f0 / p_SampleRate);
+    const double vh = pow(10.0, gainDb / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + (k / q) + (k * k);
+    m_Shelf.b0 = (vh + (vb * k / q) + (k * k)) / a0;
+    m_Shelf.b1 = 2.0 * ((k * k) - vh) / a0;
+    m_Shelf.b2 = (vh - (vb * k / q) + (k * k)) / a0;
+    m_Shelf.a1 = 2.0 * ((k * k) - 1.0) / a0;
+    m_Shelf.a2 = (1.0 - (k / q) + (k * k)) / a0;
+  }
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = tan(M_PI * f0 / p_SampleRate);
+    const double a0 = 1.0 + (k / q) + (k * k);
+    m_HighPass.b0 = 1.0;
+    m_HighPass.b1 = -2.0;
+    m_HighPass.b2 = 1.0;
+    m_HighPass.a1 = 2.0 * ((k * k) - 1.0) / a0;
+    m_HighPass.a2 = (1.0 - (k / q) + (k * k)) / a0;
+  }
+
+  // Surround channels are weighted up, and LFE excluded (5.1 in L R C LFE
+  // Ls Rs order)
+  for (int ch = 0; ch < kMaxChannels; ++ch)
+  {
+    m_Weights[ch] = (ch < p_Channels) ? 1.0 : 0.0;
+    if (p_Channels == 6)
+    {
+      m_Weights[ch] = (ch == 3) ? 0.0 : ((ch >= 4) ? 1.41 : 1.0);
+    }
+
+    std::fill(m_State[ch], m_State[ch] + 4, 0.0);
+  }
+
+  // True peak from 4x oversampling (2x at 96 kHz and up), using a windowed
+  // sinc interpolator split into one filter per phase
+  m_Oversample = (p_SampleRate < 96000) ? 4 : ((p_SampleRate < 192000) ? 2 : 1);
+  const int tapCount = m_Oversample * kPeakTapsPerPhase;
+  m_PeakTaps.assign(tapCount, 0.0f);
+  if (m_Oversample > 1)
+  {
+    const double center = (tapCount - 1) / 2.0;
+    for (int phase = 0; phase < m_Oversample; ++phase)
+    {
+      double sum = 0.0;
+      std::vector<double> taps(kPeakTapsPerPhase);
+      for (int i = 0; i < kPeakTapsPerPhase; ++i)
+      {
+        const int n = (i * m_Oversample) + phase;
+        const double x = (n - center) / m_Oversample;
+        const double sinc = (fabs(x) < 1e-9) ? 1.0 : (sin(M_PI * x) / (M_PI * x));
+        const double window = 0.5 * (1.0 - cos((2.0 * M_PI * (n + 0.5)) / tapCount));
+        taps[i] = sinc * window;
+        sum += taps[i];
+      }
+
+      for (int i = 0; i < kPeakTapsPerPhase; ++i)
+      {
+        // Stored per phase, and each phase normalized for unity gain at DC
+        m_PeakTaps[(phase * kPeakTapsPerPhase) + i] = static_cast<float>(taps[i] / sum);
+      }
+    }
+  }
+
+  for (int ch = 0; ch < kMaxChannels; ++ch)
+  {
+    m_PeakHistory[ch].assign(2 * kPeakTapsPerPhase, 0.0f);
+    m_PeakPos[ch] = 0;
+  }
+
+  m_Peak = 0.0f;
+
+  m_SubBlockFrames = qMax(1, p_SampleRate / 10);
+  m_SubBlockPos = 0;
+  m_SubBlockEnergy = 0.0;
+  std::fill(m_SubBlocks, m_SubBlocks + 4, 0.0);
+  m_SubBlockCount = 0;
+  m_Blocks.clear();
+}
+
+void LoudnessMeter::Process(const float* p_Samples, int p_Frames)
+{
+  if ((m_SampleRate <= 0) || (m_Channels <= 0)) return;
+
+  // Chunks never cross a 100 ms sub-block boundary
+  int done = 0;
+  while (done < p_Frames)
+  {
+    const int frames = qMin(p_Frames - done, m_SubBlockFrames - m_SubBlockPos);
+    const float* samples = p_Samples + (static_cast<qint64>(done) * m_Channels);
+    const int channels = qMin(m_Channels, static_cast<int>(kMaxChannels));
+    for (int ch = 0; ch < channels; ch += 2)
+    {
+      if ((ch + 1) < channels)
+      {
+        ProcessPair(ch, samples, frames);
+      }
+      else
+      {
+        ProcessChannel(ch, samples, frames);
+      }
+    }
+
+    done += frames;
+    m_SubBlockPos += frames;
+    if (m_SubBlockPos == m_SubBlockFrames)
+    {
+      EndSubBlock();
+    }
+  }
+}
+
+void LoudnessMeter::ProcessPair(int p_Channel, const float* p_Samples, int p_Frames)
+{
+  // Deinterleave both channels, each into one half of the buffer
+  m_Channel.resize(2 * p_Frames);
+  float* left = m_Channel.data();
+  float* right = left + p_Frames;
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    left[i] = p_Samples[(i * m_Channels) + p_Channel];
+    right[i] = p_Samples[(i * m_Channels) + p_Channel + 1];
+  }
+
+#if defined(__SSE2__) || defined(_M_X64)
+  // Both K-weighting stages in transposed direct form II, with the two
+  // channels in the lanes of a vector
+  double* stateL = m_State[p_Channel];
+  double* stateR = m_State[p_Channel + 1];
+  const __m128d sb0 = _mm_set1_pd(m_Shelf.b0), sb1 = _mm_set1_pd(m_Shelf.b1), sb2 = _mm_set1_pd(m_Shelf.b2);
+  const __m128d sa1 = _mm_set1_pd(m_Shelf.a1), sa2 = _mm_set1_pd(m_Shelf.a2);
+  const __m128d hb0 = _mm_set1_pd(m_HighPass.b0), hb1 = _mm_set1_pd(m_HighPass.b1);
+  const __m128d hb2 = _mm_set1_pd(m_HighPass.b2);
+  const __m128d ha1 = _mm_set1_pd(m_HighPass.a1), ha2 = _mm_set1_pd(m_HighPass.a2);
+  __m128d s1 = _mm_setr_pd(stateL[0], stateR[0]);
+  __m128d s2 = _mm_setr_pd(stateL[1], stateR[1]);
+  __m128d h1 = _mm_setr_pd(stateL[2], stateR[2]);
+  __m128d h2 = _mm_setr_pd(stateL[3], stateR[3]);
+  __m128d energy = _mm_setzero_pd();
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    const __m128d x = _mm_setr_pd(left[i], right[i]);
+    const __m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s1);
+    s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, y)), s2);
+    s2 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+    const __m128d z = _mm_add_pd(_mm_mul_pd(hb0, y), h1);
+    h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, z)), h2);
+    h2 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, z));
+    energy = _mm_add_pd(energy, _mm_mul_pd(z, z));
+  }
+
+  double lanes[2];
+  const __m128d state[4] = { s1, s2, h1, h2 };
+  for (int k = 0; k < 4; ++k)
+  {
+    _mm_storeu_pd(lanes, state[k]);
+    stateL[k] = lanes[0];
+    stateR[k] = lanes[1];
+  }
+
+  _mm_storeu_pd(lanes, energy);
+  m_SubBlockEnergy += (m_Weights[p_Channel] * lanes[0]) + (m_Weights[p_Channel + 1] * lanes[1]);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  double* stateL = m_State[p_Channel];
+  double* stateR = m_State[p_Channel + 1];
+  const float64x2_t sb0 = vdupq_n_f64(m_Shelf.b0), sb1 = vdupq_n_f64(m_Shelf.b1), sb2 = vdupq_n_f64(m_Shelf.b2);
+  const float64x2_t sa1 = vdupq_n_f64(m_Shelf.a1), sa2 = vdupq_n_f64(m_Shelf.a2);
+  const float64x2_t hb0 = vdupq_n_f64(m_HighPass.b0), hb1 = vdupq_n_f64(m_HighPass.b1);
+  const float64x2_t hb2 = vdupq_n_f64(m_HighPass.b2);
+  const float64x2_t ha1 = vdupq_n_f64(m_HighPass.a1), ha2 = vdupq_n_f64(m_HighPass.a2);
+  float64x2_t state[4];
+  for (int k = 0; k < 4; ++k)
+  {
+    const double lanes[2] = { stateL[k], stateR[k] };
+    state[k] = vld1q_f64(lanes);
+  }
+
+  float64x2_t s1 = state[0], s2 = state[1], h1 = state[2], h2 = state[3];
+  float64x2_t energy = vdupq_n_f64(0.0);
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    const double in[2] = { left[i], right[i] };
+    const float64x2_t x = vld1q_f64(in);
+    const float64x2_t y = vaddq_f64(vmulq_f64(sb0, x), s1);
+    s1 = vaddq_f64(vsubq_f64(vmulq_f64(sb1, x), vmulq_f64(sa1, y)), s2);
+    s2 = vsubq_f64(vmulq_f64(sb2, x), vmulq_f64(sa2, y));
+    const float64x2_t z = vaddq_f64(vmulq_f64(hb0, y), h1);
+    h1 = vaddq_f64(vsubq_f64(vmulq_f64(hb1, y), vmulq_f64(ha1, z)), h2);
+    h2 = vsubq_f64(vmulq_f64(hb2, y), vmulq_f64(ha2, z));
+    energy = vaddq_f64(energy, vmulq_f64(z, z));
+  }
+
+  state[0] = s1;
+  state[1] = s2;
+  state[2] = h1;
+  state[3] = h2;
+  double lanes[2];
+  for (int k = 0; k < 4; ++k)
+  {
+    vst1q_f64(lanes, state[k]);
+    stateL[k] = lanes[0];
+    stateR[k] = lanes[1];
+  }
+
+  vst1q_f64(lanes, energy);
+  m_SubBlockEnergy += (m_Weights[p_Channel] * lanes[0]) + (m_Weights[p_Channel + 1] * lanes[1]);
+#else
+  FilterChannel(p_Channel, left, p_Frames);
+  FilterChannel(p_Channel + 1, right, p_Frames);
+#endif
+
+  ProcessPeak(p_Channel, left, p_Frames);
+  ProcessPeak(p_Channel + 1, right, p_Frames);
+}
+
+void LoudnessMeter::ProcessChannel(int p_Channel, const float* p_Samples, int p_Frames)
+{
+  m_Channel.resize(p_Frames);
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    m_Channel[i] = p_Samples[(i * m_Channels) + p_Channel];
+  }
+
+  FilterChannel(p_Channel, m_Channel.data(), p_Frames);
+  ProcessPeak(p_Channel, m_Channel.data(), p_Frames);
+}
+
+void LoudnessMeter::FilterChannel(int p_Channel, const float* p_Samples, int p_Frames)
+{
+  // Both K-weighting stages in transposed direct form II
+  double* state = m_State[p_Channel];
+  const Biquad& s = m_Shelf;
+  const Biquad& h = m_HighPass;
+  double s1 = state[0], s2 = state[1], h1 = state[2], h2 = state[3];
+  double energy = 0.0;
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    const double x = p_Samples[i];
+    const double y = (s.b0 * x) + s1;
+    s1 = (s.b1 * x) - (s.a1 * y) + s2;
+    s2 = (s.b2 * x) - (s.a2 * y);
+    const double z = (h.b0 * y) + h1;
+    h1 = (h.b1 * y) - (h.a1 * z) + h2;
+    h2 = (h.b2 * y) - (h.a2 * z);
+    energy += z * z;
+  }
+
+  state[0] = s1;
+  state[1] = s2;
+  state[2] = h1;
+  state[3] = h2;
+  m_SubBlockEnergy += m_Weights[p_Channel] * energy;
+}
+
+void LoudnessMeter::ProcessPeak(int p_Channel, const float* p_Samples, int p_Frames)
+{
+  // Sample peak, and inter-sample peaks of the interpolated signal
+  float peak = m_Peak;
+  for (int i = 0; i < p_Frames; ++i)
+  {
+    peak = std::max(peak, std::fabs(p_Samples[i]));
+  }
+
+  if (m_Oversample > 1)
+  {
+    // History is stored twice in a row, so that the latest samples (newest
+    // first) are always a contiguous window for the interpolation filters
+    float* history = m_PeakHistory[p_Channel].data();
+    int pos = m_PeakPos[p_Channel];
+    for (int i = 0; i < p_Frames; ++i)
+    {
+      pos = (pos == 0) ? (kPeakTapsPerPhase - 1) : (pos - 1);
+      history[pos] = p_Samples[i];
+      history[pos + kPeakTapsPerPhase] = p_Samples[i];
+      for (int phase = 0; phase < m_Oversample; ++phase)
+      {
+        const float value = PeakDot(m_PeakTaps.data() + (phase * kPeakTapsPerPhase), history + pos);
+        peak = std::max(peak, std::fabs(value));
+      }
+    }
+
+    m_PeakPos[p_Channel] = pos;
+  }
+
+  m_Peak = peak;
+}
+
+void LoudnessMeter::EndSubBlock()
+{
+  // Each 400 ms block spans the four latest sub-blocks
+  m_SubBlocks[m_SubBlockCount % 4] = m_SubBlockEnergy;
+  ++m_SubBlockCount;
+  m_SubBlockEnergy = 0.0;
+  m_SubBlockPos = 0;
+
+  if (m_SubBlockCount >= 4)
+  {
+    const double sum = m_SubBlocks[0] + m_SubBlocks[1] + m_SubBlocks[2] + m_SubBlocks[3];
+    m_Blocks.push_back(sum / (4.0 * m_SubBlockFrames));
+  }
+}
+
+double LoudnessMeter::IntegratedLoudness() const
+{
+  double lufs = kAbsoluteGateLufs;
+  qint64 blocks = 0;
+  Gate(lufs, blocks);
+  return lufs;
+}
+
+float LoudnessMeter::TruePeak() const
+{
+  return m_Peak;
+}
+
+qint64 LoudnessMeter::GatedBlocks() const
+{
+  double lufs = kAbsoluteGateLufs;
+  qint64 blocks = 0;
+  Gate(lufs, blocks);
+  return blocks;
+}
+
+double LoudnessMeter::GainDb(double p_Lufs)
+{
+  return kReferenceLufs - p_Lufs;
+}
+
+void LoudnessMeter::Gate(double& p_Lufs, qint64& p_Blocks) const
+{
+  // Blocks above the absolute gate determine the relative gate, and blocks
+  // above both make up the integrated loudness
+  double sum = 0.0;
+  qint64 count = 0;
+  for (const double energy : m_Blocks)
+  {
+    if (BlockLoudness(energy) > kAbsoluteGateLufs)
+    {
+      sum += energy;
+      ++count;
+    }
+  }
+
+  p_Lufs = kAbsoluteGateLufs;
+  p_Blocks = 0;
+  if (count == 0) return;
+
+  const double relativeGate = BlockLoudness(sum / count) + kRelativeGateLu;
+  sum = 0.0;
+  count = 0;
+  for (const double energy : m_Blocks)
+  {
+    const double loudness = BlockLoudness(energy);
+    if ((loudness > kAbsoluteGateLufs) && (loudness > relativeGate))
+    {
+      sum += energy;
+      ++count;
+    }
+  }
+
+  if (count == 0) return;
+
+  p_Lufs = BlockLoudness(sum / count);
+  p_Blocks = count;
+}
+
+double LoudnessMeter::BlockLoudness(double p_Energy)
+{
+  return (p_Energy > 0.0) ? (-0.691 + (10.0 * log10(p_Energy))) : -HUGE_VAL;
+}
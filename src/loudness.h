@@ -0,0 +1,69 @@
+// loudness.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <vector>
+
+// Integrated loudness (ITU-R BS.1770 / EBU R128) and true peak of a stream
+// of interleaved float samples. Audio is K-weighted per channel (channel
+// pairs in the lanes of SSE2/NEON vectors where available), collected in
+// 400 ms blocks with 75% overlap and gated at the end.
+class LoudnessMeter
+{
+public:
+  static const int kMaxChannels = 8;
+
+  // ReplayGain 2.0 reference level
+  static constexpr double kReferenceLufs = -18.0;
+
+  void Reset(int p_SampleRate, int p_Channels);
+  void Process(const float* p_Samples, int p_Frames);
+  double IntegratedLoudness() const;
+  float TruePeak() const;
+  qint64 GatedBlocks() const;
+
+  static double GainDb(double p_Lufs);
+
+private:
+  struct Biquad
+  {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+  };
+
+  void ProcessPair(int p_Channel, const float* p_Samples, int p_Frames);
+  void ProcessChannel(int p_Channel, const float* p_Samples, int p_Frames);
+  void FilterChannel(int p_Channel, const float* p_Samples, int p_Frames);
+  void ProcessPeak(int p_Channel, const float* p_Samples, int p_Frames);
+  void EndSubBlock();
+  void Gate(double& p_Lufs, qint64& p_Blocks) const;
+  static double BlockLoudness(double p_Energy);
+
+private:
+  int m_SampleRate = 0;
+  int m_Channels = 0;
+  Biquad m_Shelf;
+  Biquad m_HighPass;
+  double m_State[kMaxChannels][4] = { { 0 } };
+  double m_Weights[kMaxChannels] = { 0 };
+  int m_Oversample = 1;
+  std::vector<float> m_PeakTaps;
+  std::vector<float> m_PeakHistory[kMaxChannels];
+  int m_PeakPos[kMaxChannels] = { 0 };
+  float m_Peak = 0.0f;
+
+  int m_SubBlockFrames = 0;
+  int m_SubBlockPos = 0;
+  double m_SubBlockEnergy = 0.0;
+  double m_SubBlocks[4] = { 0 };
+  int m_SubBlockCount = 0;
+  std::vector<double> m_Blocks;
+  std::vector<float> m_Channel;
+};
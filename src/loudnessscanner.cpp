@@ -0,0 +1,679 @@
+// loudnessscanner.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "loudnessscanner.h"
+
+#include <QAudioBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QUrl>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <fileref.h>
+#include <tag.h>
+#include <tpropertymap.h>
+
+#include "log.h"
+
+// File layout (native endian, cache is local only):
+//   header, records[] (later records replace earlier ones with same key)
+struct LoudnessCacheHeader
+{
+  quint32 magic;
+  quint16 version;
+  quint16 recordSize;
+};
+
+struct LoudnessCacheRecord
+{
+  char key[20];
+  float lufs;
+  float peak;
+  quint32 weight;
+  quint32 reserved;
+};
+
+static const quint32 kMagic = 0x444c504e; // "NPLD"
+static const quint16 kVersion = 2;
+
+// Loudness that ReplayGain 1.0 gains are relative to (89 dB SPL)
+static const double kReplayGain1Lufs = -14.0;
+
+// Upper bound on scanner threads, regardless of core count
+static const int kMaxThreads = 32;
+
+QByteArray LoudnessCache::Key(const QString& p_Track)
+{
+  // File metadata only, so that cached tracks need not be read at all
+  const QFileInfo fileInfo(p_Track);
+  if (!fileInfo.exists()) return QByteArray();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(p_Track.toUtf8() + ":" + QByteArray::number(fileInfo.size()) + ":" +
+               QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+  return hash.result();
+}
+
+bool LoudnessCache::Find(const QByteArray& p_Key, LoudnessInfo& p_Info)
+{
+  QMutexLocker locker(&m_Mutex);
+  Load();
+  auto it = m_Entries.constFind(p_Key);
+  if (it == m_Entries.constEnd()) return false;
+
+  p_Info = it.value();
+  return true;
+}
+
+void LoudnessCache::Add(const QByteArray& p_Key, const LoudnessInfo& p_Info)
+{
+  if (p_Key.size() != static_cast<int>(sizeof(LoudnessCacheRecord::key))) return;
+
+  QMutexLocker locker(&m_Mutex);
+  Load();
+  m_Entries.insert(p_Key, p_Info);
+  if (!m_File.isOpen()) return;
+
+  LoudnessCacheRecord record;
+  memcpy(record.key, p_Key.constData(), sizeof(record.key));
+  record.lufs = p_Info.trackLufs;
+  record.peak = p_Info.trackPeak;
+  record.weight = static_cast<quint32>(qMax(0ll, p_Info.weight));
+  record.reserved = 0;
+  m_File.write(reinterpret_cast<const char*>(&record), sizeof(record));
+  m_File.flush();
+}
+
+void LoudnessCache::Load()
+{
+  if (m_Loaded) return;
+
+  m_Loaded = true;
+  const QString path = Path();
+  if (path.isEmpty() || !QDir().mkpath(QFileInfo(path).path())) return;
+
+  m_File.setFileName(path);
+  bool valid = false;
+  if (m_File.open(QIODevice::ReadOnly))
+  {
+    const QByteArray data = m_File.readAll();
+    m_File.close();
+
+    const LoudnessCacheHeader* header = reinterpret_cast<const LoudnessCacheHeader*>(data.constData());
+    valid = (data.size() >= static_cast<int>(sizeof(LoudnessCacheHeader))) && (header->magic == kMagic) &&
+      (header->version == kVersion) && (header->recordSize == sizeof(LoudnessCacheRecord));
+    if (valid)
+    {
+      // A partly written last record is ignored
+      const int count = (data.size() - sizeof(LoudnessCacheHeader)) / sizeof(LoudnessCacheRecord);
+      const LoudnessCacheRecord* records =
+        reinterpret_cast<const LoudnessCacheRecord*>(data.constData() + sizeof(LoudnessCacheHeader));
+      for (int i = 0; i < count; ++i)
+      {
+        LoudnessInfo info;
+        info.trackLufs = records[i].lufs;
+        info.trackPeak = records[i].peak;
+        info.weight = records[i].weight;
+        info.valid = true;
+        m_Entries.insert(QByteArray(records[i].key, sizeof(records[i].key)), info);
+      }
+
+      Log::Debug("Loudness cache loaded, %d entries", m_Entries.size());
+    }
+  }
+
+  if (valid)
+  {
+    m_File.open(QIODevice::WriteOnly | QIODevice::Append);
+  }
+  else if (m_File.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    LoudnessCacheHeader header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.recordSize = sizeof(LoudnessCacheRecord);
+    m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+
+  if (!m_File.isOpen())
+  {
+    Log::Warning("Failed to open loudness cache %s", path.toStdString().c_str());
+  }
+}
+
+QString LoudnessCache::Path()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  return cacheDir.isEmpty() ? QString() : (cacheDir + "/loudness.dat");
+}
+
+LoudnessWorker::LoudnessWorker(LoudnessScanner& p_Scanner)
+  : m_Scanner(p_Scanner)
+{
+}
+
+void LoudnessWorker::ProcessNext()
+{
+  if (m_Busy) return;
+
+  // Decoder is created on first use so that it lives in the worker thread
+  if (m_Decoder == nullptr)
+  {
+    m_Decoder = new QAudioDecoder(this);
+    connect(m_Decoder, &QAudioDecoder::bufferReady, this, &LoudnessWorker::OnBufferReady);
+    connect(m_Decoder, &QAudioDecoder::finished, this, &LoudnessWorker::OnFinished);
+    connect(m_Decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+            this, &LoudnessWorker::OnError);
+  }
+
+  QString track;
+  int generation = 0;
+  while (m_Scanner.TakeNext(track, generation))
+  {
+    // Tracks measured before, or carrying ReplayGain tags, need no decoding
+    LoudnessInfo info;
+    const QByteArray key = LoudnessCache::Key(track);
+    if (!key.isEmpty() && m_Scanner.m_Cache.Find(key, info))
+    {
+      m_Scanner.AddResult(track, info, false /*p_Measured*/, generation);
+      continue;
+    }
+
+    if (ReadTags(track, info))
+    {
+      m_Scanner.m_Cache.Add(key, info);
+      m_Scanner.AddResult(track, info, false /*p_Measured*/, generation);
+      continue;
+    }
+
+    m_Busy = true;
+    m_Track = track;
+    m_Key = key;
+    m_Generation = generation;
+    m_MeterSampleRate = 0;
+    m_MeterChannels = 0;
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+    m_Decoder->setSource(QUrl::fromLocalFile(track));
+#else
+    m_Decoder->setSourceFilename(track);
+#endif
+    m_Decoder->start();
+    return;
+  }
+}
+
+void LoudnessWorker::OnBufferReady()
+{
+  while (m_Busy && m_Decoder->bufferAvailable())
+  {
+    const QAudioBuffer buffer = m_Decoder->read();
+    if (!buffer.isValid()) continue;
+
+    const QAudioFormat fmt = buffer.format();
+    const int channels = fmt.channelCount();
+    const int sampleRate = fmt.sampleRate();
+    const int frames = buffer.frameCount();
+    if ((channels <= 0) || (sampleRate <= 0) || (frames <= 0)) continue;
+
+    if ((sampleRate != m_MeterSampleRate) || (channels != m_MeterChannels))
+    {
+      m_Meter.Reset(sampleRate, channels);
+      m_MeterSampleRate = sampleRate;
+      m_MeterChannels = channels;
+    }
+
+    const int samples = frames * channels;
+    m_Samples.resize(samples);
+    float* out = m_Samples.data();
+    switch (fmt.sampleFormat())
+    {
+      case QAudioFormat::Float:
+        memcpy(out, buffer.constData<float>(), samples * sizeof(float));
+        break;
+
+      case QAudioFormat::Int16:
+      {
+        const qint16* in = buffer.constData<qint16>();
+        for (int i = 0; i < samples; ++i)
+        {
+          out[i] = in[i] / 32768.0f;
+        }
+        break;
+      }
+
+      case QAudioFormat::Int32:
+      {
+        const qint32* in = buffer.constData<qint32>();
+        for (int i = 0; i < samples; ++i)
+        {
+          out[i] = in[i] / 2147483648.0f;
+        }
+        break;
+      }
+
+      case QAudioFormat::UInt8:
+      {
+        const quint8* in = buffer.constData<quint8>();
+        for (int i = 0; i < samples; ++i)
+        {
+          out[i] = (in[i] - 128) / 128.0f;
+        }
+        break;
+      }
+
+      default:
+        continue;
+    }
+
+    m_Meter.Process(out, frames);
+  }
+}
+
+void LoudnessWorker::OnFinished()
+{
+  OnBufferReady();
+  FinishTrack(m_MeterSampleRate > 0);
+}
+
+void LoudnessWorker::OnError(QAudioDecoder::Error p_Error)
+{
+  Log::Warning("Loudness scan decoder error %d: %s (track=%s)", static_cast<int>(p_Error),
+               m_Decoder->errorString().toStdString().c_str(), m_Track.toStdString().c_str());
+  FinishTrack(false);
+}
+
+void LoudnessWorker::FinishTrack(bool p_Measured)
+{
+  if (!m_Busy) return;
+
+  m_Busy = false;
+  m_Decoder->stop();
+
+  LoudnessInfo info;
+  if (p_Measured)
+  {
+    info.trackLufs = static_cast<float>(m_Meter.IntegratedLoudness());
+    info.trackPeak = m_Meter.TruePeak();
+    info.weight = m_Meter.GatedBlocks();
+    info.valid = true;
+    m_Scanner.m_Cache.Add(m_Key, info);
+  }
+
+  m_Scanner.AddResult(m_Track, info, p_Measured, m_Generation);
+
+  // Continue once out of the decoder signal handler
+  QMetaObject::invokeMethod(this, &LoudnessWorker::ProcessNext, Qt::QueuedConnection);
+}
+
+bool LoudnessWorker::ReadTags(const QString& p_Track, LoudnessInfo& p_Info)
+{
+  TagLib::FileRef fileRef(p_Track.toStdString().c_str());
+  if (fileRef.isNull()) return false;
+
+  const TagLib::PropertyMap props = fileRef.file()->properties();
+  if (!props.contains("REPLAYGAIN_TRACK_GAIN")) return false;
+
+  // Values are formatted as "-6.52 dB" and "0.988553"
+  bool ok = false;
+  const QString gain = QString::fromStdString(props["REPLAYGAIN_TRACK_GAIN"].front().to8Bit(true));
+  const double gainDb = gain.trimmed().split(' ').first().toDouble(&ok);
+  if (!ok) return false;
+
+  double peak = 1.0;
+  if (props.contains("REPLAYGAIN_TRACK_PEAK"))
+  {
+    const QString peakStr = QString::fromStdString(props["REPLAYGAIN_TRACK_PEAK"].front().to8Bit(true));
+    peak = peakStr.trimmed().toDouble(&ok);
+    if (!ok)
+    {
+      peak = 1.0;
+    }
+  }
+
+  // Gain is relative to the reference loudness in the tags, if given in LUFS
+  // (ReplayGain 2.0), and otherwise taken as ReplayGain 1.0
+  double referenceLufs = kReplayGain1Lufs;
+  if (props.contains("REPLAYGAIN_REFERENCE_LOUDNESS"))
+  {
+    const QString reference =
+      QString::fromStdString(props["REPLAYGAIN_REFERENCE_LOUDNESS"].front().to8Bit(true)).trimmed();
+    const double value = reference.split(' ').first().toDouble(&ok);
+    if (ok && reference.endsWith("LUFS", Qt::CaseInsensitive))
+    {
+      referenceLufs = value;
+    }
+  }
+
+  p_Info.trackLufs = static_cast<float>(referenceLufs - gainDb);
+  p_Info.trackPeak = static_cast<float>(peak);
+  p_Info.valid = true;
+
+  // Track length in 100 ms steps approximates its gated block count
+  const TagLib::AudioProperties* audioProperties = fileRef.audioProperties();
+  p_Info.weight = (audioProperties != nullptr) ? (audioProperties->lengthInMilliseconds() / 100) : 0;
+  return true;
+}
+
+LoudnessScanner::LoudnessScanner(QObject* p_Parent /*= nullptr*/)
+  : QObject(p_Parent)
+{
+  // One track per event loop pass, to not hold up the thread for long
+  m_TagTimer.setSingleShot(true);
+  m_TagTimer.setInterval(0);
+  connect(&m_TagTimer, &QTimer::timeout, this, &LoudnessScanner::WriteNextTags);
+
+  const int threadCount = qBound(1, QThread::idealThreadCount(), kMaxThreads);
+  for (int i = 0; i < threadCount; ++i)
+  {
+    QThread* thread = new QThread(this);
+    LoudnessWorker* worker = new LoudnessWorker(*this);
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start(QThread::LowestPriority);
+    m_Threads.push_back(thread);
+    m_Workers.push_back(worker);
+  }
+}
+
+LoudnessScanner::~LoudnessScanner()
+{
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_Queue.clear();
+  }
+
+  for (QThread* thread : m_Threads)
+  {
+    thread->quit();
+  }
+
+  for (QThread* thread : m_Threads)
+  {
+    thread->wait();
+  }
+}
+
+void LoudnessScanner::Scan(const QVector<QString>& p_Tracks)
+{
+  QStringList updatedTracks;
+  QVector<QPair<QString, LoudnessInfo>> tagTracks;
+  {
+    QMutexLocker locker(&m_Mutex);
+    ++m_Generation;
+    m_Queue.clear();
+    m_Albums.clear();
+    QSet<QString> seenTracks;
+    for (const QString& track : p_Tracks)
+    {
+      if (seenTracks.contains(track)) continue;
+
+      seenTracks.insert(track);
+
+      // Albums span all playlist tracks in the directory, seeded with the
+      // tracks already known, and only the others are queued
+      Album& album = m_Albums[QFileInfo(track).path()];
+      album.tracks.push_back(track);
+      auto resultIt = m_Results.constFind(track);
+      if (resultIt != m_Results.constEnd())
+      {
+        AddToAlbum(album, resultIt.value());
+        continue;
+      }
+
+      ++album.remaining;
+      m_Queue.push_back(qMakePair(track, m_Generation));
+    }
+
+    // Albums with all tracks known are complete already, though their
+    // values may differ from an earlier scan with another set of tracks
+    for (auto it = m_Albums.begin(); it != m_Albums.end(); )
+    {
+      if (it.value().remaining > 0)
+      {
+        ++it;
+        continue;
+      }
+
+      FinishAlbum(it.value(), updatedTracks, tagTracks);
+      it = m_Albums.erase(it);
+    }
+
+    m_ScanCount = static_cast<int>(m_Queue.size());
+    m_MeasuredCount = 0;
+    m_ScanTimer.start();
+  }
+
+  for (const QString& track : updatedTracks)
+  {
+    emit LoudnessUpdated(track);
+  }
+
+  QueueTagWrites(tagTracks);
+  if (m_ScanCount == 0) return;
+
+  Log::Info("Loudness scan started, %d tracks on %d threads", m_ScanCount, static_cast<int>(m_Workers.size()));
+  for (LoudnessWorker* worker : m_Workers)
+  {
+    QMetaObject::invokeMethod(worker, &LoudnessWorker::ProcessNext, Qt::QueuedConnection);
+  }
+}
+
+void LoudnessScanner::Prioritize(const QString& p_Track)
+{
+  QMutexLocker locker(&m_Mutex);
+  auto it = std::find_if(m_Queue.begin(), m_Queue.end(),
+                         [&](const QPair<QString, int>& p_Item) { return p_Item.first == p_Track; });
+  if (it == m_Queue.end()) return;
+
+  const QPair<QString, int> item = *it;
+  m_Queue.erase(it);
+  m_Queue.push_front(item);
+}
+
+void LoudnessScanner::SetBusyTracks(const QStringList& p_Tracks)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_BusyTracks = QSet<QString>(p_Tracks.begin(), p_Tracks.end());
+}
+
+void LoudnessScanner::SetWriteTags(bool p_WriteTags)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_WriteTags = p_WriteTags;
+}
+
+bool LoudnessScanner::Find(const QString& p_Track, LoudnessInfo& p_Info) const
+{
+  QMutexLocker locker(&m_Mutex);
+  auto it = m_Results.constFind(p_Track);
+  if (it == m_Results.constEnd()) return false;
+
+  p_Info = it.value();
+  return p_Info.valid;
+}
+
+bool LoudnessScanner::TakeNext(QString& p_Track, int& p_Generation)
+{
+  QMutexLocker locker(&m_Mutex);
+  if (m_Queue.empty()) return false;
+
+  p_Track = m_Queue.front().first;
+  p_Generation = m_Queue.front().second;
+  m_Queue.pop_front();
+  return true;
+}
+
+void LoudnessScanner::AddResult(const QString& p_Track, const LoudnessInfo& p_Info, bool p_Measured,
+                                int p_Generation)
+{
+  QVector<QPair<QString, LoudnessInfo>> tagTracks;
+  QStringList albumTracks;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_Results.insert(p_Track, p_Info);
+
+    // Tracks finishing from an earlier scan are queued again by the current
+    // one if in its playlist, and counted towards their album only then
+    if (p_Generation == m_Generation)
+    {
+      if (p_Measured)
+      {
+        ++m_MeasuredCount;
+      }
+
+      auto albumIt = m_Albums.find(QFileInfo(p_Track).path());
+      if (albumIt != m_Albums.end())
+      {
+        Album& album = albumIt.value();
+        AddToAlbum(album, p_Info);
+        if (--album.remaining == 0)
+        {
+          FinishAlbum(album, albumTracks, tagTracks);
+          m_Albums.erase(albumIt);
+        }
+      }
+
+      if (m_Albums.isEmpty() && m_ScanTimer.isValid())
+      {
+        Log::Info("Loudness scan finished, %d tracks (%d measured) in %lld ms", m_ScanCount, m_MeasuredCount,
+                  m_ScanTimer.elapsed());
+        m_ScanTimer.invalidate();
+      }
+    }
+  }
+
+  emit LoudnessUpdated(p_Track);
+  for (const QString& track : albumTracks)
+  {
+    if (track != p_Track)
+    {
+      emit LoudnessUpdated(track);
+    }
+  }
+
+  QueueTagWrites(tagTracks);
+}
+
+void LoudnessScanner::AddToAlbum(Album& p_Album, const LoudnessInfo& p_Info)
+{
+  // Album loudness is the mean block energy over all its tracks
+  if (!p_Info.valid || (p_Info.weight <= 0)) return;
+
+  p_Album.energy += p_Info.weight * pow(10.0, p_Info.trackLufs / 10.0);
+  p_Album.weight += p_Info.weight;
+  p_Album.peak = qMax(p_Album.peak, p_Info.trackPeak);
+}
+
+void LoudnessScanner::FinishAlbum(const Album& p_Album, QStringList& p_Updated,
+                                  QVector<QPair<QString, LoudnessInfo>>& p_TagTracks)
+{
+  if (p_Album.weight == 0) return;
+
+  const float albumLufs = static_cast<float>(10.0 * log10(p_Album.energy / p_Album.weight));
+  for (const QString& track : p_Album.tracks)
+  {
+    auto resultIt = m_Results.find(track);
+    if ((resultIt == m_Results.end()) || !resultIt.value().valid) continue;
+
+    // Tracks already holding these album values need no update
+    LoudnessInfo& info = resultIt.value();
+    if (info.albumValid && (info.albumLufs == albumLufs) && (info.albumPeak == p_Album.peak)) continue;
+
+    info.albumLufs = albumLufs;
+    info.albumPeak = p_Album.peak;
+    info.albumValid = true;
+    p_Updated.push_back(track);
+    if (m_WriteTags)
+    {
+      p_TagTracks.push_back(qMakePair(track, info));
+    }
+  }
+}
+
+void LoudnessScanner::QueueTagWrites(const QVector<QPair<QString, LoudnessInfo>>& p_TagTracks)
+{
+  if (p_TagTracks.isEmpty()) return;
+
+  // Handed over to the scanner thread, so that tags are never written while
+  // read elsewhere, nor by more than one thread
+  QMetaObject::invokeMethod(this, [this, p_TagTracks]()
+  {
+    m_TagWrites.insert(m_TagWrites.end(), p_TagTracks.begin(), p_TagTracks.end());
+    if (!m_TagTimer.isActive())
+    {
+      m_TagTimer.start();
+    }
+  }, Qt::QueuedConnection);
+}
+
+void LoudnessScanner::WriteNextTags()
+{
+  if (m_TagWrites.empty()) return;
+
+  const QPair<QString, LoudnessInfo> tagTrack = m_TagWrites.front();
+  m_TagWrites.pop_front();
+  bool busy = false;
+  {
+    QMutexLocker locker(&m_Mutex);
+    busy = m_BusyTracks.contains(tagTrack.first);
+  }
+
+  // Tracks open for playback are left alone
+  if (!busy)
+  {
+    WriteTags(tagTrack.first, tagTrack.second);
+  }
+
+  if (!m_TagWrites.empty())
+  {
+    m_TagTimer.start();
+  }
+}
+
+void LoudnessScanner::WriteTags(const QString& p_Track, const LoudnessInfo& p_Info)
+{
+  TagLib::FileRef fileRef(p_Track.toStdString().c_str());
+  if (fileRef.isNull()) return;
+
+  const QString trackGain = QString::asprintf("%.2f dB", LoudnessMeter::GainDb(p_Info.trackLufs));
+  const QString trackPeak = QString::asprintf("%.6f", p_Info.trackPeak);
+  const QString albumGain = QString::asprintf("%.2f dB", LoudnessMeter::GainDb(p_Info.albumLufs));
+  const QString albumPeak = QString::asprintf("%.6f", p_Info.albumPeak);
+
+  TagLib::PropertyMap props = fileRef.file()->properties();
+  bool changed = false;
+  auto setProperty = [&](const char* p_Name, const QString& p_Value)
+  {
+    const TagLib::String value(p_Value.toStdString(), TagLib::String::UTF8);
+    if (!props.contains(p_Name) || (props[p_Name] != TagLib::StringList(value)))
+    {
+      props.replace(p_Name, TagLib::StringList(value));
+      changed = true;
+    }
+  };
+
+  setProperty("REPLAYGAIN_TRACK_GAIN", trackGain);
+  setProperty("REPLAYGAIN_TRACK_PEAK", trackPeak);
+  setProperty("REPLAYGAIN_ALBUM_GAIN", albumGain);
+  setProperty("REPLAYGAIN_ALBUM_PEAK", albumPeak);
+  setProperty("REPLAYGAIN_REFERENCE_LOUDNESS", QString::asprintf("%.2f LUFS", LoudnessMeter::kReferenceLufs));
+  if (!changed) return;
+
+  fileRef.file()->setProperties(props);
+  if (!fileRef.save())
+  {
+    Log::Warning("Failed to write loudness tags track=%s", p_Track.toStdString().c_str());
+  }
+}
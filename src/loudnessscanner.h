@@ -0,0 +1,159 @@
+// loudnessscanner.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QAudioDecoder>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include <deque>
+#include <vector>
+
+#include "loudness.h"
+
+struct LoudnessInfo
+{
+  float trackLufs = 0.0f;
+  float trackPeak = 0.0f;
+  float albumLufs = 0.0f;
+  float albumPeak = 0.0f;
+  qint64 weight = 0; // gated blocks, weighting the track within its album
+  bool valid = false;
+  bool albumValid = false;
+};
+
+// Persistent per-track loudness, as fixed-size records appended to a single
+// file and keyed by track path, size and modification time. Loaded on first
+// use, and safe to use from multiple threads.
+class LoudnessCache
+{
+public:
+  static QByteArray Key(const QString& p_Track);
+  bool Find(const QByteArray& p_Key, LoudnessInfo& p_Info);
+  void Add(const QByteArray& p_Key, const LoudnessInfo& p_Info);
+
+private:
+  void Load();
+  static QString Path();
+
+private:
+  QMutex m_Mutex;
+  bool m_Loaded = false;
+  QHash<QByteArray, LoudnessInfo> m_Entries;
+  QFile m_File;
+};
+
+class LoudnessScanner;
+
+// Measures one track at a time on a dedicated thread, taking tracks from the
+// scanner queue until it is empty.
+class LoudnessWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  LoudnessWorker(LoudnessScanner& p_Scanner);
+
+public slots:
+  void ProcessNext();
+
+private slots:
+  void OnBufferReady();
+  void OnFinished();
+  void OnError(QAudioDecoder::Error p_Error);
+
+private:
+  void FinishTrack(bool p_Measured);
+  static bool ReadTags(const QString& p_Track, LoudnessInfo& p_Info);
+
+private:
+  LoudnessScanner& m_Scanner;
+  QAudioDecoder* m_Decoder = nullptr;
+  QString m_Track;
+  QByteArray m_Key;
+  int m_Generation = 0;
+  LoudnessMeter m_Meter;
+  int m_MeterSampleRate = 0;
+  int m_MeterChannels = 0;
+  std::vector<float> m_Samples;
+  bool m_Busy = false;
+};
+
+// Background ReplayGain 2.0 scanner. Tracks are measured in parallel on a
+// pool of low priority worker threads, and playlist tracks in the same
+// directory are combined into album values once all of them are measured.
+// Each scan has a generation, so that results still in progress from an
+// earlier scan do not count towards the albums of a later one. Tags are
+// written only from the thread owning the scanner, which also reads tags for
+// display.
+class LoudnessScanner : public QObject
+{
+  Q_OBJECT
+
+public:
+  LoudnessScanner(QObject* p_Parent = nullptr);
+  ~LoudnessScanner();
+
+  void Scan(const QVector<QString>& p_Tracks);
+  void Prioritize(const QString& p_Track);
+  void SetBusyTracks(const QStringList& p_Tracks);
+  void SetWriteTags(bool p_WriteTags);
+  bool Find(const QString& p_Track, LoudnessInfo& p_Info) const;
+
+signals:
+  void LoudnessUpdated(const QString& p_Track);
+
+private slots:
+  void WriteNextTags();
+
+private:
+  friend class LoudnessWorker;
+
+  struct Album
+  {
+    QStringList tracks;
+    int remaining = 0;
+    double energy = 0.0;
+    qint64 weight = 0;
+    float peak = 0.0f;
+  };
+
+  bool TakeNext(QString& p_Track, int& p_Generation);
+  void AddResult(const QString& p_Track, const LoudnessInfo& p_Info, bool p_Measured, int p_Generation);
+  static void AddToAlbum(Album& p_Album, const LoudnessInfo& p_Info);
+  void FinishAlbum(const Album& p_Album, QStringList& p_Updated, QVector<QPair<QString, LoudnessInfo>>& p_TagTracks);
+  void QueueTagWrites(const QVector<QPair<QString, LoudnessInfo>>& p_TagTracks);
+  void WriteTags(const QString& p_Track, const LoudnessInfo& p_Info);
+
+private:
+  std::vector<QThread*> m_Threads;
+  std::vector<LoudnessWorker*> m_Workers;
+  LoudnessCache m_Cache;
+  mutable QMutex m_Mutex;
+  std::deque<QPair<QString, int>> m_Queue; // track and scan generation
+  int m_Generation = 0;
+  QHash<QString, LoudnessInfo> m_Results;
+  QHash<QString, Album> m_Albums;
+  QSet<QString> m_BusyTracks;
+  bool m_WriteTags = false;
+  std::deque<QPair<QString, LoudnessInfo>> m_TagWrites;
+  QTimer m_TagTimer;
+  QElapsedTimer m_ScanTimer;
+  int m_ScanCount = 0;
+  int m_MeasuredCount = 0;
+};
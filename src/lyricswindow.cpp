@@ -38,6 +38,8 @@ static const int s_Margin = 20;
 static const float s_ScrollSpeed = 0.15f;
 static const float s_ScrollThreshold = 0.5f;
 static const int s_ScrollIntervalMs = 16;
+static const int s_PositionIntervalMs = 33;
+static const qint64 s_UnsyncedStepMs = 250;
 static const int s_BaseFontSize = 14;
 static const int s_BaseBoldFontSize = 16;
 static const int s_LinePadding = 6;
@@ -98,6 +100,21 @@ LyricsWindow::LyricsWindow(QWidget* p_Parent)
     }
     update();
   });
+
+  // Sample playback clock at own frame rate while visible
+  m_PositionTimer.setInterval(s_PositionIntervalMs);
+  connect(&m_PositionTimer, &QTimer::timeout, this, [this]()
+  {
+    if (m_PlaybackClock != nullptr)
+    {
+      UpdatePosition(m_PlaybackClock->AudiblePosition());
+    }
+  });
+}
+
+void LyricsWindow::SetPlaybackClock(const PlaybackClock* p_PlaybackClock)
+{
+  m_PlaybackClock = p_PlaybackClock;
 }
 
 void LyricsWindow::SetLyrics(const LyricsData& p_Lyrics)
@@ -105,7 +122,7 @@ void LyricsWindow::SetLyrics(const LyricsData& p_Lyrics)
   m_Lyrics = p_Lyrics;
   m_HasLyrics = !p_Lyrics.lines.isEmpty();
   m_CurrentLine = -1;
-  m_UnsyncedRatchetPosMs = -1;
+  m_UnsyncedPosMs = -1;
   m_UsesSyntheticTimestamps = false;
   m_ScrollTarget = 0.0f;
   m_ScrollCurrent = 0.0f;
@@ -126,7 +143,7 @@ void LyricsWindow::SetLyrics(const LyricsData& p_Lyrics)
   {
     // Duration still unknown — fall back to position-based plain scroll,
     // pinned to first-line-center so the opening view matches synced layout.
-    m_UnsyncedRatchetPosMs = 0;
+    m_UnsyncedPosMs = 0;
     m_ScrollTarget = ComputeUnsyncedScrollTarget();
     m_ScrollCurrent = m_ScrollTarget;
   }
@@ -139,7 +156,7 @@ void LyricsWindow::ClearLyrics()
   m_Lyrics = LyricsData();
   m_HasLyrics = false;
   m_CurrentLine = -1;
-  m_UnsyncedRatchetPosMs = -1;
+  m_UnsyncedPosMs = -1;
   m_UsesSyntheticTimestamps = false;
   m_ScrollTarget = 0.0f;
   m_ScrollCurrent = 0.0f;
@@ -156,7 +173,7 @@ void LyricsWindow::LyricsLoading()
   m_Lyrics = LyricsData();
   m_HasLyrics = false;
   m_CurrentLine = -1;
-  m_UnsyncedRatchetPosMs = -1;
+  m_UnsyncedPosMs = -1;
   m_UsesSyntheticTimestamps = false;
   m_ScrollTarget = 0.0f;
   m_ScrollCurrent = 0.0f;
@@ -164,7 +181,7 @@ void LyricsWindow::LyricsLoading()
   update();
 }
 
-void LyricsWindow::PositionChanged(qint64 p_PositionMs)
+void LyricsWindow::UpdatePosition(qint64 p_PositionMs)
 {
   m_PositionMs = p_PositionMs;
 
@@ -184,14 +201,11 @@ void LyricsWindow::PositionChanged(qint64 p_PositionMs)
   }
   else
   {
-    // Ratchet position forward: ignore small backwards steps from Qt's
-    // position polling jitter, but accept larger drops as real user seeks.
-    static const qint64 seekBackThresholdMs = 2000;
-    if (m_UnsyncedRatchetPosMs < 0
-        || p_PositionMs >= m_UnsyncedRatchetPosMs
-        || p_PositionMs < m_UnsyncedRatchetPosMs - seekBackThresholdMs)
+    // Clock is smooth, so only recompute scroll target (which measures all
+    // lines) when position moved noticeably, or on seeks.
+    if ((m_UnsyncedPosMs < 0) || (qAbs(p_PositionMs - m_UnsyncedPosMs) >= s_UnsyncedStepMs))
     {
-      m_UnsyncedRatchetPosMs = p_PositionMs;
+      m_UnsyncedPosMs = p_PositionMs;
       m_ScrollTarget = ComputeUnsyncedScrollTarget();
       if (!m_ScrollTimer.isActive())
         m_ScrollTimer.start(s_ScrollIntervalMs);
@@ -239,8 +253,8 @@ float LyricsWindow::ComputeUnsyncedScrollTarget() const
   float lastCenter = totalContentHeight - lastHeight / 2.0f;
 
   float fraction = 0.0f;
-  if (m_DurationMs > 0 && m_UnsyncedRatchetPosMs >= 0)
-    fraction = qBound(0.0f, static_cast<float>(m_UnsyncedRatchetPosMs) / m_DurationMs, 1.0f);
+  if (m_DurationMs > 0 && m_UnsyncedPosMs >= 0)
+    fraction = qBound(0.0f, static_cast<float>(m_UnsyncedPosMs) / m_DurationMs, 1.0f);
 
   return firstCenter + fraction * (lastCenter - firstCenter);
 }
@@ -497,6 +511,7 @@ void LyricsWindow::closeEvent(QCloseEvent* p_Event)
 void LyricsWindow::showEvent(QShowEvent* p_Event)
 {
   QWidget::showEvent(p_Event);
+  m_PositionTimer.start();
 #ifdef __APPLE__
   ShowDockIcon();
 #endif
@@ -505,6 +520,7 @@ void LyricsWindow::showEvent(QShowEvent* p_Event)
 void LyricsWindow::hideEvent(QHideEvent* p_Event)
 {
   QWidget::hideEvent(p_Event);
+  m_PositionTimer.stop();
 #ifdef __APPLE__
   HideDockIcon();
 #endif
@@ -12,6 +12,7 @@
 #include <QWidget>
 
 #include "lyricsprovider.h"
+#include "playbackclock.h"
 
 class LyricsWindow : public QWidget
 {
@@ -24,12 +25,12 @@ public:
   void SetFontScale(float p_Scale);
   void GetFontScale(float& p_Scale);
   float GetDefaultFontScale() const;
+  void SetPlaybackClock(const PlaybackClock* p_PlaybackClock);
 
 public slots:
   void SetLyrics(const LyricsData& p_Lyrics);
   void ClearLyrics();
   void LyricsLoading();
-  void PositionChanged(qint64 p_PositionMs);
   void DurationChanged(qint64 p_DurationMs);
   void ToggleLyrics();
   void ToggleFullScreen();
@@ -50,6 +51,7 @@ protected:
   void resizeEvent(QResizeEvent* p_Event) override;
 
 private:
+  void UpdatePosition(qint64 p_PositionMs);
   int FindCurrentLine(qint64 p_PositionMs) const;
   float ComputeScrollTarget() const;
   float ComputeUnsyncedScrollTarget() const;
@@ -61,11 +63,13 @@ private:
   int m_CurrentLine = -1;
   qint64 m_DurationMs = 0;
   qint64 m_PositionMs = 0;
-  qint64 m_UnsyncedRatchetPosMs = -1;
+  qint64 m_UnsyncedPosMs = -1;
   bool m_UsesSyntheticTimestamps = false;
   float m_ScrollTarget = 0.0f;
   float m_ScrollCurrent = 0.0f;
   float m_FontScale = 1.5f;
   float m_FontScaleDefault = 1.5f;
   QTimer m_ScrollTimer;
+  QTimer m_PositionTimer;
+  const PlaybackClock* m_PlaybackClock = nullptr;
 };
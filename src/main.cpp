@@ -37,6 +37,7 @@
 #endif
 #endif
 #include "log.h"
+#include "playbackstats.h"
 #include "uikeyhandler.h"
 #include "uiview.h"
 #include "version.h"
@@ -81,6 +82,7 @@ int main(int argc, char *argv[])
   QStringList arguments = QCoreApplication::arguments();
   arguments.removeAt(0);
   bool setup = false;
+  bool stats = false;
   if (arguments.size() == 0)
   {
     ShowHelp();
@@ -100,10 +102,21 @@ int main(int argc, char *argv[])
   {
     setup = true;
   }
+  else if ((arguments.size() > 0) && (arguments.at(0) == "--stats"))
+  {
+    arguments.removeAt(0);
+    stats = true;
+    if (arguments.size() == 0)
+    {
+      ShowHelp();
+      return 1;
+    }
+  }
 
   // Init environment
   InitStdErrRedirect("/dev/null");
   srand(time(0));
+  PlaybackStats::SetLogEnabled(stats);
 
   // Init settings
   QCoreApplication::setApplicationName("namp");
@@ -181,23 +194,32 @@ int main(int argc, char *argv[])
   QObject::connect(&uiKeyhandler, SIGNAL(Stop()), &audioPlayer, SLOT(Stop()));
   QObject::connect(&uiKeyhandler, SIGNAL(Next()), &audioPlayer, SLOT(Next()));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleShuffle()), &audioPlayer, SLOT(ToggleShuffle()));
+  QObject::connect(&uiKeyhandler, SIGNAL(CycleEqualizer()), &audioPlayer, SLOT(CycleEqualizer()));
+  QObject::connect(&uiKeyhandler, SIGNAL(ToggleEqualizerFolder()), &audioPlayer, SLOT(ToggleEqualizerFolder()));
   QObject::connect(&uiKeyhandler, SIGNAL(VolumeUp()), &audioPlayer, SLOT(VolumeUp()));
   QObject::connect(&uiKeyhandler, SIGNAL(VolumeDown()), &audioPlayer, SLOT(VolumeDown()));
   QObject::connect(&uiKeyhandler, SIGNAL(SkipBackward()), &audioPlayer, SLOT(SkipBackward()));
   QObject::connect(&uiKeyhandler, SIGNAL(SkipForward()), &audioPlayer, SLOT(SkipForward()));
+  QObject::connect(&uiKeyhandler, SIGNAL(SpeedDown()), &audioPlayer, SLOT(SpeedDown()));
+  QObject::connect(&uiKeyhandler, SIGNAL(SpeedUp()), &audioPlayer, SLOT(SpeedUp()));
   QObject::connect(&uiKeyhandler, SIGNAL(SetVolume(int)), &audioPlayer, SLOT(SetVolume(int)));
   QObject::connect(&uiKeyhandler, SIGNAL(SetPosition(int)), &audioPlayer, SLOT(SetPosition(int)));
   QObject::connect(&uiKeyhandler, SIGNAL(ExternalEdit()), &uiView, SLOT(ExternalEdit()));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleAnalyzer()), &uiView, SLOT(ToggleAnalyzer()));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleFolders()), &uiView, SLOT(ToggleFolders()));
+  QObject::connect(&uiKeyhandler, SIGNAL(ToggleStats()), &uiView, SLOT(ToggleStats()));
   QObject::connect(&uiKeyhandler, SIGNAL(Enqueue()), &uiView, SLOT(Enqueue()));
   QObject::connect(&uiKeyhandler, SIGNAL(Unenqueue()), &uiView, SLOT(Unenqueue()));
+  QObject::connect(&uiKeyhandler, SIGNAL(EnqueueFolder()), &uiView, SLOT(EnqueueFolder()));
   QObject::connect(&uiView, SIGNAL(ExternalEdit(int)), &audioPlayer, SLOT(ExternalEdit(int)));
   QObject::connect(&uiView, SIGNAL(SetCurrentIndex(int)), &audioPlayer, SLOT(SetCurrentIndex(int)));
   QObject::connect(&uiView, SIGNAL(Play()), &audioPlayer, SLOT(Play()));
   QObject::connect(&uiView, SIGNAL(AnalyzerEnabled(bool)), &audioPlayer, SLOT(SetAnalyzerEnabled(bool)));
+  QObject::connect(&uiView, SIGNAL(SpectrumBandCountChanged(int)), &audioPlayer, SLOT(SetAnalyzerBandCount(int)));
   QObject::connect(&uiView, SIGNAL(EnqueueTrack(int)), &audioPlayer, SLOT(EnqueueTrack(int)));
   QObject::connect(&uiView, SIGNAL(UnenqueueTrack(int)), &audioPlayer, SLOT(UnenqueueTrack(int)));
+  QObject::connect(&uiView, SIGNAL(EnqueueTracks(const QVector<int>&)), &audioPlayer, SLOT(EnqueueTracks(const QVector<int>&)));
+  QObject::connect(&uiView, SIGNAL(TrackPlayed(int)), &audioPlayer, SLOT(TrackPlayed(int)));
 
   // Signals to ui view
   QObject::connect(&audioPlayer, SIGNAL(PlaylistUpdated(const QVector<QString>&)), &uiView, SLOT(PlaylistUpdated(const QVector<QString>&)));
@@ -206,14 +228,14 @@ int main(int argc, char *argv[])
   QObject::connect(&audioPlayer, SIGNAL(CurrentIndexChanged(int)), &uiView, SLOT(CurrentIndexChanged(int)));
   QObject::connect(&audioPlayer, SIGNAL(VolumeChanged(int)), &uiView, SLOT(VolumeChanged(int)));
   QObject::connect(&audioPlayer, SIGNAL(PlaybackModeUpdated(bool)), &uiView, SLOT(PlaybackModeUpdated(bool)));
+  QObject::connect(&audioPlayer, SIGNAL(EqualizerUpdated(const QString&)), &uiView, SLOT(EqualizerUpdated(const QString&)));
+  QObject::connect(&audioPlayer, SIGNAL(SpeedUpdated(float)), &uiView, SLOT(SpeedUpdated(float)));
   QObject::connect(&audioPlayer, SIGNAL(RefreshTrackData(int)), &uiView, SLOT(RefreshTrackData(int)));
   QObject::connect(&audioPlayer, SIGNAL(SpectrumChanged(const QVector<float>&)), &uiView, SLOT(SpectrumChanged(const QVector<float>&)));
-  QObject::connect(&audioPlayer, SIGNAL(QueueUpdated(const QVector<int>&)), &uiView, SLOT(QueueUpdated(const QVector<int>&)));
+  QObject::connect(&audioPlayer, SIGNAL(QueueUpdated(const PlayQueue*)), &uiView, SLOT(QueueUpdated(const PlayQueue*)),
+                   Qt::DirectConnection);
   QObject::connect(&uiKeyhandler, SIGNAL(Search()), &uiView, SLOT(Search()));
-  QObject::connect(&uiKeyhandler, SIGNAL(SelectPrevious()), &uiView, SLOT(SelectPrevious()));
-  QObject::connect(&uiKeyhandler, SIGNAL(SelectNext()), &uiView, SLOT(SelectNext()));
-  QObject::connect(&uiKeyhandler, SIGNAL(PagePrevious()), &uiView, SLOT(PagePrevious()));
-  QObject::connect(&uiKeyhandler, SIGNAL(PageNext()), &uiView, SLOT(PageNext()));
+  QObject::connect(&uiKeyhandler, SIGNAL(MoveSelection(int, int)), &uiView, SLOT(MoveSelection(int, int)));
   QObject::connect(&uiKeyhandler, SIGNAL(Home()), &uiView, SLOT(Home()));
   QObject::connect(&uiKeyhandler, SIGNAL(End()), &uiView, SLOT(End()));
   QObject::connect(&uiKeyhandler, SIGNAL(PlaySelected()), &uiView, SLOT(PlaySelected()));
@@ -231,7 +253,7 @@ int main(int argc, char *argv[])
   // Init CDG window
   CdgWindow cdgWindow;
   QObject::connect(&audioPlayer, SIGNAL(TrackChanged(const QString&)), &cdgWindow, SLOT(TrackChanged(const QString&)));
-  QObject::connect(&audioPlayer, SIGNAL(PositionChanged(qint64)), &cdgWindow, SLOT(PositionChanged(qint64)));
+  cdgWindow.SetPlaybackClock(audioPlayer.GetPlaybackClock());
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleCdg()), &cdgWindow, SLOT(ToggleCdg()));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleFullScreen()), &cdgWindow, SLOT(ToggleFullScreen()));
   QObject::connect(&cdgWindow, SIGNAL(KeyReceived()), &uiKeyhandler, SLOT(ProcessKeyEvent()));
@@ -247,7 +269,7 @@ int main(int argc, char *argv[])
   QObject::connect(&lyricsWindow, SIGNAL(EnabledChanged(bool)), &lyricsProvider, SLOT(SetEnabled(bool)));
   QObject::connect(&lyricsWindow, SIGNAL(EnabledChanged(bool)), &uiView, SLOT(LyricsUpdated(bool)));
   uiView.SetLyricsAvailable(true);
-  QObject::connect(&audioPlayer, SIGNAL(PositionChanged(qint64)), &lyricsWindow, SLOT(PositionChanged(qint64)));
+  lyricsWindow.SetPlaybackClock(audioPlayer.GetPlaybackClock());
   QObject::connect(&audioPlayer, SIGNAL(DurationChanged(qint64)), &lyricsWindow, SLOT(DurationChanged(qint64)));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleLyrics()), &lyricsWindow, SLOT(ToggleLyrics()));
   QObject::connect(&uiKeyhandler, SIGNAL(ToggleFullScreen()), &lyricsWindow, SLOT(ToggleFullScreen()));
@@ -260,8 +282,33 @@ int main(int argc, char *argv[])
   // Apply settings
   bool shuffle = settings.value("player/shuffle", false).toBool();
   emit audioPlayer.SetPlaybackMode(shuffle);
+  QString shuffleSpread = settings.value("player/shufflespread", "off").toString();
+  audioPlayer.SetShuffleSpread(shuffleSpread);
+  bool smartShuffle = settings.value("player/smartshuffle", false).toBool();
+  audioPlayer.SetSmartShuffle(smartShuffle);
+  QStringList shuffleOrder = settings.value("player/shuffleorder").toStringList();
+  int shuffleCursor = settings.value("player/shufflecursor", -1).toInt();
+  audioPlayer.SetShuffleState(shuffleOrder, shuffleCursor);
+  QString engine = settings.value("player/engine", "qt").toString();
+  audioPlayer.SetEngine(engine);
   int volume = settings.value("player/volume", 100).toInt();
   emit audioPlayer.SetVolume(volume);
+  int crossfade = settings.value("player/crossfade", 0).toInt();
+  audioPlayer.SetCrossfade(crossfade);
+  bool replayGainTags = settings.value("player/replaygaintags", false).toBool();
+  audioPlayer.SetReplayGainTags(replayGainTags);
+  QString replayGain = settings.value("player/replaygain", "off").toString();
+  audioPlayer.SetReplayGain(replayGain);
+  int prefetch = settings.value("player/prefetchmb", 8).toInt();
+  audioPlayer.SetPrefetch(prefetch);
+  QString equalizerCustom = settings.value("player/equalizercustom", "").toString();
+  audioPlayer.SetEqualizerCustom(equalizerCustom);
+  QVariantMap equalizerFolders = settings.value("player/equalizerfolders").toMap();
+  audioPlayer.SetEqualizerFolders(equalizerFolders);
+  QString equalizer = settings.value("player/equalizer", "flat").toString();
+  audioPlayer.SetEqualizerPreset(equalizer);
+  float speed = settings.value("player/speed", 1.0f).toFloat();
+  audioPlayer.SetSpeed(speed);
   QString currentTrack = settings.value("player/track", "").toString();
   bool scrollTitle = settings.value("ui/scrolltitle", false).toBool();
   uiView.SetScrollTitle(scrollTitle);
@@ -269,6 +316,8 @@ int main(int argc, char *argv[])
   uiView.SetViewPosition(viewPosition);
   bool viewAnalyzer = settings.value("ui/viewanalyzer", false).toBool();
   uiView.SetViewAnalyzer(viewAnalyzer);
+  int analyzerFps = settings.value("ui/analyzerfps", 30).toInt();
+  audioPlayer.SetAnalyzerFrameRate(analyzerFps);
   bool viewFolders = settings.value("ui/viewfolders", false).toBool();
   uiView.SetViewFolders(viewFolders);
 #ifdef HAS_GUI
@@ -315,12 +364,41 @@ int main(int argc, char *argv[])
   // Stop audio backend cleanly before settings save / teardown
   audioPlayer.Shutdown();
   QCoreApplication::processEvents();
+  if (stats)
+  {
+    PlaybackStats::Dump();
+  }
 
   // Save settings
   audioPlayer.GetPlaybackMode(shuffle);
   settings.setValue("player/shuffle", shuffle);
+  audioPlayer.GetShuffleSpread(shuffleSpread);
+  settings.setValue("player/shufflespread", shuffleSpread);
+  audioPlayer.GetSmartShuffle(smartShuffle);
+  settings.setValue("player/smartshuffle", smartShuffle);
+  audioPlayer.GetShuffleState(shuffleOrder, shuffleCursor);
+  settings.setValue("player/shuffleorder", shuffleOrder);
+  settings.setValue("player/shufflecursor", shuffleCursor);
+  audioPlayer.GetEngine(engine);
+  settings.setValue("player/engine", engine);
   audioPlayer.GetVolume(volume);
   settings.setValue("player/volume", volume);
+  audioPlayer.GetCrossfade(crossfade);
+  settings.setValue("player/crossfade", crossfade);
+  audioPlayer.GetReplayGain(replayGain);
+  settings.setValue("player/replaygain", replayGain);
+  audioPlayer.GetReplayGainTags(replayGainTags);
+  settings.setValue("player/replaygaintags", replayGainTags);
+  audioPlayer.GetPrefetch(prefetch);
+  settings.setValue("player/prefetchmb", prefetch);
+  audioPlayer.GetEqualizerCustom(equalizerCustom);
+  settings.setValue("player/equalizercustom", equalizerCustom);
+  audioPlayer.GetEqualizerFolders(equalizerFolders);
+  settings.setValue("player/equalizerfolders", equalizerFolders);
+  audioPlayer.GetEqualizerPreset(equalizer);
+  settings.setValue("player/equalizer", equalizer);
+  audioPlayer.GetSpeed(speed);
+  settings.setValue("player/speed", speed);
   audioPlayer.GetCurrentTrack(currentTrack);
   settings.setValue("player/track", currentTrack);
   settings.setValue("player/persist_queue", persistQueue);
@@ -344,6 +422,7 @@ int main(int argc, char *argv[])
   settings.setValue("ui/viewposition", viewPosition);
   uiView.GetViewAnalyzer(viewAnalyzer);
   settings.setValue("ui/viewanalyzer", viewAnalyzer);
+  settings.setValue("ui/analyzerfps", analyzerFps);
   uiView.GetViewFolders(viewFolders);
   settings.setValue("ui/viewfolders", viewFolders);
 #ifdef HAS_GUI
@@ -378,11 +457,13 @@ static void ShowHelp()
     "\n"
     "Usage: namp OPTION\n"
     "   or: namp PATH...\n"
+    "   or: namp --stats PATH...\n"
     "\n"
     "Command-line Options:\n"
     "   -h, --help        display this help and exit\n"
     "   -s, --setup       setup last.fm scrobbling account\n"
     "   -v, --version     output version information and exit\n"
+    "       --stats       log playback glitches and a summary to /tmp/namp.log\n"
     "   PATH              file or directory to add to playlist\n"
     "\n"
     "Command-line Examples:\n"
@@ -401,6 +482,8 @@ static void ShowHelp()
     "   down,-            volume down\n"
     "   left              skip/fast backward\n"
     "   right             skip/fast forward\n"
+    "   S-left,[          playback slower\n"
+    "   S-right,]         playback faster\n"
     "   home              playlist top\n"
     "   end               playlist end\n"
     "   pgup              playlist previous page\n"
@@ -410,6 +493,9 @@ static void ShowHelp()
     "   d                 toggle show folder names\n"
     "   e                 enqueue selected track\n"
     "   E                 unenqueue selected track\n"
+    "   r                 enqueue folder of selected track\n"
+    "   ctrl-e            enqueue all find results (in find)\n"
+    "   i                 toggle playback stats overlay\n"
 #ifdef HAS_GUI
     "   f                 toggle fullscreen (lyrics/cdg)\n"
     "   g                 toggle CDG graphics window\n"
@@ -417,6 +503,8 @@ static void ShowHelp()
 #endif
     "   s                 toggle shuffle on/off\n"
     "   t                 external tag editor\n"
+    "   y                 cycle equalizer preset\n"
+    "   Y                 toggle equalizer profile for track folder\n"
 #ifdef HAS_GUI
     "   ,                 lyrics font smaller\n"
     "   .                 lyrics font larger\n"
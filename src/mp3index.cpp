@@ -0,0 +1,363 @@
+// mp3index.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "mp3index.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "log.h"
+#include "mp3util.h"
+
+// File layout (native endian, cache is local only):
+//   header, samples[count], offsets[count] (bytes)
+struct Mp3IndexHeader
+{
+  quint32 magic;
+  quint16 version;
+  quint16 frameStep;
+  quint32 sampleRate;
+  quint32 delay;
+  quint32 count;
+  quint32 reserved;
+};
+
+static const quint32 kMagic = 0x494d504e; // "NPMI"
+static const quint16 kVersion = 1;
+
+// Frames per index entry, seeks decode up to this many frames extra
+static const int kFrameStep = 8;
+
+// Frames decoded before the one at the requested position, as a frame may
+// use data from the frames before it (bit reservoir) and its output overlaps
+// with the previous one
+static const int kPrimeFrames = 2;
+static const int kMaxFrameSamples = 1152;
+
+// Delay of decoder output relative to encoder input, removed by decoders
+// together with the encoder delay from the LAME tag
+static const int kDecoderDelay = 529;
+
+// Range searched for the next frame after damaged data
+static const int kSyncSearchSize = 64 * 1024;
+
+// Offsets are stored as 32 bit
+static const qint64 kMaxFileSize = 0xffffffffll;
+
+// Frames scanned between checks for a stop request
+static const qint64 kInterruptFrames = 4096;
+
+// Max total size of cache files, least recently used are evicted beyond it
+static const qint64 kMaxCacheBytes = 32 * 1024 * 1024;
+
+static bool ReadInfoFrame(const uchar* p_Frame, const Mp3FrameHeader& p_Header, int& p_Delay)
+{
+  // Xing/Info (LAME) or VBRI (Fraunhofer) header, in a frame without audio
+  const int length = p_Header.frameLength;
+  if ((length >= 40) && (memcmp(p_Frame + 36, "VBRI", 4) == 0)) return true;
+
+  const int xingPos = Mp3Util::XingOffset(p_Frame, p_Header);
+  if (xingPos < 0) return false;
+
+  const uchar* xing = p_Frame + xingPos;
+
+  // Encoder delay is in the LAME extension, following the fields present
+  const int flags = xing[7];
+  const int lamePos = xingPos + 8 + ((flags & 0x01) ? 4 : 0) + ((flags & 0x02) ? 4 : 0) +
+    ((flags & 0x04) ? 100 : 0) + ((flags & 0x08) ? 4 : 0);
+  if (lamePos + 24 > length) return true;
+
+  const uchar* lame = p_Frame + lamePos;
+  if ((memcmp(lame, "LAME", 4) == 0) || (memcmp(lame, "Lavf", 4) == 0) || (memcmp(lame, "Lavc", 4) == 0))
+  {
+    p_Delay = ((lame[21] << 4) | (lame[22] >> 4)) + kDecoderDelay;
+  }
+
+  return true;
+}
+
+Mp3Index::Mp3Index()
+{
+}
+
+Mp3Index::~Mp3Index()
+{
+  Close();
+}
+
+QString Mp3Index::Key(const QString& p_Track)
+{
+  // File metadata only, so that a seek need not read the track
+  if (!Mp3Util::IsMp3(p_Track)) return QString();
+
+  const QFileInfo fileInfo(p_Track);
+  if (!fileInfo.exists()) return QString();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(kVersion) + ":" + p_Track.toUtf8() + ":" +
+               QByteArray::number(fileInfo.size()) + ":" +
+               QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+  return QString::fromLatin1(hash.result().toHex());
+}
+
+bool Mp3Index::Build(const QString& p_Track, const QString& p_Key)
+{
+  const QString dir = Dir();
+  if (p_Key.isEmpty() || dir.isEmpty() || !QDir().mkpath(dir)) return false;
+
+  QFile file(p_Track);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  const qint64 size = file.size();
+  if ((size < 10) || (size > kMaxFileSize)) return false;
+
+  uchar* data = file.map(0, size);
+  if (data == nullptr) return false;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // First frame may be an info frame, which decoders skip
+  qint64 pos = Mp3Util::Id3v2Size(data, 10);
+  const int first =
+    (pos < size) ? Mp3Util::FindFrame(data + pos, static_cast<int>(qMin<qint64>(size - pos, kSyncSearchSize))) : -1;
+  Mp3FrameHeader header;
+  if ((first < 0) || !Mp3Util::ParseFrameHeader(data + pos + first, header))
+  {
+    file.unmap(data);
+    return false;
+  }
+
+  pos += first;
+  const int sampleRate = header.sampleRate;
+  int delay = 0;
+  if ((pos + header.frameLength <= size) && ReadInfoFrame(data + pos, header, delay))
+  {
+    pos += header.frameLength;
+  }
+
+  std::vector<quint32> samples;
+  std::vector<quint32> offsets;
+  qint64 sample = 0;
+  qint64 frame = 0;
+  bool interrupted = false;
+  while ((pos + 4 <= size) && (sample <= 0xffffffffll))
+  {
+    if (!Mp3Util::ParseFrameHeader(data + pos, header) || (header.sampleRate != sampleRate) ||
+        (pos + header.frameLength > size))
+    {
+      // Resync after damaged data, or stop at trailing tags
+      const int searchSize = static_cast<int>(qMin<qint64>(size - pos - 1, kSyncSearchSize));
+      const int next = Mp3Util::FindFrame(data + pos + 1, searchSize);
+      if (next < 0) break;
+
+      pos += 1 + next;
+      continue;
+    }
+
+    if ((frame % kFrameStep) == 0)
+    {
+      samples.push_back(static_cast<quint32>(sample));
+      offsets.push_back(static_cast<quint32>(pos));
+    }
+
+    sample += header.samples;
+    pos += header.frameLength;
+    ++frame;
+
+    if (((frame % kInterruptFrames) == 0) && QThread::currentThread()->isInterruptionRequested())
+    {
+      interrupted = true;
+      break;
+    }
+  }
+
+  file.unmap(data);
+  if (interrupted || samples.empty()) return false;
+
+  Mp3IndexHeader indexHeader;
+  indexHeader.magic = kMagic;
+  indexHeader.version = kVersion;
+  indexHeader.frameStep = kFrameStep;
+  indexHeader.sampleRate = static_cast<quint32>(sampleRate);
+  indexHeader.delay = static_cast<quint32>(delay);
+  indexHeader.count = static_cast<quint32>(samples.size());
+  indexHeader.reserved = 0;
+
+  QSaveFile indexFile(dir + "/" + p_Key);
+  if (!indexFile.open(QIODevice::WriteOnly)) return false;
+
+  indexFile.write(reinterpret_cast<const char*>(&indexHeader), sizeof(indexHeader));
+  indexFile.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(quint32));
+  indexFile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(quint32));
+  if (!indexFile.commit())
+  {
+    Log::Warning("Failed to write mp3 index %s", p_Key.toStdString().c_str());
+    return false;
+  }
+
+  Log::Debug("Mp3 index written %s, %lld frames in %lld ms track=%s", p_Key.toStdString().c_str(), frame,
+             timer.elapsed(), p_Track.toStdString().c_str());
+  return true;
+}
+
+void Mp3Index::Evict()
+{
+  QDir dir(Dir());
+  QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time); // newest first
+  qint64 totalSize = 0;
+  for (const QFileInfo& fileInfo : files)
+  {
+    totalSize += fileInfo.size();
+  }
+
+  while ((totalSize > kMaxCacheBytes) && !files.isEmpty())
+  {
+    const QFileInfo fileInfo = files.takeLast();
+    if (QFile::remove(fileInfo.absoluteFilePath()))
+    {
+      totalSize -= fileInfo.size();
+    }
+  }
+}
+
+bool Mp3Index::Open(const QString& p_Key)
+{
+  Close();
+
+  const QString dir = Dir();
+  if (p_Key.isEmpty() || dir.isEmpty()) return false;
+
+  m_File.setFileName(dir + "/" + p_Key);
+  if (!m_File.open(QIODevice::ReadOnly)) return false;
+
+  const qint64 size = m_File.size();
+  if (size >= static_cast<qint64>(sizeof(Mp3IndexHeader)))
+  {
+    m_Data = m_File.map(0, size);
+  }
+
+  if (m_Data != nullptr)
+  {
+    const Mp3IndexHeader* header = reinterpret_cast<const Mp3IndexHeader*>(m_Data);
+    const qint64 expectedSize = sizeof(Mp3IndexHeader) + (static_cast<qint64>(header->count) * 2 * sizeof(quint32));
+    if ((header->magic == kMagic) && (header->version == kVersion) && (header->frameStep == kFrameStep) &&
+        (header->sampleRate > 0) && (header->count > 0) && (size == expectedSize))
+    {
+      m_Count = static_cast<int>(header->count);
+      m_SampleRate = static_cast<int>(header->sampleRate);
+      m_Delay = static_cast<int>(header->delay);
+      m_Samples = reinterpret_cast<const quint32*>(m_Data + sizeof(Mp3IndexHeader));
+      m_Offsets = m_Samples + m_Count;
+
+      // Mark as recently used
+      m_File.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+      return true;
+    }
+
+    Log::Warning("Invalid mp3 index %s", p_Key.toStdString().c_str());
+  }
+
+  Close();
+  return false;
+}
+
+void Mp3Index::Close()
+{
+  if (m_Data != nullptr)
+  {
+    m_File.unmap(m_Data);
+    m_Data = nullptr;
+  }
+
+  m_File.close();
+  m_Samples = nullptr;
+  m_Offsets = nullptr;
+  m_Count = 0;
+  m_SampleRate = 0;
+  m_Delay = 0;
+}
+
+bool Mp3Index::IsOpen() const
+{
+  return (m_Count > 0);
+}
+
+int Mp3Index::SampleRate() const
+{
+  return m_SampleRate;
+}
+
+bool Mp3Index::Find(qint64 p_PositionMs, qint64& p_Offset, qint64& p_SkipSamples) const
+{
+  // Frame to start decoding from for given position, and the number of
+  // decoded samples from there to drop to reach it exactly. Positions are
+  // on the timeline of decoding from start, with encoder delay removed.
+  if ((m_Count == 0) || (p_PositionMs <= 0)) return false;
+
+  const qint64 target = ((p_PositionMs * m_SampleRate) / 1000) + m_Delay;
+  const qint64 start = target - (kPrimeFrames * kMaxFrameSamples);
+  if ((start < 0) || (start > 0xffffffffll)) return false;
+
+  const quint32* it = std::upper_bound(m_Samples, m_Samples + m_Count, static_cast<quint32>(start));
+  const int index = static_cast<int>(it - m_Samples) - 1;
+  if (index < 0) return false;
+
+  p_Offset = m_Offsets[index];
+  p_SkipSamples = target - m_Samples[index];
+  return true;
+}
+
+QString Mp3Index::Dir()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  return cacheDir.isEmpty() ? QString() : (cacheDir + "/mp3index");
+}
+
+Mp3IndexWorker::Mp3IndexWorker()
+{
+}
+
+void Mp3IndexWorker::SetTracks(const QStringList& p_Tracks)
+{
+  const bool idle = m_Tracks.isEmpty();
+  m_Tracks = p_Tracks;
+  if (idle)
+  {
+    QMetaObject::invokeMethod(this, &Mp3IndexWorker::IndexNext, Qt::QueuedConnection);
+  }
+}
+
+void Mp3IndexWorker::IndexNext()
+{
+  if (m_Tracks.isEmpty()) return;
+
+  const QString track = m_Tracks.takeFirst();
+  const QString key = Mp3Index::Key(track);
+  Mp3Index index;
+  if (!key.isEmpty() && !index.Open(key) && Mp3Index::Build(track, key))
+  {
+    Mp3Index::Evict();
+  }
+
+  // One track at a time, so that updated tracks are picked up in between
+  if (!m_Tracks.isEmpty())
+  {
+    QMetaObject::invokeMethod(this, &Mp3IndexWorker::IndexNext, Qt::QueuedConnection);
+  }
+}
@@ -0,0 +1,68 @@
+// mp3index.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+// Persistent per-track mp3 frame index, for seeking to an exact position
+// also in variable bitrate files without (or with only a coarse) Xing table.
+// Holds the first sample and byte offset of every few frames, stored as flat
+// arrays in a file keyed by track path, size and modification time, and
+// memory-mapped when read. Lookup is a binary search. Used by the native
+// engine, QMediaPlayer seeks through its own backend.
+class Mp3Index
+{
+public:
+  Mp3Index();
+  ~Mp3Index();
+
+  static QString Key(const QString& p_Track);
+  static bool Build(const QString& p_Track, const QString& p_Key);
+  static void Evict();
+
+  bool Open(const QString& p_Key);
+  void Close();
+  bool IsOpen() const;
+  int SampleRate() const;
+  bool Find(qint64 p_PositionMs, qint64& p_Offset, qint64& p_SkipSamples) const;
+
+private:
+  static QString Dir();
+
+private:
+  QFile m_File;
+  uchar* m_Data = nullptr;
+  const quint32* m_Samples = nullptr;
+  const quint32* m_Offsets = nullptr;
+  int m_Count = 0;
+  int m_SampleRate = 0;
+  int m_Delay = 0;
+};
+
+// Builds frame indexes of mp3 tracks likely to be played, on a low priority
+// thread, one track at a time.
+class Mp3IndexWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  Mp3IndexWorker();
+
+public slots:
+  void SetTracks(const QStringList& p_Tracks);
+
+private:
+  void IndexNext();
+
+private:
+  QStringList m_Tracks;
+};
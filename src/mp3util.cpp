@@ -0,0 +1,188 @@
+// mp3util.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "mp3util.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <cstring>
+
+static quint32 ReadBe32(const unsigned char* p_Data)
+{
+  return (static_cast<quint32>(p_Data[0]) << 24) | (static_cast<quint32>(p_Data[1]) << 16) |
+    (static_cast<quint32>(p_Data[2]) << 8) | static_cast<quint32>(p_Data[3]);
+}
+
+bool Mp3Util::IsMp3(const QString& p_Path)
+{
+  return p_Path.endsWith(".mp3", Qt::CaseInsensitive);
+}
+
+bool Mp3Util::ParseFrameHeader(const unsigned char* p_Data, Mp3FrameHeader& p_Header)
+{
+  // Frame sync (11 bits)
+  if ((p_Data[0] != 0xFF) || ((p_Data[1] & 0xE0) != 0xE0)) return false;
+
+  const int version = (p_Data[1] >> 3) & 0x03; // 0 = 2.5, 1 = reserved, 2 = 2, 3 = 1
+  const int layer = (p_Data[1] >> 1) & 0x03; // 0 = reserved, 1 = III, 2 = II, 3 = I
+  const int bitrateIndex = (p_Data[2] >> 4) & 0x0F;
+  const int sampleRateIndex = (p_Data[2] >> 2) & 0x03;
+  const int padding = (p_Data[2] >> 1) & 0x01;
+  if ((version == 1) || (layer == 0) || (bitrateIndex == 0) || (bitrateIndex == 15) ||
+      (sampleRateIndex == 3))
+  {
+    return false;
+  }
+
+  static const int bitrates[5][16] = {
+    { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 }, // v1 l1
+    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },    // v1 l2
+    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },     // v1 l3
+    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },    // v2 l1
+    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },         // v2 l2/l3
+  };
+  static const int sampleRates[3][3] = {
+    { 44100, 48000, 32000 }, // v1
+    { 22050, 24000, 16000 }, // v2
+    { 11025, 12000, 8000 },  // v2.5
+  };
+
+  const bool isV1 = (version == 3);
+  const int layerNum = 4 - layer; // 1, 2 or 3
+  const int bitrateRow = isV1 ? (layerNum - 1) : ((layerNum == 1) ? 3 : 4);
+  const int sampleRateRow = isV1 ? 0 : ((version == 2) ? 1 : 2);
+
+  p_Header.bitrate = bitrates[bitrateRow][bitrateIndex] * 1000;
+  p_Header.sampleRate = sampleRates[sampleRateRow][sampleRateIndex];
+  if (layerNum == 1)
+  {
+    p_Header.samples = 384;
+    p_Header.frameLength = ((12 * p_Header.bitrate / p_Header.sampleRate) + padding) * 4;
+  }
+  else
+  {
+    p_Header.samples = ((layerNum == 3) && !isV1) ? 576 : 1152;
+    p_Header.frameLength = ((p_Header.samples / 8) * p_Header.bitrate / p_Header.sampleRate) + padding;
+  }
+
+  return true;
+}
+
+int Mp3Util::FindFrame(const unsigned char* p_Data, int p_Size)
+{
+  // Require two consecutive valid headers to avoid false syncs in audio data
+  for (int i = 0; i + 4 <= p_Size; ++i)
+  {
+    Mp3FrameHeader header;
+    if (!ParseFrameHeader(p_Data + i, header)) continue;
+
+    const int next = i + header.frameLength;
+    if (next + 4 > p_Size) return -1;
+
+    Mp3FrameHeader nextHeader;
+    if (ParseFrameHeader(p_Data + next, nextHeader) && (nextHeader.sampleRate == header.sampleRate))
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+qint64 Mp3Util::Id3v2Size(const unsigned char* p_Data, int p_Size)
+{
+  if ((p_Size < 10) || (p_Data[0] != 'I') || (p_Data[1] != 'D') || (p_Data[2] != '3')) return 0;
+
+  // Syncsafe size excluding the 10 byte header (and optional 10 byte footer)
+  const qint64 size = ((p_Data[6] & 0x7F) << 21) | ((p_Data[7] & 0x7F) << 14) |
+    ((p_Data[8] & 0x7F) << 7) | (p_Data[9] & 0x7F);
+  const bool hasFooter = (p_Data[5] & 0x10);
+  return 10 + size + (hasFooter ? 10 : 0);
+}
+
+int Mp3Util::XingOffset(const unsigned char* p_Frame, const Mp3FrameHeader& p_Header)
+{
+  // Xing (VBR) or Info (CBR) header after the side information of the first
+  // frame, or -1 if not present
+  const bool isV1 = (((p_Frame[1] >> 3) & 0x03) == 3);
+  const bool isMono = (((p_Frame[3] >> 6) & 0x03) == 3);
+  const int offset = 4 + (isV1 ? (isMono ? 17 : 32) : (isMono ? 9 : 17));
+  if (offset + 8 > p_Header.frameLength) return -1;
+
+  const unsigned char* xing = p_Frame + offset;
+  return ((memcmp(xing, "Xing", 4) == 0) || (memcmp(xing, "Info", 4) == 0)) ? offset : -1;
+}
+
+qint64 Mp3Util::EstimateOffset(const QString& p_Path, qint64 p_PositionMs, qint64 p_DurationMs)
+{
+  // Byte offset of a frame near given position, from the Xing table of
+  // contents if present and otherwise assuming roughly constant bitrate, or
+  // -1 if not possible
+  if (!IsMp3(p_Path) || (p_PositionMs <= 0) || (p_DurationMs <= 0)) return -1;
+
+  QFile file(p_Path);
+  if (!file.open(QIODevice::ReadOnly)) return -1;
+
+  const QByteArray head = file.read(10);
+  const qint64 audioStart = Id3v2Size(reinterpret_cast<const unsigned char*>(head.constData()), head.size());
+  const qint64 audioSize = file.size() - audioStart;
+  if (audioSize <= 0) return -1;
+
+  qint64 estimate = audioStart + static_cast<qint64>(audioSize * (static_cast<double>(p_PositionMs) / p_DurationMs));
+
+  static const int kSearchSize = 16 * 1024;
+  if (file.seek(audioStart))
+  {
+    const QByteArray first = file.read(kSearchSize);
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(first.constData());
+    const int index = FindFrame(data, first.size());
+    Mp3FrameHeader header;
+    const int xing = ((index >= 0) && ParseFrameHeader(data + index, header)) ? XingOffset(data + index, header) : -1;
+    if (xing >= 0)
+    {
+      // Fields present are given by flags, in order frames, bytes and table
+      const unsigned char* frame = data + index;
+      const int flags = frame[xing + 7];
+      int pos = xing + 8;
+      qint64 frames = 0;
+      qint64 bytes = audioSize - index;
+      if ((flags & 0x01) && (pos + 4 <= header.frameLength))
+      {
+        frames = ReadBe32(frame + pos);
+        pos += 4;
+      }
+
+      if ((flags & 0x02) && (pos + 4 <= header.frameLength))
+      {
+        bytes = ReadBe32(frame + pos);
+        pos += 4;
+      }
+
+      if ((flags & 0x04) && (pos + 100 <= header.frameLength))
+      {
+        // Table maps each percent of duration to a 1/256 fraction of the
+        // stream size, interpolated in between
+        const double durationMs =
+          (frames > 0) ? ((frames * header.samples * 1000.0) / header.sampleRate) : p_DurationMs;
+        const double percent = qBound(0.0, (100.0 * p_PositionMs) / durationMs, 99.999);
+        const int i = static_cast<int>(percent);
+        const double fa = frame[pos + i];
+        const double fb = (i < 99) ? frame[pos + i + 1] : 256.0;
+        const double fraction = (fa + ((fb - fa) * (percent - i))) / 256.0;
+        estimate = audioStart + index + static_cast<qint64>(fraction * bytes);
+      }
+    }
+  }
+
+  if (!file.seek(estimate)) return -1;
+
+  const QByteArray data = file.read(kSearchSize);
+  const int index = FindFrame(reinterpret_cast<const unsigned char*>(data.constData()), data.size());
+  return (index >= 0) ? (estimate + index) : -1;
+}
@@ -0,0 +1,30 @@
+// mp3util.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QString>
+
+struct Mp3FrameHeader
+{
+  int frameLength = 0;
+  int samples = 0;
+  int sampleRate = 0;
+  int bitrate = 0;
+};
+
+class Mp3Util
+{
+public:
+  static bool IsMp3(const QString& p_Path);
+  static bool ParseFrameHeader(const unsigned char* p_Data, Mp3FrameHeader& p_Header);
+  static int FindFrame(const unsigned char* p_Data, int p_Size);
+  static qint64 Id3v2Size(const unsigned char* p_Data, int p_Size);
+  static int XingOffset(const unsigned char* p_Frame, const Mp3FrameHeader& p_Header);
+  static qint64 EstimateOffset(const QString& p_Path, qint64 p_PositionMs, qint64 p_DurationMs);
+};
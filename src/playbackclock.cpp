@@ -0,0 +1,102 @@
+// playbackclock.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "playbackclock.h"
+
+#include <cmath>
+
+// Position errors larger than this are treated as seeks and applied at once
+static const double kSnapThresholdMs = 500.0;
+
+// Smaller errors are corrected over this time, with limited rate change
+static const double kSlewTimeMs = 1000.0;
+static const double kMaxSlewRate = 0.05;
+
+PlaybackClock::PlaybackClock(QObject* p_Parent)
+  : QObject(p_Parent)
+{
+  m_Timer.start();
+}
+
+qint64 PlaybackClock::Position() const
+{
+  return static_cast<qint64>(Extrapolate(m_Timer.nsecsElapsed()));
+}
+
+qint64 PlaybackClock::AudiblePosition() const
+{
+  // Output latency is in wall time, which covers more media at higher speed
+  return Position() + static_cast<qint64>(m_OutputLatencyMs * m_Speed);
+}
+
+qint64 PlaybackClock::OutputLatency() const
+{
+  return m_OutputLatencyMs;
+}
+
+void PlaybackClock::Update(qint64 p_PositionMs)
+{
+  const qint64 nowNs = m_Timer.nsecsElapsed();
+  const double predictedMs = Extrapolate(nowNs);
+  const double errorMs = p_PositionMs - predictedMs;
+  if (!m_Playing || (std::fabs(errorMs) > kSnapThresholdMs))
+  {
+    Rebase(p_PositionMs, nowNs);
+    m_Rate = 1.0;
+  }
+  else
+  {
+    // Continue from predicted position, running slightly faster or slower
+    // until the error has been absorbed
+    Rebase(predictedMs, nowNs);
+    m_Rate = 1.0 + qBound(-kMaxSlewRate, errorMs / (kSlewTimeMs * m_Speed), kMaxSlewRate);
+  }
+}
+
+void PlaybackClock::Seek(qint64 p_PositionMs)
+{
+  Rebase(p_PositionMs, m_Timer.nsecsElapsed());
+  m_Rate = 1.0;
+}
+
+void PlaybackClock::SetPlaying(bool p_Playing)
+{
+  if (p_Playing == m_Playing) return;
+
+  const qint64 nowNs = m_Timer.nsecsElapsed();
+  Rebase(Extrapolate(nowNs), nowNs);
+  m_Rate = 1.0;
+  m_Playing = p_Playing;
+}
+
+void PlaybackClock::SetOutputLatency(qint64 p_LatencyMs)
+{
+  m_OutputLatencyMs = p_LatencyMs;
+}
+
+void PlaybackClock::SetSpeed(double p_Speed)
+{
+  if (p_Speed == m_Speed) return;
+
+  const qint64 nowNs = m_Timer.nsecsElapsed();
+  Rebase(Extrapolate(nowNs), nowNs);
+  m_Speed = p_Speed;
+}
+
+double PlaybackClock::Extrapolate(qint64 p_NowNs) const
+{
+  if (!m_Playing) return m_BasePositionMs;
+
+  return m_BasePositionMs + ((p_NowNs - m_BaseNs) / 1000000.0) * m_Rate * m_Speed;
+}
+
+void PlaybackClock::Rebase(double p_PositionMs, qint64 p_NowNs)
+{
+  m_BasePositionMs = p_PositionMs;
+  m_BaseNs = p_NowNs;
+}
@@ -0,0 +1,49 @@
+// playbackclock.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+
+// Playback position extrapolated from a monotonic clock between the coarse
+// position updates of the media player, advancing at the playback speed.
+// Small drift is corrected by slewing the clock rate, larger jumps (seeks)
+// are applied immediately. The audible position is offset by the output
+// latency set, for position sources that do not account for it.
+class PlaybackClock : public QObject
+{
+  Q_OBJECT
+
+public:
+  PlaybackClock(QObject* p_Parent = nullptr);
+
+  qint64 Position() const;
+  qint64 AudiblePosition() const;
+  qint64 OutputLatency() const;
+
+public slots:
+  void Update(qint64 p_PositionMs);
+  void Seek(qint64 p_PositionMs);
+  void SetPlaying(bool p_Playing);
+  void SetOutputLatency(qint64 p_LatencyMs);
+  void SetSpeed(double p_Speed);
+
+private:
+  double Extrapolate(qint64 p_NowNs) const;
+  void Rebase(double p_PositionMs, qint64 p_NowNs);
+
+private:
+  QElapsedTimer m_Timer;
+  bool m_Playing = false;
+  double m_BasePositionMs = 0.0;
+  qint64 m_BaseNs = 0;
+  double m_Rate = 1.0;
+  double m_Speed = 1.0;
+  qint64 m_OutputLatencyMs = 0;
+};
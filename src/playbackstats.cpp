@@ -0,0 +1,129 @@
+// playbackstats.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "playbackstats.h"
+
+#include <QDateTime>
+
+#include "log.h"
+
+// Recent events kept for the dump
+static const size_t kMaxEvents = 256;
+
+int PlaybackStats::m_Counts[PlaybackStats::CounterCount] = { 0 };
+qint64 PlaybackStats::m_LastTimes[PlaybackStats::CounterCount] = { 0 };
+std::deque<PlaybackStats::Event> PlaybackStats::m_Events;
+float PlaybackStats::m_DspLoad = 0.0f;
+qint64 PlaybackStats::m_OutputLatencyMs = 0;
+bool PlaybackStats::m_LogEnabled = false;
+std::mutex PlaybackStats::m_Mutex;
+
+void PlaybackStats::SetLogEnabled(bool p_LogEnabled)
+{
+  m_LogEnabled = p_LogEnabled;
+}
+
+void PlaybackStats::Record(Counter p_Counter, const QString& p_Detail /*= QString()*/, int p_Count /*= 1*/)
+{
+  if ((p_Counter < 0) || (p_Counter >= CounterCount) || (p_Count <= 0)) return;
+
+  const qint64 timeMs = QDateTime::currentMSecsSinceEpoch();
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Counts[p_Counter] += p_Count;
+    m_LastTimes[p_Counter] = timeMs;
+    m_Events.push_back(Event{ p_Counter, timeMs, p_Count, p_Detail });
+    while (m_Events.size() > kMaxEvents)
+    {
+      m_Events.pop_front();
+    }
+  }
+
+  if (m_LogEnabled)
+  {
+    Log::Info("Stats %s x%d %s", GetName(p_Counter), p_Count, p_Detail.toStdString().c_str());
+  }
+}
+
+int PlaybackStats::GetCount(Counter p_Counter)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Counts[p_Counter];
+}
+
+qint64 PlaybackStats::GetLastTime(Counter p_Counter)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_LastTimes[p_Counter];
+}
+
+QVector<PlaybackStats::Event> PlaybackStats::GetEvents()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  QVector<Event> events;
+  events.reserve(static_cast<int>(m_Events.size()));
+  for (const Event& event : m_Events)
+  {
+    events.push_back(event);
+  }
+
+  return events;
+}
+
+const char* PlaybackStats::GetName(Counter p_Counter)
+{
+  switch (p_Counter)
+  {
+    case Underrun: return "underrun";
+    case DecoderStall: return "decoder-stall";
+    case LatePosition: return "late-position";
+    case DeviceRestart: return "device-restart";
+    case DspOverload: return "dsp-overload";
+    default: return "unknown";
+  }
+}
+
+void PlaybackStats::SetDspLoad(float p_Load)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_DspLoad = p_Load;
+}
+
+float PlaybackStats::GetDspLoad()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_DspLoad;
+}
+
+void PlaybackStats::SetOutputLatency(qint64 p_LatencyMs)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_OutputLatencyMs = p_LatencyMs;
+}
+
+qint64 PlaybackStats::GetOutputLatency()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_OutputLatencyMs;
+}
+
+void PlaybackStats::Dump()
+{
+  Log::Info("Stats summary: underruns %d, decoder stalls %d, late position updates %d, device restarts %d, "
+            "dsp overloads %d, dsp load %.2f%%, output latency %lld ms",
+            GetCount(Underrun), GetCount(DecoderStall), GetCount(LatePosition), GetCount(DeviceRestart),
+            GetCount(DspOverload), GetDspLoad() * 100.0f, static_cast<long long>(GetOutputLatency()));
+
+  const QVector<Event> events = GetEvents();
+  for (const Event& event : events)
+  {
+    const QString time = QDateTime::fromMSecsSinceEpoch(event.timeMs).toString("hh:mm:ss.zzz");
+    Log::Info("Stats event %s %s x%d %s", time.toStdString().c_str(), GetName(event.counter), event.count,
+              event.detail.toStdString().c_str());
+  }
+}
@@ -0,0 +1,60 @@
+// playbackstats.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <deque>
+#include <mutex>
+
+// Counters for glitches in the output path, keeping timestamps of recent
+// occurrences so they can be correlated with other activity in the log.
+class PlaybackStats
+{
+public:
+  enum Counter
+  {
+    Underrun = 0,
+    DecoderStall,
+    LatePosition,
+    DeviceRestart,
+    DspOverload,
+    CounterCount
+  };
+
+  struct Event
+  {
+    Counter counter;
+    qint64 timeMs;
+    int count;
+    QString detail;
+  };
+
+  static void SetLogEnabled(bool p_LogEnabled);
+  static void Record(Counter p_Counter, const QString& p_Detail = QString(), int p_Count = 1);
+  static int GetCount(Counter p_Counter);
+  static qint64 GetLastTime(Counter p_Counter);
+  static QVector<Event> GetEvents();
+  static const char* GetName(Counter p_Counter);
+  static void SetDspLoad(float p_Load);
+  static float GetDspLoad();
+  static void SetOutputLatency(qint64 p_LatencyMs);
+  static qint64 GetOutputLatency();
+  static void Dump();
+
+private:
+  static int m_Counts[CounterCount];
+  static qint64 m_LastTimes[CounterCount];
+  static std::deque<Event> m_Events;
+  static float m_DspLoad;
+  static qint64 m_OutputLatencyMs;
+  static bool m_LogEnabled;
+  static std::mutex m_Mutex;
+};
@@ -0,0 +1,125 @@
+// playqueue.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "playqueue.h"
+
+bool PlayQueue::IsEmpty() const
+{
+  return m_Items.empty();
+}
+
+int PlayQueue::Size() const
+{
+  return static_cast<int>(m_Items.size());
+}
+
+int PlayQueue::Front() const
+{
+  return m_Items.empty() ? -1 : m_Items.front();
+}
+
+int PlayQueue::Back() const
+{
+  return m_Items.empty() ? -1 : m_Items.back();
+}
+
+int PlayQueue::TakeFront()
+{
+  if (m_Items.empty()) return -1;
+
+  // Front entry always holds the lowest sequence number of its track
+  const int index = m_Items.front();
+  m_Items.pop_front();
+  auto it = m_Seqs.find(index);
+  it.value().remove(0);
+  if (it.value().isEmpty())
+  {
+    m_Seqs.erase(it);
+  }
+
+  ++m_FrontSeq;
+  return index;
+}
+
+void PlayQueue::Append(int p_Index)
+{
+  const qint64 seq = m_FrontSeq + static_cast<qint64>(m_Items.size());
+  m_Items.push_back(p_Index);
+  m_Seqs[p_Index].append(seq);
+}
+
+void PlayQueue::Append(const QVector<int>& p_Indices)
+{
+  for (const int index : p_Indices)
+  {
+    Append(index);
+  }
+}
+
+int PlayQueue::RemoveAll(int p_Index)
+{
+  auto it = m_Seqs.constFind(p_Index);
+  if (it == m_Seqs.constEnd()) return 0;
+
+  // Entries after a removed one move up, so the queue is renumbered
+  const int removed = static_cast<int>(it.value().size());
+  std::deque<int> items;
+  for (const int index : m_Items)
+  {
+    if (index != p_Index)
+    {
+      items.push_back(index);
+    }
+  }
+
+  Rebuild(items);
+  return removed;
+}
+
+void PlayQueue::Clear()
+{
+  m_Items.clear();
+  m_Seqs.clear();
+  m_FrontSeq = 0;
+}
+
+QVector<int> PlayQueue::Positions(int p_Index) const
+{
+  // One-based positions, as presented
+  QVector<int> positions;
+  auto it = m_Seqs.constFind(p_Index);
+  if (it == m_Seqs.constEnd()) return positions;
+
+  for (const qint64 seq : it.value())
+  {
+    positions.append(static_cast<int>(seq - m_FrontSeq) + 1);
+  }
+
+  return positions;
+}
+
+QVector<int> PlayQueue::ToVector() const
+{
+  QVector<int> indices;
+  indices.reserve(static_cast<int>(m_Items.size()));
+  for (const int index : m_Items)
+  {
+    indices.append(index);
+  }
+
+  return indices;
+}
+
+void PlayQueue::Rebuild(const std::deque<int>& p_Items)
+{
+  Clear();
+  for (const int index : p_Items)
+  {
+    Append(index);
+  }
+}
@@ -0,0 +1,44 @@
+// playqueue.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QHash>
+#include <QVarLengthArray>
+#include <QVector>
+
+#include <deque>
+
+// Queue of playlist indices to play next. Entries are numbered by sequence
+// number, so that taking the front entry or appending is constant time and
+// the queue positions of a track are found without searching the queue.
+// Sequence numbers of a track are kept inline, as tracks are rarely queued
+// more than a couple of times.
+class PlayQueue
+{
+public:
+  bool IsEmpty() const;
+  int Size() const;
+  int Front() const;
+  int Back() const;
+  int TakeFront();
+  void Append(int p_Index);
+  void Append(const QVector<int>& p_Indices);
+  int RemoveAll(int p_Index);
+  void Clear();
+  QVector<int> Positions(int p_Index) const;
+  QVector<int> ToVector() const;
+
+private:
+  void Rebuild(const std::deque<int>& p_Items);
+
+private:
+  std::deque<int> m_Items;
+  qint64 m_FrontSeq = 0;
+  QHash<int, QVarLengthArray<qint64, 2>> m_Seqs;
+};
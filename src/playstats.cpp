@@ -0,0 +1,208 @@
+// playstats.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "playstats.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include <cmath>
+
+#include "log.h"
+
+// File layout (native endian, statistics are local only):
+//   header, records[] (one per track, updated in place)
+struct PlayStatsHeader
+{
+  quint32 magic;
+  quint16 version;
+  quint16 recordSize;
+};
+
+struct PlayStatsRecord
+{
+  quint64 key;
+  quint32 plays;
+  quint32 skips;
+  qint64 lastPlayed;
+};
+
+static const quint32 kMagic = 0x5350504e; // "NPPS"
+static const quint16 kVersion = 1;
+
+// Time constant over which a played track recovers its full weight
+static const float kRecoveryDays = 14.0f;
+
+// Lower bound of track weight, so that no track is excluded entirely
+static const float kMinWeight = 0.05f;
+
+PlayStats::PlayStats()
+{
+}
+
+QString PlayStats::TrackStarted(const QString& p_Track)
+{
+  // Previous track was left before being played, returned as skipped
+  QString skippedTrack;
+  if (!m_StartedTrack.isEmpty() && (m_StartedTrack != p_Track))
+  {
+    Load();
+    const quint64 key = Key(m_StartedTrack);
+    PlayStatsEntry entry = m_Entries.value(key);
+    ++entry.skips;
+    Store(key, entry);
+    skippedTrack = m_StartedTrack;
+  }
+
+  m_StartedTrack = p_Track;
+  return skippedTrack;
+}
+
+void PlayStats::TrackPlayed(const QString& p_Track)
+{
+  Load();
+  const quint64 key = Key(p_Track);
+  PlayStatsEntry entry = m_Entries.value(key);
+  ++entry.plays;
+  entry.lastPlayed = QDateTime::currentSecsSinceEpoch();
+  Store(key, entry);
+
+  if (m_StartedTrack == p_Track)
+  {
+    m_StartedTrack.clear();
+  }
+}
+
+void PlayStats::TrackEnded()
+{
+  // Track played to its end is not skipped, also if too short to be counted
+  // as played
+  m_StartedTrack.clear();
+}
+
+bool PlayStats::Find(const QString& p_Track, PlayStatsEntry& p_Entry)
+{
+  Load();
+  auto it = m_Entries.constFind(Key(p_Track));
+  if (it == m_Entries.constEnd()) return false;
+
+  p_Entry = it.value();
+  return true;
+}
+
+float PlayStats::Weight(const QString& p_Track, qint64 p_Now)
+{
+  PlayStatsEntry entry;
+  if (!Find(p_Track, entry)) return 1.0f;
+
+  // Often played and rarely skipped tracks come up more, and recently
+  // played tracks less
+  const float skipRate = static_cast<float>(entry.skips) / static_cast<float>(qMax(1u, entry.plays + entry.skips));
+  const float favour = (1.0f + (0.25f * log2f(1.0f + entry.plays))) * (1.0f - (0.8f * skipRate));
+  float recency = 1.0f;
+  if (entry.lastPlayed > 0)
+  {
+    const float days = static_cast<float>(qMax(0ll, p_Now - entry.lastPlayed)) / (24.0f * 3600.0f);
+    recency = 1.0f - expf(-days / kRecoveryDays);
+  }
+
+  return qMax(kMinWeight, favour * recency);
+}
+
+void PlayStats::Load()
+{
+  if (m_Loaded) return;
+
+  m_Loaded = true;
+  const QString path = Path();
+  if (path.isEmpty() || !QDir().mkpath(QFileInfo(path).path())) return;
+
+  m_File.setFileName(path);
+  if (!m_File.open(QIODevice::ReadWrite))
+  {
+    Log::Warning("Failed to open play statistics %s", path.toStdString().c_str());
+    return;
+  }
+
+  const QByteArray data = m_File.readAll();
+  const PlayStatsHeader* header = reinterpret_cast<const PlayStatsHeader*>(data.constData());
+  const bool valid = (data.size() >= static_cast<int>(sizeof(PlayStatsHeader))) && (header->magic == kMagic) &&
+    (header->version == kVersion) && (header->recordSize == sizeof(PlayStatsRecord));
+  if (valid)
+  {
+    // A partly written last record is ignored, and overwritten by the next
+    const int count = (data.size() - sizeof(PlayStatsHeader)) / sizeof(PlayStatsRecord);
+    const PlayStatsRecord* records =
+      reinterpret_cast<const PlayStatsRecord*>(data.constData() + sizeof(PlayStatsHeader));
+    m_Entries.reserve(count);
+    m_Offsets.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+      PlayStatsEntry entry;
+      entry.plays = records[i].plays;
+      entry.skips = records[i].skips;
+      entry.lastPlayed = records[i].lastPlayed;
+      m_Entries.insert(records[i].key, entry);
+      m_Offsets.insert(records[i].key, sizeof(PlayStatsHeader) + (i * sizeof(PlayStatsRecord)));
+    }
+
+    m_File.resize(sizeof(PlayStatsHeader) + (count * sizeof(PlayStatsRecord)));
+    Log::Debug("Play statistics loaded, %d entries", m_Entries.size());
+  }
+  else
+  {
+    PlayStatsHeader newHeader;
+    newHeader.magic = kMagic;
+    newHeader.version = kVersion;
+    newHeader.recordSize = sizeof(PlayStatsRecord);
+    m_File.resize(0);
+    m_File.seek(0);
+    m_File.write(reinterpret_cast<const char*>(&newHeader), sizeof(newHeader));
+    m_File.flush();
+  }
+}
+
+void PlayStats::Store(quint64 p_Key, const PlayStatsEntry& p_Entry)
+{
+  m_Entries.insert(p_Key, p_Entry);
+  if (!m_File.isOpen()) return;
+
+  auto it = m_Offsets.constFind(p_Key);
+  const qint64 offset = (it != m_Offsets.constEnd()) ? it.value() : m_File.size();
+  m_Offsets.insert(p_Key, offset);
+
+  PlayStatsRecord record;
+  record.key = p_Key;
+  record.plays = p_Entry.plays;
+  record.skips = p_Entry.skips;
+  record.lastPlayed = p_Entry.lastPlayed;
+  m_File.seek(offset);
+  m_File.write(reinterpret_cast<const char*>(&record), sizeof(record));
+  m_File.flush();
+}
+
+quint64 PlayStats::Key(const QString& p_Track)
+{
+  // 64-bit FNV-1a of the path, stable across runs unlike qHash()
+  quint64 hash = 14695981039346656037ull;
+  for (const QChar ch : p_Track)
+  {
+    hash ^= ch.unicode();
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+QString PlayStats::Path()
+{
+  const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+  return dataDir.isEmpty() ? QString() : (dataDir + "/playstats.dat");
+}
@@ -0,0 +1,49 @@
+// playstats.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+struct PlayStatsEntry
+{
+  quint32 plays = 0;
+  quint32 skips = 0;
+  qint64 lastPlayed = 0; // seconds since epoch
+};
+
+// Local per-track play statistics, as one fixed-size record per track in a
+// single file, updated in place. Tracks are counted as played at the
+// scrobble point, and a track left before it, other than by reaching its
+// end, counts as skipped.
+class PlayStats
+{
+public:
+  PlayStats();
+
+  QString TrackStarted(const QString& p_Track);
+  void TrackPlayed(const QString& p_Track);
+  void TrackEnded();
+  bool Find(const QString& p_Track, PlayStatsEntry& p_Entry);
+  float Weight(const QString& p_Track, qint64 p_Now);
+
+private:
+  void Load();
+  void Store(quint64 p_Key, const PlayStatsEntry& p_Entry);
+  static quint64 Key(const QString& p_Track);
+  static QString Path();
+
+private:
+  bool m_Loaded = false;
+  QFile m_File;
+  QHash<quint64, PlayStatsEntry> m_Entries;
+  QHash<quint64, qint64> m_Offsets;
+  QString m_StartedTrack;
+};
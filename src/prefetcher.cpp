@@ -0,0 +1,104 @@
+// prefetcher.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "prefetcher.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <climits>
+
+#include <fcntl.h>
+
+#include "log.h"
+
+void PrefetchWorker::Prefetch(const QString& p_Track, qint64 p_Bytes)
+{
+  QFile file(p_Track);
+  if (!file.open(QIODevice::ReadOnly)) return;
+
+  const qint64 bytes = qMin(p_Bytes, file.size());
+  const int fd = file.handle();
+  QElapsedTimer timer;
+  timer.start();
+#if defined(__linux__)
+  // Blocks until the range is read, which is fine on this thread, and falls
+  // back to the advisory call on file systems not supporting it
+  int rv = readahead(fd, 0, bytes);
+  if (rv != 0)
+  {
+    rv = posix_fadvise(fd, 0, bytes, POSIX_FADV_WILLNEED);
+  }
+#elif defined(__APPLE__)
+  struct radvisory advisory;
+  advisory.ra_offset = 0;
+  advisory.ra_count = static_cast<int>(qMin(bytes, static_cast<qint64>(INT_MAX)));
+  int rv = fcntl(fd, F_RDADVISE, &advisory);
+#else
+  int rv = posix_fadvise(fd, 0, bytes, POSIX_FADV_WILLNEED);
+#endif
+
+  Log::Debug("Prefetch %lld bytes in %lld ms rv=%d track=%s", bytes, timer.elapsed(), rv,
+             p_Track.toStdString().c_str());
+}
+
+void PrefetchWorker::Drop(const QString& p_Track)
+{
+#if !defined(__APPLE__)
+  QFile file(p_Track);
+  if (!file.open(QIODevice::ReadOnly)) return;
+
+  // Whole file, pages still mapped or in use elsewhere are left as is
+  const int rv = posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+  Log::Debug("Drop pages rv=%d track=%s", rv, p_Track.toStdString().c_str());
+#else
+  // No equivalent available, pages are left to the system to evict
+  Q_UNUSED(p_Track);
+#endif
+}
+
+Prefetcher::Prefetcher(qint64 p_Bytes, QObject* p_Parent)
+  : QObject(p_Parent)
+  , m_Bytes(p_Bytes)
+{
+  m_Worker = new PrefetchWorker();
+  m_Worker->moveToThread(&m_Thread);
+  connect(&m_Thread, &QThread::finished, m_Worker, &QObject::deleteLater);
+  m_Thread.start(QThread::LowPriority);
+}
+
+Prefetcher::~Prefetcher()
+{
+  m_Thread.quit();
+  m_Thread.wait();
+}
+
+void Prefetcher::SetNextTrack(const QString& p_Track)
+{
+  if (p_Track.isEmpty() || (p_Track == m_NextTrack)) return;
+
+  m_NextTrack = p_Track;
+  PrefetchWorker* worker = m_Worker;
+  const qint64 bytes = m_Bytes;
+  QMetaObject::invokeMethod(m_Worker, [worker, p_Track, bytes]()
+  {
+    worker->Prefetch(p_Track, bytes);
+  }, Qt::QueuedConnection);
+}
+
+void Prefetcher::TrackPlayed(const QString& p_Track)
+{
+  // Keep pages of a track about to be played again
+  if (p_Track.isEmpty() || (p_Track == m_NextTrack)) return;
+
+  PrefetchWorker* worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker, p_Track]()
+  {
+    worker->Drop(p_Track);
+  }, Qt::QueuedConnection);
+}
@@ -0,0 +1,45 @@
+// prefetcher.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+// Performs the blocking page cache calls, on the prefetcher thread.
+class PrefetchWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  void Prefetch(const QString& p_Track, qint64 p_Bytes);
+  void Drop(const QString& p_Track);
+};
+
+// Reads the start of the upcoming track into the page cache ahead of it
+// being opened, so that slow storage (network mounts, USB disks) does not
+// stall the start of playback. Pages of fully played tracks are released
+// again, to limit the page cache footprint of long sessions.
+class Prefetcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  Prefetcher(qint64 p_Bytes, QObject* p_Parent = nullptr);
+  ~Prefetcher();
+
+  void SetNextTrack(const QString& p_Track);
+  void TrackPlayed(const QString& p_Track);
+
+private:
+  QThread m_Thread;
+  PrefetchWorker* m_Worker = nullptr;
+  qint64 m_Bytes = 0;
+  QString m_NextTrack;
+};
@@ -0,0 +1,273 @@
+// realfft.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "realfft.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Radix-2 butterflies for one stage, p_Half >= 4 and a multiple of 4
+static void ButterflyStage(float* p_Re, float* p_Im, const float* p_Wr, const float* p_Wi,
+                           int p_Size, int p_Half)
+{
+  for (int i = 0; i < p_Size; i += 2 * p_Half)
+  {
+    float* ar = p_Re + i;
+    float* ai = p_Im + i;
+    float* br = ar + p_Half;
+    float* bi = ai + p_Half;
+    int j = 0;
+#if defined(__AVX__)
+    for (; j + 8 <= p_Half; j += 8)
+    {
+      const __m256 wr = _mm256_loadu_ps(p_Wr + j);
+      const __m256 wi = _mm256_loadu_ps(p_Wi + j);
+      const __m256 xr = _mm256_loadu_ps(br + j);
+      const __m256 xi = _mm256_loadu_ps(bi + j);
+      const __m256 vr = _mm256_sub_ps(_mm256_mul_ps(xr, wr), _mm256_mul_ps(xi, wi));
+      const __m256 vi = _mm256_add_ps(_mm256_mul_ps(xr, wi), _mm256_mul_ps(xi, wr));
+      const __m256 ur = _mm256_loadu_ps(ar + j);
+      const __m256 ui = _mm256_loadu_ps(ai + j);
+      _mm256_storeu_ps(ar + j, _mm256_add_ps(ur, vr));
+      _mm256_storeu_ps(ai + j, _mm256_add_ps(ui, vi));
+      _mm256_storeu_ps(br + j, _mm256_sub_ps(ur, vr));
+      _mm256_storeu_ps(bi + j, _mm256_sub_ps(ui, vi));
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+    for (; j + 4 <= p_Half; j += 4)
+    {
+      const __m128 wr = _mm_loadu_ps(p_Wr + j);
+      const __m128 wi = _mm_loadu_ps(p_Wi + j);
+      const __m128 xr = _mm_loadu_ps(br + j);
+      const __m128 xi = _mm_loadu_ps(bi + j);
+      const __m128 vr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+      const __m128 vi = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+      const __m128 ur = _mm_loadu_ps(ar + j);
+      const __m128 ui = _mm_loadu_ps(ai + j);
+      _mm_storeu_ps(ar + j, _mm_add_ps(ur, vr));
+      _mm_storeu_ps(ai + j, _mm_add_ps(ui, vi));
+      _mm_storeu_ps(br + j, _mm_sub_ps(ur, vr));
+      _mm_storeu_ps(bi + j, _mm_sub_ps(ui, vi));
+    }
+#elif defined(__ARM_NEON)
+    for (; j + 4 <= p_Half; j += 4)
+    {
+      const float32x4_t wr = vld1q_f32(p_Wr + j);
+      const float32x4_t wi = vld1q_f32(p_Wi + j);
+      const float32x4_t xr = vld1q_f32(br + j);
+      const float32x4_t xi = vld1q_f32(bi + j);
+      const float32x4_t vr = vmlsq_f32(vmulq_f32(xr, wr), xi, wi);
+      const float32x4_t vi = vmlaq_f32(vmulq_f32(xr, wi), xi, wr);
+      const float32x4_t ur = vld1q_f32(ar + j);
+      const float32x4_t ui = vld1q_f32(ai + j);
+      vst1q_f32(ar + j, vaddq_f32(ur, vr));
+      vst1q_f32(ai + j, vaddq_f32(ui, vi));
+      vst1q_f32(br + j, vsubq_f32(ur, vr));
+      vst1q_f32(bi + j, vsubq_f32(ui, vi));
+    }
+#endif
+    for (; j < p_Half; ++j)
+    {
+      const float vr = br[j] * p_Wr[j] - bi[j] * p_Wi[j];
+      const float vi = br[j] * p_Wi[j] + bi[j] * p_Wr[j];
+      const float ur = ar[j];
+      const float ui = ai[j];
+      ar[j] = ur + vr;
+      ai[j] = ui + vi;
+      br[j] = ur - vr;
+      bi[j] = ui - vi;
+    }
+  }
+}
+
+RealFFT::RealFFT(int p_Size)
+  : m_Size(p_Size)
+  , m_Half(p_Size / 2)
+  , m_BitReverse(m_Half)
+  , m_StageRe(m_Half)
+  , m_StageIm(m_Half)
+  , m_SplitRe(m_Half + 1)
+  , m_SplitIm(m_Half + 1)
+  , m_Re(m_Half)
+  , m_Im(m_Half)
+{
+  // Bit-reversal permutation of the N/2 point complex transform
+  int bits = 0;
+  while ((1 << bits) < m_Half)
+  {
+    ++bits;
+  }
+
+  for (int i = 0; i < m_Half; ++i)
+  {
+    int rev = 0;
+    for (int b = 0; b < bits; ++b)
+    {
+      rev |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    m_BitReverse[i] = rev;
+  }
+
+  // Twiddles per stage, stored contiguously: stage with half-length h uses
+  // entries [h - 1, 2h - 1), i.e. exp(-2 pi i j / 2h) for j in [0, h)
+  for (int half = 1; half < m_Half; half <<= 1)
+  {
+    for (int j = 0; j < half; ++j)
+    {
+      const double angle = -M_PI * j / half;
+      m_StageRe[half - 1 + j] = static_cast<float>(cos(angle));
+      m_StageIm[half - 1 + j] = static_cast<float>(sin(angle));
+    }
+  }
+
+  // Twiddles for splitting the packed transform into the real spectrum
+  for (int k = 0; k <= m_Half; ++k)
+  {
+    const double angle = -2.0 * M_PI * k / m_Size;
+    m_SplitRe[k] = static_cast<float>(cos(angle));
+    m_SplitIm[k] = static_cast<float>(sin(angle));
+  }
+}
+
+int RealFFT::Size() const
+{
+  return m_Size;
+}
+
+void RealFFT::SetWindow(const std::vector<float>& p_Window)
+{
+  m_Window = p_Window;
+  m_Window.resize(m_Size, 1.0f);
+}
+
+void RealFFT::Forward(const float* p_Input, float* p_Re, float* p_Im)
+{
+  Load(p_Input);
+  Transform();
+  Split([&](int p_Bin, float p_BinRe, float p_BinIm)
+  {
+    p_Re[p_Bin] = p_BinRe;
+    p_Im[p_Bin] = p_BinIm;
+  });
+}
+
+void RealFFT::Magnitudes(const float* p_Input, float* p_Magnitudes)
+{
+  Load(p_Input);
+  Transform();
+  Split([&](int p_Bin, float p_BinRe, float p_BinIm)
+  {
+    if (p_Bin < m_Half)
+    {
+      p_Magnitudes[p_Bin] = sqrtf((p_BinRe * p_BinRe) + (p_BinIm * p_BinIm));
+    }
+  });
+}
+
+void RealFFT::MagnitudesBatch(const float* p_Input, int p_Count, int p_Stride, float* p_Magnitudes)
+{
+  for (int w = 0; w < p_Count; ++w)
+  {
+    Magnitudes(p_Input + (w * p_Stride), p_Magnitudes + (w * m_Half));
+  }
+}
+
+void RealFFT::Load(const float* p_Input)
+{
+  // Pack even/odd samples as complex values, directly in bit-reversed order
+  if (m_Window.empty())
+  {
+    for (int n = 0; n < m_Half; ++n)
+    {
+      m_Re[m_BitReverse[n]] = p_Input[2 * n];
+      m_Im[m_BitReverse[n]] = p_Input[2 * n + 1];
+    }
+  }
+  else
+  {
+    for (int n = 0; n < m_Half; ++n)
+    {
+      m_Re[m_BitReverse[n]] = p_Input[2 * n] * m_Window[2 * n];
+      m_Im[m_BitReverse[n]] = p_Input[2 * n + 1] * m_Window[2 * n + 1];
+    }
+  }
+}
+
+void RealFFT::Transform()
+{
+  float* re = m_Re.data();
+  float* im = m_Im.data();
+
+  // First two stages have trivial twiddles (1 and -i)
+  if (m_Half >= 2)
+  {
+    for (int i = 0; i < m_Half; i += 2)
+    {
+      const float ur = re[i];
+      const float ui = im[i];
+      re[i] = ur + re[i + 1];
+      im[i] = ui + im[i + 1];
+      re[i + 1] = ur - re[i + 1];
+      im[i + 1] = ui - im[i + 1];
+    }
+  }
+
+  if (m_Half >= 4)
+  {
+    for (int i = 0; i < m_Half; i += 4)
+    {
+      float ur = re[i];
+      float ui = im[i];
+      float vr = re[i + 2];
+      float vi = im[i + 2];
+      re[i] = ur + vr;
+      im[i] = ui + vi;
+      re[i + 2] = ur - vr;
+      im[i + 2] = ui - vi;
+
+      ur = re[i + 1];
+      ui = im[i + 1];
+      vr = im[i + 3];
+      vi = -re[i + 3];
+      re[i + 1] = ur + vr;
+      im[i + 1] = ui + vi;
+      re[i + 3] = ur - vr;
+      im[i + 3] = ui - vi;
+    }
+  }
+
+  for (int half = 4; half < m_Half; half <<= 1)
+  {
+    ButterflyStage(re, im, m_StageRe.data() + half - 1, m_StageIm.data() + half - 1, m_Half, half);
+  }
+}
+
+template <typename T>
+void RealFFT::Split(T p_Output)
+{
+  for (int k = 0; k <= m_Half; ++k)
+  {
+    const int a = (k == m_Half) ? 0 : k;
+    const int b = (k == 0) ? 0 : (m_Half - k);
+    const float evenRe = 0.5f * (m_Re[a] + m_Re[b]);
+    const float evenIm = 0.5f * (m_Im[a] - m_Im[b]);
+    const float oddRe = 0.5f * (m_Im[a] + m_Im[b]);
+    const float oddIm = -0.5f * (m_Re[a] - m_Re[b]);
+    const float wr = m_SplitRe[k];
+    const float wi = m_SplitIm[k];
+    p_Output(k, evenRe + (wr * oddRe) - (wi * oddIm), evenIm + (wr * oddIm) + (wi * oddRe));
+  }
+}
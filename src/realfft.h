@@ -0,0 +1,52 @@
+// realfft.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <vector>
+
+// Real-input FFT of power-of-two size N, computed as an N/2 point complex FFT
+// (even samples packed as real part, odd samples as imaginary part) followed
+// by a split step. Bit-reversal and twiddle tables are precomputed, and the
+// butterflies use SSE/AVX/NEON where available.
+class RealFFT
+{
+public:
+  explicit RealFFT(int p_Size);
+
+  int Size() const;
+  void SetWindow(const std::vector<float>& p_Window);
+
+  // Spectrum of p_Input (Size() samples) as p_Re / p_Im, Size() / 2 + 1 bins
+  void Forward(const float* p_Input, float* p_Re, float* p_Im);
+
+  // Magnitudes of bins [0, Size() / 2) of p_Input
+  void Magnitudes(const float* p_Input, float* p_Magnitudes);
+
+  // Magnitudes of p_Count windows, each starting p_Stride samples after the
+  // previous one, written consecutively (Size() / 2 values per window)
+  void MagnitudesBatch(const float* p_Input, int p_Count, int p_Stride, float* p_Magnitudes);
+
+private:
+  void Load(const float* p_Input);
+  void Transform();
+  template <typename T>
+  void Split(T p_Output);
+
+private:
+  int m_Size = 0;
+  int m_Half = 0;
+  std::vector<int> m_BitReverse;
+  std::vector<float> m_StageRe;
+  std::vector<float> m_StageIm;
+  std::vector<float> m_SplitRe;
+  std::vector<float> m_SplitIm;
+  std::vector<float> m_Window;
+  std::vector<float> m_Re;
+  std::vector<float> m_Im;
+};
@@ -0,0 +1,285 @@
+// shuffleorder.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "shuffleorder.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <cstdlib>
+
+// Tracks ahead searched for one from another group when spreading
+static const int kSpreadWindow = 64;
+
+void ShuffleOrder::SetTracks(const QVector<QString>& p_Tracks)
+{
+  // Played part and relative order of tracks still present are kept
+  const int count = p_Tracks.size();
+  QHash<QString, int> indices;
+  indices.reserve(count);
+  for (int index = 0; index < count; ++index)
+  {
+    indices.insert(p_Tracks.at(index), index);
+  }
+
+  QVector<int> order;
+  order.reserve(count);
+  QVector<bool> placed(count, false);
+  int cursor = -1;
+  for (int pos = 0; pos < m_Order.size(); ++pos)
+  {
+    const int index = indices.value(m_Tracks.at(m_Order.at(pos)), -1);
+    if ((index < 0) || placed.at(index)) continue;
+
+    placed[index] = true;
+    order.push_back(index);
+    if (pos <= m_Cursor)
+    {
+      cursor = order.size() - 1;
+    }
+  }
+
+  m_Tracks = p_Tracks;
+  m_Order = order;
+  m_Cursor = cursor;
+  ++m_Cycle;
+  m_Positions.fill(-1, count);
+  for (int pos = 0; pos < m_Order.size(); ++pos)
+  {
+    m_Positions[m_Order.at(pos)] = pos;
+  }
+
+  // New tracks are inserted at random positions among the upcoming ones,
+  // one inside-out Fisher-Yates step each
+  bool added = false;
+  for (int index = 0; index < count; ++index)
+  {
+    if (placed.at(index)) continue;
+
+    m_Order.push_back(index);
+    const int pos = m_Order.size() - 1;
+    m_Positions[index] = pos;
+    const int first = m_Cursor + 1;
+    Swap(pos, first + (rand() % (pos - first + 1)));
+    added = true;
+  }
+
+  UpdateGroups();
+  if (added)
+  {
+    SpreadFrom(m_Cursor + 1);
+  }
+}
+
+void ShuffleOrder::SetSpread(Spread p_Spread)
+{
+  if (p_Spread == m_Spread) return;
+
+  m_Spread = p_Spread;
+  UpdateGroups();
+  SpreadFrom(m_Cursor + 1);
+}
+
+void ShuffleOrder::SetCurrent(int p_Index)
+{
+  if ((p_Index < 0) || (p_Index >= m_Positions.size()) || (p_Index == Current())) return;
+
+  const int pos = m_Positions.at(p_Index);
+  if (pos > m_Cursor)
+  {
+    // Upcoming track is moved up to play now
+    Swap(pos, m_Cursor + 1);
+    ++m_Cursor;
+  }
+  else
+  {
+    // Track played again moves to the cursor, the ones after it shift back
+    for (int i = pos; i < m_Cursor; ++i)
+    {
+      Swap(i, i + 1);
+    }
+  }
+}
+
+int ShuffleOrder::Current() const
+{
+  return (m_Cursor >= 0) ? m_Order.at(m_Cursor) : -1;
+}
+
+int ShuffleOrder::Next()
+{
+  PeekNext();
+  if ((m_Cursor + 1) < m_Order.size())
+  {
+    ++m_Cursor;
+  }
+
+  return Current();
+}
+
+int ShuffleOrder::PeekNext()
+{
+  if (m_Order.isEmpty()) return -1;
+
+  if ((m_Cursor + 1) >= m_Order.size())
+  {
+    NewCycle();
+  }
+
+  return ((m_Cursor + 1) < m_Order.size()) ? m_Order.at(m_Cursor + 1) : Current();
+}
+
+int ShuffleOrder::Previous()
+{
+  if (m_Cursor <= 0) return -1;
+
+  --m_Cursor;
+  return Current();
+}
+
+int ShuffleOrder::PeekPrevious() const
+{
+  return (m_Cursor > 0) ? m_Order.at(m_Cursor - 1) : -1;
+}
+
+bool ShuffleOrder::IsPlayed(int p_Index) const
+{
+  return (p_Index >= 0) && (p_Index < m_Positions.size()) && (m_Positions.at(p_Index) <= m_Cursor);
+}
+
+int ShuffleOrder::Cycle() const
+{
+  return m_Cycle;
+}
+
+void ShuffleOrder::Restore(const QStringList& p_Order, int p_Cursor)
+{
+  // Saved order becomes the track list, to be merged by SetTracks()
+  m_Tracks.clear();
+  m_Order.clear();
+  for (const QString& track : p_Order)
+  {
+    m_Order.push_back(m_Tracks.size());
+    m_Tracks.push_back(track);
+  }
+
+  m_Cursor = qBound(-1, p_Cursor, static_cast<int>(m_Order.size()) - 1);
+}
+
+void ShuffleOrder::Save(QStringList& p_Order, int& p_Cursor) const
+{
+  p_Order.clear();
+  for (const int index : m_Order)
+  {
+    p_Order.append(m_Tracks.at(index));
+  }
+
+  p_Cursor = m_Cursor;
+}
+
+bool ShuffleOrder::ParseSpread(const QString& p_Name, Spread& p_Spread)
+{
+  static const QStringList names = { "off", "album", "artist" };
+  const int index = names.indexOf(p_Name);
+  if (index < 0) return false;
+
+  p_Spread = static_cast<Spread>(index);
+  return true;
+}
+
+QString ShuffleOrder::SpreadName(Spread p_Spread)
+{
+  static const QStringList names = { "off", "album", "artist" };
+  return names.at(p_Spread);
+}
+
+void ShuffleOrder::NewCycle()
+{
+  // Current track starts the new cycle as already played, so that it is not
+  // repeated right away
+  const int current = Current();
+  ++m_Cycle;
+  ShuffleFrom(0);
+  if (current >= 0)
+  {
+    Swap(0, m_Positions.at(current));
+    m_Cursor = 0;
+  }
+  else
+  {
+    m_Cursor = -1;
+  }
+
+  SpreadFrom(m_Cursor + 1);
+}
+
+void ShuffleOrder::ShuffleFrom(int p_Start)
+{
+  for (int i = m_Order.size() - 1; i > p_Start; --i)
+  {
+    Swap(i, p_Start + (rand() % (i - p_Start + 1)));
+  }
+}
+
+void ShuffleOrder::SpreadFrom(int p_Start)
+{
+  if (m_Spread == SpreadOff) return;
+
+  // Greedy pass swapping in a track from another group wherever two of the
+  // same group would play in a row
+  const int count = m_Order.size();
+  for (int i = qMax(1, p_Start); i < count; ++i)
+  {
+    const int group = m_Groups.at(m_Order.at(i - 1));
+    if (m_Groups.at(m_Order.at(i)) != group) continue;
+
+    const int last = qMin(count - 1, i + kSpreadWindow);
+    for (int j = i + 1; j <= last; ++j)
+    {
+      if (m_Groups.at(m_Order.at(j)) != group)
+      {
+        Swap(i, j);
+        break;
+      }
+    }
+  }
+}
+
+void ShuffleOrder::Swap(int p_PosA, int p_PosB)
+{
+  if (p_PosA == p_PosB) return;
+
+  std::swap(m_Order[p_PosA], m_Order[p_PosB]);
+  m_Positions[m_Order.at(p_PosA)] = p_PosA;
+  m_Positions[m_Order.at(p_PosB)] = p_PosB;
+}
+
+void ShuffleOrder::UpdateGroups()
+{
+  // Album is the track directory, and artist the directory above it
+  QHash<QString, int> ids;
+  m_Groups.resize(m_Tracks.size());
+  for (int index = 0; index < m_Tracks.size(); ++index)
+  {
+    const QString& track = m_Tracks.at(index);
+    int end = track.lastIndexOf('/');
+    if ((m_Spread == SpreadArtist) && (end > 0))
+    {
+      end = track.lastIndexOf('/', end - 1);
+    }
+
+    const QString key = track.left(qMax(0, end));
+    auto it = ids.find(key);
+    if (it == ids.end())
+    {
+      it = ids.insert(key, ids.size());
+    }
+
+    m_Groups[index] = it.value();
+  }
+}
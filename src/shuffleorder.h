@@ -0,0 +1,61 @@
+// shuffleorder.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Shuffled play order as a precomputed permutation of playlist indices and
+// a cursor at the current track. Every track is played once per cycle, and
+// stepping forward or back is a constant time move of the cursor. Optionally
+// spreads tracks from the same album or artist (by directory) apart.
+class ShuffleOrder
+{
+public:
+  enum Spread
+  {
+    SpreadOff,
+    SpreadAlbum,
+    SpreadArtist,
+  };
+
+  void SetTracks(const QVector<QString>& p_Tracks);
+  void SetSpread(Spread p_Spread);
+  void SetCurrent(int p_Index);
+  int Current() const;
+  int Next();
+  int PeekNext();
+  int Previous();
+  int PeekPrevious() const;
+  bool IsPlayed(int p_Index) const;
+  int Cycle() const;
+
+  void Restore(const QStringList& p_Order, int p_Cursor);
+  void Save(QStringList& p_Order, int& p_Cursor) const;
+
+  static bool ParseSpread(const QString& p_Name, Spread& p_Spread);
+  static QString SpreadName(Spread p_Spread);
+
+private:
+  void NewCycle();
+  void ShuffleFrom(int p_Start);
+  void SpreadFrom(int p_Start);
+  void Swap(int p_PosA, int p_PosB);
+  void UpdateGroups();
+
+private:
+  QVector<QString> m_Tracks;
+  QVector<int> m_Order;
+  QVector<int> m_Positions;
+  QVector<int> m_Groups;
+  int m_Cursor = -1;
+  int m_Cycle = 0;
+  Spread m_Spread = SpreadOff;
+};
@@ -13,48 +13,118 @@
 #include <QDateTime>
 #include <QUrl>
 
+#include <algorithm>
+#include <cmath>
+
 #include "log.h"
+#include "mp3util.h"
 #include "spectrum.h"
 
-// Timer interval in ms - controls display update rate (~16 fps at 60ms)
-static const int kTimerIntervalMs = 60;
+// Default display update rate, and the allowed range for it. Display frames
+// interpolate between snapshots, so a higher rate costs no extra FFTs.
+static const int kDefaultFrameRate = 30;
+static const int kMinFrameRate = 5;
+static const int kMaxFrameRate = 60;
+
+// Frame interval that the attack/decay factors below are specified for
+static const float kReferenceFrameMs = 60.0f;
+
+// Snapshots further apart than this (e.g. around a seek) are not blended
+static const qint64 kMaxInterpolationGapMs = 250;
 
 // Spectrum snapshots per second of audio - controls how many FFTs are
 // computed per second of decoded audio. Lower values reduce CPU load.
 static const int kSpectrumFps = 16;
 
+// Buffer start times further than this from the end of the previous buffer
+// are a discontinuity in the analyzed audio
+static const qint64 kMaxBufferGapUs = 2000;
+
+// Snapshots buffered between worker and GUI thread (~16 sec of audio)
+static const int kRingCapacity = 256;
+
+// Snapshots kept around playback position (~64 sec of audio), and how much
+// of it is reserved for already played audio
+static const int kTimelineCapacity = 1024;
+static const qint64 kTimelineKeepBehindMs = 2000;
+
+// Worker retry interval when the ring is full
+static const int kRetryIntervalMs = 20;
+
+// Decoding starts this much before the playback position, and a seek within
+// this distance past the analyzed range does not restart decoding
+static const qint64 kStartMarginMs = 500;
+static const qint64 kSeekSlackMs = 1000;
+
+// Max gap between recorded snapshots (and at end of track) for an analysis
+// to be considered complete and stored in cache
+static const qint64 kRecordMaxGapMs = 1000;
+
 Spectrum::Spectrum(std::function<qint64()> p_PositionGetter, QObject* p_Parent)
   : QObject(p_Parent)
   , m_PositionGetter(p_PositionGetter)
-  , m_Window(kFFTSize)
-  , m_FFTBuffer(kFFTSize)
+  , m_Ring(kRingCapacity)
+  , m_Timeline(kTimelineCapacity, SpectrumSnapshot::kMinBandCount)
 {
-  // Precompute Hann window
-  for (int i = 0; i < kFFTSize; ++i)
-  {
-    m_Window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (kFFTSize - 1)));
-  }
+  m_Worker = new SpectrumWorker(m_Ring);
+  m_Worker->moveToThread(&m_Thread);
+  connect(&m_Thread, &QThread::finished, m_Worker, &QObject::deleteLater);
+  m_Thread.start();
 
   connect(&m_Timer, &QTimer::timeout, this, &Spectrum::OnTimer);
-  m_Timer.setInterval(kTimerIntervalMs);
+  m_Timer.setInterval(1000 / kDefaultFrameRate);
+}
 
-  connect(&m_Decoder, &QAudioDecoder::finished, this, &Spectrum::OnDecoderFinished);
+Spectrum::~Spectrum()
+{
+  m_Thread.quit();
+  m_Thread.wait();
 }
 
-void Spectrum::StartTrack(const QString& p_Track)
+void Spectrum::StartTrack(const QString& p_Track, qint64 p_PositionMs, qint64 p_DurationMs)
 {
+  m_Track = p_Track;
+  m_DurationMs = p_DurationMs;
   m_Decaying = false;
-  m_Decoder.stop();
-  m_SpectrumData.clear();
-  m_SpectrumIndex = 0;
+  ++m_Generation;
+  m_Ring.Clear();
+  m_Timeline.Clear();
   m_CurrentSpectrum.fill(0.0f);
 
-#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
-  m_Decoder.setSource(QUrl::fromLocalFile(p_Track));
-#else
-  m_Decoder.setSourceFilename(p_Track);
-#endif
-  m_Decoder.start();
+  SpectrumWorker* worker = m_Worker;
+  const int generation = m_Generation;
+  const QString cacheKey = SpectrumCache::Key(p_Track, m_BandCount);
+  if (m_Cache.Open(cacheKey, m_BandCount))
+  {
+    // Previously analyzed track, no decoding or analysis needed
+    Log::Debug("Spectrum cache hit %s, %d entries", cacheKey.toStdString().c_str(), m_Cache.Count());
+    QMetaObject::invokeMethod(m_Worker, [worker, generation]()
+    {
+      worker->Reset(generation);
+    }, Qt::QueuedConnection);
+  }
+  else
+  {
+    // Only an analysis from start of track can be stored in cache
+    const QString recordKey = (p_PositionMs <= kStartMarginMs) ? cacheKey : QString();
+    if (m_PlaybackTap)
+    {
+      // Snapshots are computed from playback buffers, no separate decode needed
+      QMetaObject::invokeMethod(m_Worker, [worker, generation, recordKey, p_DurationMs]()
+      {
+        worker->Reset(generation, recordKey, p_DurationMs);
+      }, Qt::QueuedConnection);
+    }
+    else
+    {
+      // Decode forward from (just before) the playback position
+      const qint64 startMs = qMax(0ll, p_PositionMs - kStartMarginMs);
+      QMetaObject::invokeMethod(m_Worker, [worker, p_Track, generation, startMs, p_DurationMs, recordKey]()
+      {
+        worker->Start(p_Track, generation, startMs, p_DurationMs, recordKey);
+      }, Qt::QueuedConnection);
+    }
+  }
 
   if (!m_Timer.isActive())
   {
@@ -62,11 +132,34 @@ void Spectrum::StartTrack(const QString& p_Track)
   }
 }
 
+void Spectrum::Seek(qint64 p_PositionMs, qint64 p_DurationMs)
+{
+  if (!m_Timer.isActive() || m_Decaying || m_Track.isEmpty() || m_Cache.IsOpen()) return;
+
+  if (m_PlaybackTap)
+  {
+    // Playback buffers follow the seek by themselves, only drop stale entries
+    m_Timeline.Clear();
+    return;
+  }
+
+  // Keep decoding if the new position is already (or about to be) analyzed
+  if (!m_Timeline.IsEmpty() && (p_PositionMs >= m_Timeline.TimeAt(0)) &&
+      (p_PositionMs <= (m_Timeline.TimeAt(m_Timeline.Count() - 1) + kSeekSlackMs)))
+  {
+    return;
+  }
+
+  StartTrack(m_Track, p_PositionMs, p_DurationMs);
+}
+
 void Spectrum::Stop()
 {
   m_Timer.stop();
-  m_Decoder.stop();
-  m_SpectrumData.clear();
+  m_FrameTimer.invalidate();
+  StopWorker();
+  m_Cache.Close();
+  m_Timeline.Clear();
   m_CurrentSpectrum.fill(0.0f);
 }
 
@@ -84,14 +177,111 @@ void Spectrum::StartDecay()
 {
   m_Decaying = true;
   m_Paused = false;
-  m_Decoder.stop();
-  m_SpectrumData.clear();
+  StopWorker();
+  m_Cache.Close();
+  m_Timeline.Clear();
   if (!m_Timer.isActive())
   {
     m_Timer.start();
   }
 }
 
+void Spectrum::SetPlaybackTap(bool p_Enabled)
+{
+  m_PlaybackTap = p_Enabled;
+}
+
+void Spectrum::SetBandCount(int p_BandCount)
+{
+  const int bandCount = qBound(SpectrumSnapshot::kMinBandCount, p_BandCount, SpectrumSnapshot::kMaxBandCount);
+  if (bandCount == m_BandCount) return;
+
+  m_BandCount = bandCount;
+  m_Timeline = SpectrumTimeline(kTimelineCapacity, m_BandCount);
+  m_Bands.assign(m_BandCount, 0.0f);
+  m_NextBands.assign(m_BandCount, 0.0f);
+  m_CurrentSpectrum = QVector<float>(m_BandCount, 0.0f);
+
+  SpectrumWorker* worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker, bandCount]()
+  {
+    worker->SetBandCount(bandCount);
+  }, Qt::QueuedConnection);
+
+  // Restart analysis (or cache lookup) of current track with new layout
+  if (m_Timer.isActive() && !m_Decaying && !m_Track.isEmpty())
+  {
+    StartTrack(m_Track, m_PositionGetter(), m_DurationMs);
+  }
+  else
+  {
+    emit SpectrumChanged(m_CurrentSpectrum);
+  }
+}
+
+void Spectrum::AddPlaybackBuffer(const QAudioBuffer& p_Buffer)
+{
+  if (!m_PlaybackTap || !m_Timer.isActive() || m_Decaying || m_Cache.IsOpen()) return;
+
+  SpectrumWorker* worker = m_Worker;
+  const int generation = m_Generation;
+  QMetaObject::invokeMethod(m_Worker, [worker, p_Buffer, generation]()
+  {
+    worker->AddBuffer(p_Buffer, generation);
+  }, Qt::QueuedConnection);
+}
+
+void Spectrum::SetFrameRate(int p_Fps)
+{
+  m_Timer.setInterval(1000 / qBound(kMinFrameRate, p_Fps, kMaxFrameRate));
+}
+
+void Spectrum::SetDuration(qint64 p_DurationMs)
+{
+  m_DurationMs = p_DurationMs;
+  SpectrumWorker* worker = m_Worker;
+  const int generation = m_Generation;
+  QMetaObject::invokeMethod(m_Worker, [worker, generation, p_DurationMs]()
+  {
+    worker->SetDuration(generation, p_DurationMs);
+  }, Qt::QueuedConnection);
+}
+
+void Spectrum::StopWorker()
+{
+  // Bump generation so snapshots still in flight are discarded
+  ++m_Generation;
+  QMetaObject::invokeMethod(m_Worker, "Stop", Qt::QueuedConnection);
+  m_Ring.Clear();
+}
+
+void Spectrum::ReadSnapshots(qint64 p_Position)
+{
+  SpectrumSnapshot snapshot;
+  while (m_Ring.Peek(snapshot))
+  {
+    if (snapshot.generation == m_Generation)
+    {
+      // Playback buffers restart from an earlier time after a backward seek
+      if (!m_Timeline.IsEmpty() && (snapshot.timeMs < m_Timeline.TimeAt(m_Timeline.Count() - 1)))
+      {
+        m_Timeline.Clear();
+      }
+
+      // Leave snapshots in the ring (throttling the worker) rather than
+      // evicting ones that have not been played yet
+      if (m_Timeline.IsFull() && (m_Timeline.TimeAt(0) >= (p_Position - kTimelineKeepBehindMs)))
+      {
+        break;
+      }
+
+      m_Timeline.Append(snapshot.timeMs, snapshot.bands);
+    }
+
+    m_Ring.Pop(snapshot);
+  }
+}
+
 void Spectrum::OnTimer()
 {
   static int timerCount = 0;
@@ -101,24 +291,40 @@ void Spectrum::OnTimer()
   if (lastLogTime == 0) lastLogTime = now;
   if (now - lastLogTime >= 2000)
   {
-    Log::Info("SpectrumTimer: %d calls in %lld ms (%.1f fps), spectrumData=%d entries",
+    Log::Info("SpectrumTimer: %d calls in %lld ms (%.1f fps), timeline=%d entries",
               timerCount, now - lastLogTime, timerCount * 1000.0 / (now - lastLogTime),
-              m_SpectrumData.size());
+              m_Timeline.Count());
     timerCount = 0;
     lastLogTime = now;
   }
 
-  // Process pending decoder buffers (one per tick to avoid blocking)
-  if (m_Decoder.bufferAvailable())
+  // Snapshots from the tap, the decoder and the cache all carry media
+  // timestamps, and are looked up at the audible position
+  const qint64 pos = m_PositionGetter();
+
+  // Collect snapshots computed by the worker thread
+  ReadSnapshots(pos);
+
+  // Smoothing factors are specified per reference frame, and scaled to the
+  // actual time since previous frame
+  float frameMs = kReferenceFrameMs;
+  if (m_FrameTimer.isValid())
   {
-    ProcessDecoderBuffer();
+    frameMs = qBound(1.0f, static_cast<float>(m_FrameTimer.restart()), 200.0f);
+  }
+  else
+  {
+    m_FrameTimer.start();
   }
 
+  const float frames = frameMs / kReferenceFrameMs;
+  const float attack = 1.0f - powf(1.0f - 0.89f, frames);  // Rise speed: 0=sluggish, 1=instant
+  const float decay = powf(0.94f, frames);                 // Fall-off: 1=hold forever, 0=instant drop
+
   if (m_Decaying)
   {
-    const float decay = 0.94f;
     bool allZero = true;
-    for (int i = 0; i < 8; ++i)
+    for (int i = 0; i < m_CurrentSpectrum.size(); ++i)
     {
       m_CurrentSpectrum[i] *= decay;
       if (m_CurrentSpectrum[i] > 0.005f)
@@ -137,183 +343,568 @@ void Spectrum::OnTimer()
     return;
   }
 
-  if (m_SpectrumData.isEmpty() || m_Paused) return;
+  if (m_Paused || !LookupBands(pos)) return;
+
+  const float* bands = m_Bands.data();
+  for (int i = 0; i < m_BandCount; ++i)
+  {
+    if (bands[i] > m_CurrentSpectrum[i])
+    {
+      // Rising: smooth toward new peak
+      m_CurrentSpectrum[i] += attack * (bands[i] - m_CurrentSpectrum[i]);
+    }
+    else
+    {
+      // Falling: gradual decay
+      m_CurrentSpectrum[i] *= decay;
+    }
+  }
 
-  // Compensate for audio output buffer latency
-  static const qint64 kLatencyOffsetMs = 175;
-  qint64 pos = m_PositionGetter() + kLatencyOffsetMs;
+  emit SpectrumChanged(m_CurrentSpectrum);
+}
 
-  // Advance index to match current position
-  while (m_SpectrumIndex < m_SpectrumData.size() - 1 &&
-         m_SpectrumData[m_SpectrumIndex + 1].first <= pos)
+bool Spectrum::LookupBands(qint64 p_Position)
+{
+  // Bands at given time, linearly interpolated between neighboring snapshots
+  int index = 0;
+  int count = 0;
+  qint64 time = 0;
+  qint64 nextTime = 0;
+  if (m_Cache.IsOpen())
   {
-    ++m_SpectrumIndex;
+    count = m_Cache.Count();
+    index = m_Cache.Find(p_Position);
+    time = m_Cache.TimeAt(index);
+    nextTime = (index + 1 < count) ? m_Cache.TimeAt(index + 1) : time;
+    m_Cache.BandsAt(index, m_Bands.data());
+    if (nextTime > time)
+    {
+      m_Cache.BandsAt(index + 1, m_NextBands.data());
+    }
+  }
+  else
+  {
+    if (m_Timeline.IsEmpty()) return false;
+
+    count = m_Timeline.Count();
+    index = m_Timeline.Find(p_Position);
+    time = m_Timeline.TimeAt(index);
+    nextTime = (index + 1 < count) ? m_Timeline.TimeAt(index + 1) : time;
+    const float* bands = m_Timeline.BandsAt(index);
+    std::copy(bands, bands + m_BandCount, m_Bands.begin());
+    if (nextTime > time)
+    {
+      const float* nextBands = m_Timeline.BandsAt(index + 1);
+      std::copy(nextBands, nextBands + m_BandCount, m_NextBands.begin());
+    }
   }
 
-  // Handle seek backward
-  if (m_SpectrumIndex > 0 && m_SpectrumData[m_SpectrumIndex].first > pos)
+  if ((nextTime > time) && (p_Position > time) && ((nextTime - time) <= kMaxInterpolationGapMs))
   {
-    m_SpectrumIndex = 0;
-    while (m_SpectrumIndex < m_SpectrumData.size() - 1 &&
-           m_SpectrumData[m_SpectrumIndex + 1].first <= pos)
+    const float t = qMin(1.0f, static_cast<float>(p_Position - time) / (nextTime - time));
+    for (int i = 0; i < m_BandCount; ++i)
     {
-      ++m_SpectrumIndex;
+      m_Bands[i] += t * (m_NextBands[i] - m_Bands[i]);
     }
   }
 
-  const QVector<float>& bands = m_SpectrumData[m_SpectrumIndex].second;
-  const float attack = 0.89f;  // Rise speed: 0=sluggish, 1=instant
-  const float decay = 0.94f;   // Fall-off: 1=hold forever, 0=instant drop
-  for (int i = 0; i < 8 && i < bands.size(); ++i)
+  return true;
+}
+
+SpectrumTimeline::SpectrumTimeline(int p_Capacity, int p_BandCount)
+  : m_Capacity(p_Capacity)
+  , m_BandCount(p_BandCount)
+  , m_Times(p_Capacity)
+  , m_Bands(p_Capacity * p_BandCount)
+{
+}
+
+void SpectrumTimeline::Clear()
+{
+  m_Start = 0;
+  m_Count = 0;
+}
+
+int SpectrumTimeline::Count() const
+{
+  return m_Count;
+}
+
+bool SpectrumTimeline::IsEmpty() const
+{
+  return (m_Count == 0);
+}
+
+bool SpectrumTimeline::IsFull() const
+{
+  return (m_Count == m_Capacity);
+}
+
+void SpectrumTimeline::Append(qint64 p_TimeMs, const float* p_Bands)
+{
+  if (m_Count == m_Capacity)
   {
-    if (bands[i] > m_CurrentSpectrum[i])
+    // Overwrite oldest
+    m_Start = (m_Start + 1) % m_Capacity;
+    --m_Count;
+  }
+
+  const int slot = Slot(m_Count);
+  m_Times[slot] = p_TimeMs;
+  std::copy(p_Bands, p_Bands + m_BandCount, m_Bands.begin() + (slot * m_BandCount));
+  ++m_Count;
+}
+
+int SpectrumTimeline::Find(qint64 p_TimeMs) const
+{
+  // Binary search for last entry at or before given time (first entry if none)
+  int lo = 0;
+  int hi = m_Count;
+  while (lo < hi)
+  {
+    const int mid = (lo + hi) / 2;
+    if (m_Times[Slot(mid)] <= p_TimeMs)
     {
-      // Rising: smooth toward new peak
-      m_CurrentSpectrum[i] += attack * (bands[i] - m_CurrentSpectrum[i]);
+      lo = mid + 1;
     }
     else
     {
-      // Falling: gradual decay
-      m_CurrentSpectrum[i] *= decay;
+      hi = mid;
     }
   }
 
-  emit SpectrumChanged(m_CurrentSpectrum);
+  return qMax(0, lo - 1);
 }
 
-void Spectrum::ProcessDecoderBuffer()
+qint64 SpectrumTimeline::TimeAt(int p_Index) const
 {
-  QAudioBuffer buffer = m_Decoder.read();
-  if (!buffer.isValid() || buffer.frameCount() < kFFTSize) return;
-
-  const QAudioFormat fmt = buffer.format();
-  const int channels = fmt.channelCount();
-  const int sampleRate = fmt.sampleRate();
-  const int frames = buffer.frameCount();
-  const qint64 startUs = buffer.startTime();
-  const float usPerFrame = 1000000.0f / sampleRate;
+  return m_Times[Slot(p_Index)];
+}
 
-  const int kStepSize = sampleRate / kSpectrumFps;
-  for (int offset = 0; offset + kFFTSize <= frames; offset += kStepSize)
-  {
-    qint64 timeMs = (startUs + static_cast<qint64>(offset * usPerFrame)) / 1000;
+const float* SpectrumTimeline::BandsAt(int p_Index) const
+{
+  return m_Bands.data() + (Slot(p_Index) * m_BandCount);
+}
 
-    QVector<float> spectrum(8);
+int SpectrumTimeline::Slot(int p_Index) const
+{
+  return (m_Start + p_Index) % m_Capacity;
+}
 
-    if (fmt.sampleFormat() == QAudioFormat::Int16)
+// Display correction (dB) at given frequency, interpolated over log frequency
+// between the centers of the classic eight bands
+static float BandCorrectionDb(float p_FreqHz)
+{
+  static const int kPointCount = 8;
+  static const float bandEdges[kPointCount + 1] = {
+    20, 150, 400, 800, 1500, 3000, 6000, 12000, 20000
+  };
+
+  // Attenuate energy-dense mid-range
+  //   sub-bass  bass  lo-mid  mid  up-mid  presence  brilliance  air
+  static const float bandCorrectionDb[kPointCount] = {
+    0.0f, 0.0f, -3.0f, -5.0f, -4.0f, -2.0f, 0.0f, 0.0f
+  };
+
+  const float octave = log2f(p_FreqHz);
+  float prevOctave = 0.5f * log2f(bandEdges[0] * bandEdges[1]);
+  if (octave <= prevOctave) return bandCorrectionDb[0];
+
+  for (int i = 1; i < kPointCount; ++i)
+  {
+    const float nextOctave = 0.5f * log2f(bandEdges[i] * bandEdges[i + 1]);
+    if (octave <= nextOctave)
     {
-      const qint16* data = buffer.constData<qint16>() + offset * channels;
-      for (int i = 0; i < kFFTSize; ++i)
-      {
-        float sample = 0;
-        for (int ch = 0; ch < channels; ++ch)
-        {
-          sample += data[i * channels + ch] / 32768.0f;
-        }
-        m_FFTBuffer[i] = std::complex<float>(sample / channels * m_Window[i], 0.0f);
-      }
+      const float t = (octave - prevOctave) / (nextOctave - prevOctave);
+      return bandCorrectionDb[i - 1] + (t * (bandCorrectionDb[i] - bandCorrectionDb[i - 1]));
     }
-    else if (fmt.sampleFormat() == QAudioFormat::Float)
+
+    prevOctave = nextOctave;
+  }
+
+  return bandCorrectionDb[kPointCount - 1];
+}
+
+// FFT window size in frames. Larger for more bands, so that the narrow
+// log-spaced low bands still map to distinct bins (at 44.1 kHz bins are
+// ~86 Hz wide at 512 points and ~11 Hz at 4096).
+static int FFTSize(int p_BandCount)
+{
+  if (p_BandCount >= 32) return 4096;
+  if (p_BandCount >= 16) return 2048;
+  return 512;
+}
+
+static std::vector<float> HannWindow(int p_Size)
+{
+  std::vector<float> window(p_Size);
+  for (int i = 0; i < p_Size; ++i)
+  {
+    window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (p_Size - 1)));
+  }
+
+  return window;
+}
+
+SpectrumWorker::SpectrumWorker(SpscRing<SpectrumSnapshot>& p_Ring)
+  : m_Ring(p_Ring)
+  , m_FFT(FFTSize(SpectrumSnapshot::kMinBandCount))
+{
+  m_FFT.SetWindow(HannWindow(m_FFT.Size()));
+
+  m_RetryTimer = new QTimer(this);
+  m_RetryTimer->setSingleShot(true);
+  m_RetryTimer->setInterval(kRetryIntervalMs);
+  connect(m_RetryTimer, &QTimer::timeout, this, &SpectrumWorker::ProcessPending);
+}
+
+void SpectrumWorker::Start(const QString& p_Track, int p_Generation, qint64 p_StartMs, qint64 p_DurationMs,
+                           const QString& p_CacheKey)
+{
+  // Decoder is created on first use so that it lives in the worker thread
+  if (m_Decoder == nullptr)
+  {
+    m_Decoder = new QAudioDecoder(this);
+    connect(m_Decoder, &QAudioDecoder::bufferReady, this, &SpectrumWorker::OnBufferReady);
+    connect(m_Decoder, &QAudioDecoder::finished, this, &SpectrumWorker::OnDecoderFinished);
+  }
+
+  Reset(p_Generation, p_CacheKey, p_DurationMs);
+
+  // QAudioDecoder cannot seek, so for mp3 decoding starts from a frame near
+  // the requested position, and for other formats buffers before it are
+  // skipped without analysis.
+  const qint64 offset = Mp3Util::EstimateOffset(p_Track, p_StartMs, p_DurationMs);
+  if (offset > 0)
+  {
+    m_Device = new FileRangeDevice(p_Track, offset, this);
+    if (m_Device->open(QIODevice::ReadOnly))
     {
-      const float* data = buffer.constData<float>() + offset * channels;
-      for (int i = 0; i < kFFTSize; ++i)
-      {
-        float sample = 0;
-        for (int ch = 0; ch < channels; ++ch)
-        {
-          sample += data[i * channels + ch];
-        }
-        m_FFTBuffer[i] = std::complex<float>(sample / channels * m_Window[i], 0.0f);
-      }
+      m_TimeOffsetMs = p_StartMs;
+      m_Decoder->setSourceDevice(m_Device);
     }
     else
     {
-      return;
+      delete m_Device;
+      m_Device = nullptr;
     }
+  }
 
-    FFT(m_FFTBuffer);
+  if (m_Device == nullptr)
+  {
+    m_SkipUntilMs = p_StartMs;
+#if QT_VERSION > QT_VERSION_CHECK(6, 0, 0)
+    m_Decoder->setSource(QUrl::fromLocalFile(p_Track));
+#else
+    m_Decoder->setSourceFilename(p_Track);
+#endif
+  }
 
-    static const int kBandCount = 8;
-    static const float bandEdges[kBandCount + 1] = {
-      20, 150, 400, 800, 1500, 3000, 6000, 12000, 20000
-    };
-    const float binHz = static_cast<float>(sampleRate) / kFFTSize;
-    const int maxBin = kFFTSize / 2;
+  m_Decoder->start();
+}
 
-    static const float kTiltDbPerOctave = 4.0f;
-    static const float kRefFreqHz = 1000.0f;
-    static const float kNoiseFloorDb = -60.0f;
-    static const float kDynamicRangeDb = 75.0f;
+void SpectrumWorker::Reset(int p_Generation, const QString& p_CacheKey, qint64 p_DurationMs)
+{
+  Stop();
+  m_Generation = p_Generation;
+  m_SnapshotCount = 0;
+  m_TimeOffsetMs = 0;
+  m_SkipUntilMs = 0;
+  m_DecoderFinished = false;
+  m_CacheKey = p_CacheKey;
+  m_DurationMs = p_DurationMs;
+  m_Recording = !p_CacheKey.isEmpty();
+  m_MonoSampleRate = 0;
+}
 
-    // Per-band display correction (dB) — attenuate energy-dense mid-range
-    //   sub-bass  bass  lo-mid  mid  up-mid  presence  brilliance  air
-    static const float bandCorrectionDb[kBandCount] = {
-      0.0f, 0.0f, -3.0f, -5.0f, -4.0f, -2.0f, 0.0f, 0.0f
-    };
+void SpectrumWorker::SetBandCount(int p_BandCount)
+{
+  m_BandCount = p_BandCount;
+  m_BandSampleRate = 0;
 
-    for (int b = 0; b < kBandCount; ++b)
-    {
-      int binLo = qBound(0, static_cast<int>(bandEdges[b] / binHz), maxBin - 1);
-      int binHi = qBound(binLo + 1, static_cast<int>(bandEdges[b + 1] / binHz), maxBin);
+  const int fftSize = FFTSize(m_BandCount);
+  if (fftSize != m_FFT.Size())
+  {
+    m_FFT = RealFFT(fftSize);
+    m_FFT.SetWindow(HannWindow(fftSize));
+    m_MonoSampleRate = 0;
+  }
+}
 
-      float magnitude = 0;
-      for (int i = binLo; i < binHi; ++i)
-      {
-        magnitude += std::abs(m_FFTBuffer[i]);
-      }
-      magnitude /= (binHi - binLo);
+void SpectrumWorker::SetDuration(int p_Generation, qint64 p_DurationMs)
+{
+  if (p_Generation != m_Generation) return;
 
-      float centerFreq = sqrtf(bandEdges[b] * bandEdges[b + 1]);
-      float db = 20.0f * log10f(qMax(magnitude, 1e-6f));
-      float tiltDb = kTiltDbPerOctave * log2f(centerFreq / kRefFreqHz);
-      spectrum[b] = qBound(0.0f, (db + tiltDb + bandCorrectionDb[b] - kNoiseFloorDb) / kDynamicRangeDb, 1.0f);
-    }
+  m_DurationMs = p_DurationMs;
+}
 
-    m_SpectrumData.append(qMakePair(timeMs, spectrum));
+void SpectrumWorker::AddBuffer(const QAudioBuffer& p_Buffer, int p_Generation)
+{
+  if (p_Generation != m_Generation) return;
+
+  ProcessBuffer(p_Buffer);
+  ProcessPending();
+}
+
+void SpectrumWorker::Stop()
+{
+  // Analysis from playback buffers may have covered the whole track
+  FinishRecording(false);
+
+  if (m_Decoder != nullptr)
+  {
+    m_Decoder->stop();
+  }
+
+  if (m_Device != nullptr)
+  {
+    m_Decoder->setSourceDevice(nullptr);
+    delete m_Device;
+    m_Device = nullptr;
   }
+
+  m_RetryTimer->stop();
+  m_Pending.clear();
 }
 
-void Spectrum::OnDecoderFinished()
+void SpectrumWorker::OnBufferReady()
 {
-  Log::Debug("Decoder finished, %d spectrum entries", m_SpectrumData.size());
+  ProcessPending();
 }
 
-void Spectrum::FFT(std::vector<std::complex<float>>& p_Data)
+void SpectrumWorker::OnDecoderFinished()
 {
-  const size_t n = p_Data.size();
-  if (n <= 1) return;
+  Log::Debug("Decoder finished, %d spectrum entries", m_SnapshotCount);
+  m_DecoderFinished = true;
+  ProcessPending();
+}
 
-  // Bit-reversal permutation
-  for (size_t i = 1, j = 0; i < n; ++i)
+void SpectrumWorker::ProcessPending()
+{
+  // Hand over snapshots until the ring is full, leaving remaining decoder
+  // buffers queued (which in turn throttles the decoder) until GUI catches up.
+  while (true)
   {
-    size_t bit = n >> 1;
-    for (; j & bit; bit >>= 1)
+    while (!m_Pending.empty() && m_Ring.Push(m_Pending.front()))
     {
-      j ^= bit;
+      m_Pending.pop_front();
     }
-    j ^= bit;
-    if (i < j)
+
+    if (!m_Pending.empty())
+    {
+      m_RetryTimer->start();
+      return;
+    }
+
+    if ((m_Decoder == nullptr) || !m_Decoder->bufferAvailable())
     {
-      std::swap(p_Data[i], p_Data[j]);
+      if (m_DecoderFinished)
+      {
+        FinishRecording(true);
+      }
+
+      return;
     }
+
+    const QAudioBuffer buffer = m_Decoder->read();
+    if ((m_TimeOffsetMs + ((buffer.startTime() + buffer.duration()) / 1000)) < m_SkipUntilMs) continue;
+
+    ProcessBuffer(buffer);
+  }
+}
+
+void SpectrumWorker::ProcessBuffer(const QAudioBuffer& p_Buffer)
+{
+  if (!p_Buffer.isValid() || (p_Buffer.frameCount() <= 0)) return;
+
+  const QAudioFormat fmt = p_Buffer.format();
+  const int channels = fmt.channelCount();
+  const int sampleRate = fmt.sampleRate();
+  const int frames = p_Buffer.frameCount();
+  const qint64 startUs = p_Buffer.startTime();
+  if ((channels <= 0) || (sampleRate <= 0)) return;
+  if ((fmt.sampleFormat() != QAudioFormat::Int16) && (fmt.sampleFormat() != QAudioFormat::Float)) return;
+
+  // Windows may span buffers, so downmixed audio is kept from the start of
+  // the next window on. A gap or overlap in time (e.g. skipped audio or a
+  // seek in playback buffers) or a rate change starts over.
+  const qint64 expectedUs =
+    m_MonoStartUs + (((m_MonoFrames + static_cast<qint64>(m_Mono.size())) * 1000000) / sampleRate);
+  if ((sampleRate != m_MonoSampleRate) || (qAbs(startUs - expectedUs) > kMaxBufferGapUs))
+  {
+    m_Mono.clear();
+    m_MonoPos = 0;
+    m_MonoFrames = 0;
+    m_MonoStartUs = startUs;
+    m_MonoSampleRate = sampleRate;
   }
 
-  // Butterfly stages
-  for (size_t len = 2; len <= n; len <<= 1)
+  // Downmix to mono
+  const size_t monoOffset = m_Mono.size();
+  m_Mono.resize(monoOffset + frames);
+  float* mono = m_Mono.data() + monoOffset;
+  if (fmt.sampleFormat() == QAudioFormat::Int16)
   {
-    float angle = -2.0f * M_PI / len;
-    std::complex<float> wlen(cosf(angle), sinf(angle));
-    for (size_t i = 0; i < n; i += len)
+    const qint16* data = p_Buffer.constData<qint16>();
+    for (int i = 0; i < frames; ++i)
     {
-      std::complex<float> w(1.0f, 0.0f);
-      for (size_t j = 0; j < len / 2; ++j)
+      float sample = 0;
+      for (int ch = 0; ch < channels; ++ch)
       {
-        std::complex<float> u = p_Data[i + j];
-        std::complex<float> v = p_Data[i + j + len / 2] * w;
-        p_Data[i + j] = u + v;
-        p_Data[i + j + len / 2] = u - v;
-        w *= wlen;
+        sample += data[i * channels + ch] / 32768.0f;
       }
+      mono[i] = sample / channels;
     }
   }
+  else
+  {
+    const float* data = p_Buffer.constData<float>();
+    for (int i = 0; i < frames; ++i)
+    {
+      float sample = 0;
+      for (int ch = 0; ch < channels; ++ch)
+      {
+        sample += data[i * channels + ch];
+      }
+      mono[i] = sample / channels;
+    }
+  }
+
+  const int fftSize = m_FFT.Size();
+  const int kStepSize = sampleRate / kSpectrumFps;
+  const int available = static_cast<int>(m_Mono.size()) - m_MonoPos;
+  const int windowCount = (available >= fftSize) ? (((available - fftSize) / kStepSize) + 1) : 0;
+  if (windowCount == 0) return;
+
+  // Transform all windows in one batch
+  const int maxBin = fftSize / 2;
+  m_Magnitudes.resize(windowCount * maxBin);
+  m_FFT.MagnitudesBatch(m_Mono.data() + m_MonoPos, windowCount, kStepSize, m_Magnitudes.data());
+
+  UpdateBandLayout(sampleRate);
+
+  static const float kDynamicRangeDb = 75.0f;
+  const int* bandBins = m_BandBins.data();
+  const float* bandScale = m_BandScale.data();
+  const float* bandOffsetDb = m_BandOffsetDb.data();
+  m_MagnitudeSums.resize(maxBin + 1);
+  double* sums = m_MagnitudeSums.data();
+
+  for (int w = 0; w < windowCount; ++w)
+  {
+    // Snapshot is timed at the window center
+    const qint64 frame = m_MonoFrames + m_MonoPos + (w * kStepSize) + (fftSize / 2);
+    const float* magnitudes = m_Magnitudes.data() + (w * maxBin);
+
+    SpectrumSnapshot snapshot;
+    snapshot.timeMs = m_TimeOffsetMs + ((m_MonoStartUs + ((frame * 1000000) / sampleRate)) / 1000);
+    snapshot.generation = m_Generation;
+
+    // Prefix sums make each band sum a difference of two gathered entries,
+    // so cost does not grow with the number of bands
+    sums[0] = 0.0;
+    for (int i = 0; i < maxBin; ++i)
+    {
+      sums[i + 1] = sums[i] + magnitudes[i];
+    }
+
+    for (int b = 0; b < m_BandCount; ++b)
+    {
+      const float magnitude = static_cast<float>(sums[bandBins[b + 1]] - sums[bandBins[b]]) * bandScale[b];
+      const float db = 20.0f * log10f(qMax(magnitude, 1e-6f));
+      snapshot.bands[b] = qBound(0.0f, (db + bandOffsetDb[b]) / kDynamicRangeDb, 1.0f);
+    }
+
+    m_Pending.push_back(snapshot);
+    ++m_SnapshotCount;
+
+    if (m_Recording)
+    {
+      Record(snapshot);
+    }
+  }
+
+  // Audio before the next window is no longer needed (the next window may
+  // also start beyond what has been received, if windows do not overlap)
+  m_MonoPos += windowCount * kStepSize;
+  const int erased = qMin(m_MonoPos, static_cast<int>(m_Mono.size()));
+  m_Mono.erase(m_Mono.begin(), m_Mono.begin() + erased);
+  m_MonoPos -= erased;
+  m_MonoFrames += erased;
+}
+
+void SpectrumWorker::UpdateBandLayout(int p_SampleRate)
+{
+  if ((p_SampleRate == m_BandSampleRate) && (static_cast<int>(m_BandScale.size()) == m_BandCount)) return;
+
+  m_BandSampleRate = p_SampleRate;
+  const int maxBin = m_FFT.Size() / 2;
+  const float binHz = static_cast<float>(p_SampleRate) / m_FFT.Size();
+  const float loHz = 20.0f;
+  const float hiHz = qMin(20000.0f, p_SampleRate / 2.0f);
+
+  // Log-spaced band edges, mapped to bins so that each band has at least one
+  std::vector<float> edgesHz(m_BandCount + 1);
+  m_BandBins.resize(m_BandCount + 1);
+  for (int b = 0; b <= m_BandCount; ++b)
+  {
+    edgesHz[b] = loHz * powf(hiHz / loHz, static_cast<float>(b) / m_BandCount);
+    const int bin = static_cast<int>(edgesHz[b] / binHz);
+    m_BandBins[b] = (b == 0) ? bin : qMax(bin, m_BandBins[b - 1] + 1);
+  }
+
+  for (int b = m_BandCount; b >= 0; --b)
+  {
+    m_BandBins[b] = qMin(m_BandBins[b], maxBin - (m_BandCount - b));
+  }
+
+  static const float kTiltDbPerOctave = 4.0f;
+  static const float kRefFreqHz = 1000.0f;
+  static const float kNoiseFloorDb = -60.0f;
+
+  m_BandScale.resize(m_BandCount);
+  m_BandOffsetDb.resize(m_BandCount);
+  for (int b = 0; b < m_BandCount; ++b)
+  {
+    // Center of the bins actually covered, as low bands are widened to one bin
+    const float centerFreq = binHz * sqrtf(qMax(0.5f, static_cast<float>(m_BandBins[b])) * m_BandBins[b + 1]);
+    const float tiltDb = kTiltDbPerOctave * log2f(centerFreq / kRefFreqHz);
+    m_BandScale[b] = 1.0f / (m_BandBins[b + 1] - m_BandBins[b]);
+    m_BandOffsetDb[b] = tiltDb + BandCorrectionDb(centerFreq) - kNoiseFloorDb;
+  }
+}
+
+void SpectrumWorker::Record(const SpectrumSnapshot& p_Snapshot)
+{
+  // Abandon recording on discontinuity (e.g. seek in playback buffers)
+  const qint64 lastMs = m_RecordTimes.empty() ? 0 : m_RecordTimes.back();
+  if ((p_Snapshot.timeMs < lastMs) || ((p_Snapshot.timeMs - lastMs) > kRecordMaxGapMs))
+  {
+    m_Recording = false;
+    m_RecordTimes.clear();
+    m_RecordBands.clear();
+    return;
+  }
+
+  m_RecordTimes.push_back(static_cast<quint32>(p_Snapshot.timeMs));
+  for (int i = 0; i < m_BandCount; ++i)
+  {
+    m_RecordBands.push_back(static_cast<quint8>(lroundf(p_Snapshot.bands[i] * 255.0f)));
+  }
+}
+
+void SpectrumWorker::FinishRecording(bool p_Finished)
+{
+  if (!m_Recording) return;
+
+  m_Recording = false;
+  const bool isComplete = !m_RecordTimes.empty() &&
+    (p_Finished || ((m_DurationMs > 0) && ((m_RecordTimes.back() + kRecordMaxGapMs) >= m_DurationMs)));
+  if (isComplete && SpectrumCache::Write(m_CacheKey, m_BandCount, m_RecordTimes, m_RecordBands))
+  {
+    SpectrumCache::Evict();
+  }
+
+  m_RecordTimes.clear();
+  m_RecordBands.clear();
 }
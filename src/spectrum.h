@@ -8,50 +8,173 @@
 
 #pragma once
 
+#include <QAudioBuffer>
 #include <QAudioDecoder>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QThread>
 #include <QTimer>
 #include <QVector>
 
-#include <complex>
+#include <deque>
 #include <functional>
 #include <vector>
 
+#include "filerangedevice.h"
+#include "realfft.h"
+#include "spectrumcache.h"
+#include "spscring.h"
+
+struct SpectrumSnapshot
+{
+  static const int kMinBandCount = 8;
+  static const int kMaxBandCount = 64;
+
+  qint64 timeMs = 0;
+  int generation = 0;
+  float bands[kMaxBandCount] = { 0 };
+};
+
+// Fixed-capacity ring of spectrum snapshots covering a window around the
+// playback position, stored as flat arrays of timestamps and bands.
+class SpectrumTimeline
+{
+public:
+  SpectrumTimeline(int p_Capacity, int p_BandCount);
+
+  void Clear();
+  int Count() const;
+  bool IsEmpty() const;
+  bool IsFull() const;
+  void Append(qint64 p_TimeMs, const float* p_Bands);
+  int Find(qint64 p_TimeMs) const;
+  qint64 TimeAt(int p_Index) const;
+  const float* BandsAt(int p_Index) const;
+
+private:
+  int Slot(int p_Index) const;
+
+private:
+  int m_Capacity = 0;
+  int m_BandCount = 0;
+  int m_Start = 0;
+  int m_Count = 0;
+  std::vector<qint64> m_Times;
+  std::vector<float> m_Bands;
+};
+
+// Decodes the track and computes spectrum snapshots on a dedicated thread,
+// handing them to the GUI thread through a lock-free ring.
+class SpectrumWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  SpectrumWorker(SpscRing<SpectrumSnapshot>& p_Ring);
+
+public slots:
+  void Start(const QString& p_Track, int p_Generation, qint64 p_StartMs, qint64 p_DurationMs,
+             const QString& p_CacheKey);
+  void Reset(int p_Generation, const QString& p_CacheKey = QString(), qint64 p_DurationMs = 0);
+  void AddBuffer(const QAudioBuffer& p_Buffer, int p_Generation);
+  void Stop();
+
+public:
+  void SetDuration(int p_Generation, qint64 p_DurationMs);
+  void SetBandCount(int p_BandCount);
+
+private slots:
+  void OnBufferReady();
+  void OnDecoderFinished();
+
+private:
+  void ProcessPending();
+  void ProcessBuffer(const QAudioBuffer& p_Buffer);
+  void UpdateBandLayout(int p_SampleRate);
+  void Record(const SpectrumSnapshot& p_Snapshot);
+  void FinishRecording(bool p_Finished);
+
+private:
+  SpscRing<SpectrumSnapshot>& m_Ring;
+  QAudioDecoder* m_Decoder = nullptr;
+  FileRangeDevice* m_Device = nullptr;
+  QTimer* m_RetryTimer = nullptr;
+  std::deque<SpectrumSnapshot> m_Pending;
+  int m_Generation = 0;
+  int m_SnapshotCount = 0;
+  qint64 m_TimeOffsetMs = 0;
+  qint64 m_SkipUntilMs = 0;
+  QString m_CacheKey;
+  qint64 m_DurationMs = 0;
+  bool m_Recording = false;
+  bool m_DecoderFinished = false;
+  std::vector<quint32> m_RecordTimes;
+  std::vector<quint8> m_RecordBands;
+  RealFFT m_FFT;
+  std::vector<float> m_Mono;
+  int m_MonoPos = 0;
+  qint64 m_MonoFrames = 0;
+  qint64 m_MonoStartUs = 0;
+  int m_MonoSampleRate = 0;
+  std::vector<float> m_Magnitudes;
+  std::vector<double> m_MagnitudeSums;
+  int m_BandCount = SpectrumSnapshot::kMinBandCount;
+  int m_BandSampleRate = 0;
+  std::vector<int> m_BandBins;
+  std::vector<float> m_BandScale;
+  std::vector<float> m_BandOffsetDb;
+};
+
 class Spectrum : public QObject
 {
   Q_OBJECT
 
 public:
   Spectrum(std::function<qint64()> p_PositionGetter, QObject* p_Parent = nullptr);
+  ~Spectrum();
 
-  void StartTrack(const QString& p_Track);
+  void StartTrack(const QString& p_Track, qint64 p_PositionMs = 0, qint64 p_DurationMs = 0);
+  void Seek(qint64 p_PositionMs, qint64 p_DurationMs);
   void Stop();
   bool IsRunning() const;
   void SetPaused(bool p_Paused);
   void StartDecay();
+  void SetPlaybackTap(bool p_Enabled);
+  void SetBandCount(int p_BandCount);
+  void SetFrameRate(int p_Fps);
+
+public slots:
+  void AddPlaybackBuffer(const QAudioBuffer& p_Buffer);
+  void SetDuration(qint64 p_DurationMs);
 
 signals:
   void SpectrumChanged(const QVector<float>& p_Spectrum);
 
 private slots:
   void OnTimer();
-  void OnDecoderFinished();
 
 private:
-  void ProcessDecoderBuffer();
-  static void FFT(std::vector<std::complex<float>>& p_Data);
-
-  static const int kFFTSize = 512;
+  void StopWorker();
+  void ReadSnapshots(qint64 p_Position);
+  bool LookupBands(qint64 p_Position);
 
 private:
   bool m_Paused = false;
   bool m_Decaying = false;
+  bool m_PlaybackTap = false;
   std::function<qint64()> m_PositionGetter;
-  QAudioDecoder m_Decoder;
+  QString m_Track;
+  qint64 m_DurationMs = 0;
+  int m_BandCount = SpectrumSnapshot::kMinBandCount;
+  QThread m_Thread;
+  SpectrumWorker* m_Worker = nullptr;
+  SpscRing<SpectrumSnapshot> m_Ring;
+  int m_Generation = 0;
   QTimer m_Timer;
-  QVector<QPair<qint64, QVector<float>>> m_SpectrumData;
-  QVector<float> m_CurrentSpectrum = QVector<float>(8, 0.0f);
-  int m_SpectrumIndex = 0;
-  std::vector<float> m_Window;
-  std::vector<std::complex<float>> m_FFTBuffer;
+  QElapsedTimer m_FrameTimer;
+  SpectrumTimeline m_Timeline;
+  SpectrumCache m_Cache;
+  std::vector<float> m_Bands = std::vector<float>(SpectrumSnapshot::kMinBandCount, 0.0f);
+  std::vector<float> m_NextBands = std::vector<float>(SpectrumSnapshot::kMinBandCount, 0.0f);
+  QVector<float> m_CurrentSpectrum = QVector<float>(SpectrumSnapshot::kMinBandCount, 0.0f);
 };
@@ -0,0 +1,202 @@
+// spectrumcache.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "spectrumcache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#include "log.h"
+
+// File layout (native endian, cache is local only):
+//   header, times[count] (ms), bands[count * bandCount] (0-255)
+struct SpectrumCacheHeader
+{
+  quint32 magic;
+  quint16 version;
+  quint16 bandCount;
+  quint32 count;
+  quint32 reserved;
+};
+
+static const quint32 kMagic = 0x4353504e; // "NPSC"
+static const quint16 kVersion = 2;
+
+// Max total size of cache files, least recently used are evicted beyond it
+static const qint64 kMaxCacheBytes = 64 * 1024 * 1024;
+
+SpectrumCache::SpectrumCache()
+{
+}
+
+SpectrumCache::~SpectrumCache()
+{
+  Close();
+}
+
+QString SpectrumCache::Key(const QString& p_Track, int p_BandCount)
+{
+  // File metadata only, so that a track change need not read the track
+  const QFileInfo fileInfo(p_Track);
+  if (!fileInfo.exists()) return QString();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(kVersion) + ":" + QByteArray::number(p_BandCount) + ":" + p_Track.toUtf8() + ":" +
+               QByteArray::number(fileInfo.size()) + ":" +
+               QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+  return QString::fromLatin1(hash.result().toHex());
+}
+
+bool SpectrumCache::Write(const QString& p_Key, int p_BandCount, const std::vector<quint32>& p_Times,
+                          const std::vector<quint8>& p_Bands)
+{
+  const QString dir = Dir();
+  if (p_Key.isEmpty() || dir.isEmpty() || !QDir().mkpath(dir)) return false;
+
+  SpectrumCacheHeader header;
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.bandCount = static_cast<quint16>(p_BandCount);
+  header.count = static_cast<quint32>(p_Times.size());
+  header.reserved = 0;
+
+  QSaveFile file(dir + "/" + p_Key);
+  if (!file.open(QIODevice::WriteOnly)) return false;
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(p_Times.data()), p_Times.size() * sizeof(quint32));
+  file.write(reinterpret_cast<const char*>(p_Bands.data()), p_Bands.size());
+  if (!file.commit())
+  {
+    Log::Warning("Failed to write spectrum cache %s", p_Key.toStdString().c_str());
+    return false;
+  }
+
+  Log::Debug("Spectrum cache written %s, %u entries", p_Key.toStdString().c_str(), header.count);
+  return true;
+}
+
+void SpectrumCache::Evict()
+{
+  QDir dir(Dir());
+  QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time); // newest first
+  qint64 totalSize = 0;
+  for (const QFileInfo& fileInfo : files)
+  {
+    totalSize += fileInfo.size();
+  }
+
+  while ((totalSize > kMaxCacheBytes) && !files.isEmpty())
+  {
+    const QFileInfo fileInfo = files.takeLast();
+    if (QFile::remove(fileInfo.absoluteFilePath()))
+    {
+      totalSize -= fileInfo.size();
+    }
+  }
+}
+
+bool SpectrumCache::Open(const QString& p_Key, int p_BandCount)
+{
+  Close();
+
+  const QString dir = Dir();
+  if (p_Key.isEmpty() || dir.isEmpty()) return false;
+
+  m_File.setFileName(dir + "/" + p_Key);
+  if (!m_File.open(QIODevice::ReadOnly)) return false;
+
+  const qint64 size = m_File.size();
+  if (size >= static_cast<qint64>(sizeof(SpectrumCacheHeader)))
+  {
+    m_Data = m_File.map(0, size);
+  }
+
+  if (m_Data != nullptr)
+  {
+    const SpectrumCacheHeader* header = reinterpret_cast<const SpectrumCacheHeader*>(m_Data);
+    const qint64 expectedSize = sizeof(SpectrumCacheHeader) +
+      (static_cast<qint64>(header->count) * (sizeof(quint32) + p_BandCount));
+    if ((header->magic == kMagic) && (header->version == kVersion) &&
+        (header->bandCount == p_BandCount) && (header->count > 0) && (size == expectedSize))
+    {
+      m_Count = static_cast<int>(header->count);
+      m_BandCount = p_BandCount;
+      m_Times = reinterpret_cast<const quint32*>(m_Data + sizeof(SpectrumCacheHeader));
+      m_Bands = m_Data + sizeof(SpectrumCacheHeader) + (m_Count * sizeof(quint32));
+
+      // Mark as recently used
+      m_File.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+      return true;
+    }
+
+    Log::Warning("Invalid spectrum cache %s", p_Key.toStdString().c_str());
+  }
+
+  Close();
+  return false;
+}
+
+void SpectrumCache::Close()
+{
+  if (m_Data != nullptr)
+  {
+    m_File.unmap(m_Data);
+    m_Data = nullptr;
+  }
+
+  m_File.close();
+  m_Times = nullptr;
+  m_Bands = nullptr;
+  m_Count = 0;
+  m_BandCount = 0;
+}
+
+bool SpectrumCache::IsOpen() const
+{
+  return (m_Count > 0);
+}
+
+int SpectrumCache::Count() const
+{
+  return m_Count;
+}
+
+int SpectrumCache::Find(qint64 p_TimeMs) const
+{
+  // Last entry at or before given time (first entry if none)
+  const quint32 timeMs = static_cast<quint32>(qMax(0ll, p_TimeMs));
+  const quint32* it = std::upper_bound(m_Times, m_Times + m_Count, timeMs);
+  return qMax(0, static_cast<int>(it - m_Times) - 1);
+}
+
+qint64 SpectrumCache::TimeAt(int p_Index) const
+{
+  return m_Times[p_Index];
+}
+
+void SpectrumCache::BandsAt(int p_Index, float* p_Bands) const
+{
+  const quint8* bands = m_Bands + (p_Index * m_BandCount);
+  for (int i = 0; i < m_BandCount; ++i)
+  {
+    p_Bands[i] = bands[i] / 255.0f;
+  }
+}
+
+QString SpectrumCache::Dir()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  return cacheDir.isEmpty() ? QString() : (cacheDir + "/spectrum");
+}
@@ -0,0 +1,48 @@
+// spectrumcache.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+
+#include <vector>
+
+// Persistent per-track spectrum data, quantized to one byte per band and
+// stored as flat arrays of timestamps and bands. Files are keyed by track
+// path, size and modification time, and memory-mapped when read.
+class SpectrumCache
+{
+public:
+  SpectrumCache();
+  ~SpectrumCache();
+
+  static QString Key(const QString& p_Track, int p_BandCount);
+  static bool Write(const QString& p_Key, int p_BandCount, const std::vector<quint32>& p_Times,
+                    const std::vector<quint8>& p_Bands);
+  static void Evict();
+
+  bool Open(const QString& p_Key, int p_BandCount);
+  void Close();
+  bool IsOpen() const;
+  int Count() const;
+  int Find(qint64 p_TimeMs) const;
+  qint64 TimeAt(int p_Index) const;
+  void BandsAt(int p_Index, float* p_Bands) const;
+
+private:
+  static QString Dir();
+
+private:
+  QFile m_File;
+  uchar* m_Data = nullptr;
+  const quint32* m_Times = nullptr;
+  const quint8* m_Bands = nullptr;
+  int m_Count = 0;
+  int m_BandCount = 0;
+};
@@ -0,0 +1,120 @@
+// spscring.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single-producer / single-consumer ring buffer. Push() and Write()
+// may only be called from the producer thread, Pop(), Peek(), Read() and
+// Clear() only from the consumer thread. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing
+{
+public:
+  explicit SpscRing(size_t p_Capacity)
+  {
+    size_t capacity = 1;
+    while (capacity < p_Capacity)
+    {
+      capacity <<= 1;
+    }
+
+    m_Data.resize(capacity);
+    m_Mask = capacity - 1;
+  }
+
+  size_t Capacity() const
+  {
+    return m_Data.size();
+  }
+
+  size_t Size() const
+  {
+    return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_acquire);
+  }
+
+  size_t Free() const
+  {
+    return Capacity() - Size();
+  }
+
+  bool Push(const T& p_Item)
+  {
+    const size_t head = m_Head.load(std::memory_order_relaxed);
+    const size_t tail = m_Tail.load(std::memory_order_acquire);
+    if ((head - tail) == m_Data.size()) return false;
+
+    m_Data[head & m_Mask] = p_Item;
+    m_Head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T& p_Item)
+  {
+    const size_t tail = m_Tail.load(std::memory_order_relaxed);
+    const size_t head = m_Head.load(std::memory_order_acquire);
+    if (head == tail) return false;
+
+    p_Item = m_Data[tail & m_Mask];
+    m_Tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Peek(T& p_Item) const
+  {
+    const size_t tail = m_Tail.load(std::memory_order_relaxed);
+    const size_t head = m_Head.load(std::memory_order_acquire);
+    if (head == tail) return false;
+
+    p_Item = m_Data[tail & m_Mask];
+    return true;
+  }
+
+  size_t Write(const T* p_Items, size_t p_Count)
+  {
+    const size_t head = m_Head.load(std::memory_order_relaxed);
+    const size_t tail = m_Tail.load(std::memory_order_acquire);
+    const size_t count = std::min(p_Count, m_Data.size() - (head - tail));
+    for (size_t i = 0; i < count; ++i)
+    {
+      m_Data[(head + i) & m_Mask] = p_Items[i];
+    }
+
+    m_Head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  size_t Read(T* p_Items, size_t p_Count)
+  {
+    const size_t tail = m_Tail.load(std::memory_order_relaxed);
+    const size_t head = m_Head.load(std::memory_order_acquire);
+    const size_t count = std::min(p_Count, head - tail);
+    for (size_t i = 0; i < count; ++i)
+    {
+      p_Items[i] = m_Data[(tail + i) & m_Mask];
+    }
+
+    m_Tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  void Clear()
+  {
+    m_Tail.store(m_Head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+private:
+  std::vector<T> m_Data;
+  size_t m_Mask = 0;
+  alignas(64) std::atomic<size_t> m_Head{0};
+  alignas(64) std::atomic<size_t> m_Tail{0};
+};
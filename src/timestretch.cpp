@@ -0,0 +1,311 @@
+// timestretch.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include "timestretch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Definitions for members bound to references (e.g. by qBound), required
+// before C++17
+constexpr float TimeStretch::kMinSpeed;
+constexpr float TimeStretch::kMaxSpeed;
+
+// Segment length, output hop is half of it
+static const int kWindowMs = 40;
+
+// Range around the nominal input position searched for the best continuation
+static const int kSearchMs = 12;
+
+static float Dot(const float* p_A, const float* p_B, int p_Count)
+{
+  int i = 0;
+  float sum = 0.0f;
+#if defined(__AVX__)
+  __m256 acc8 = _mm256_setzero_ps();
+  for (; i + 8 <= p_Count; i += 8)
+  {
+    acc8 = _mm256_add_ps(acc8, _mm256_mul_ps(_mm256_loadu_ps(p_A + i), _mm256_loadu_ps(p_B + i)));
+  }
+
+  float part8[8];
+  _mm256_storeu_ps(part8, acc8);
+  sum = part8[0] + part8[1] + part8[2] + part8[3] + part8[4] + part8[5] + part8[6] + part8[7];
+#endif
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+  __m128 acc4 = _mm_setzero_ps();
+  for (; i + 4 <= p_Count; i += 4)
+  {
+    acc4 = _mm_add_ps(acc4, _mm_mul_ps(_mm_loadu_ps(p_A + i), _mm_loadu_ps(p_B + i)));
+  }
+
+  float part4[4];
+  _mm_storeu_ps(part4, acc4);
+  sum += part4[0] + part4[1] + part4[2] + part4[3];
+#elif defined(__ARM_NEON)
+  float32x4_t acc4 = vdupq_n_f32(0.0f);
+  for (; i + 4 <= p_Count; i += 4)
+  {
+    acc4 = vmlaq_f32(acc4, vld1q_f32(p_A + i), vld1q_f32(p_B + i));
+  }
+
+  float part4[4];
+  vst1q_f32(part4, acc4);
+  sum += part4[0] + part4[1] + part4[2] + part4[3];
+#endif
+  for (; i < p_Count; ++i)
+  {
+    sum += p_A[i] * p_B[i];
+  }
+
+  return sum;
+}
+
+void TimeStretch::SetSpeed(float p_Speed)
+{
+  m_Speed.store(qBound(kMinSpeed, p_Speed, kMaxSpeed), std::memory_order_relaxed);
+}
+
+float TimeStretch::Speed() const
+{
+  return m_Speed.load(std::memory_order_relaxed);
+}
+
+qint64 TimeStretch::PendingFrames() const
+{
+  return m_PendingFrames.load(std::memory_order_relaxed);
+}
+
+void TimeStretch::SetSampleRate(int p_SampleRate)
+{
+  if ((p_SampleRate == m_SampleRate) || (p_SampleRate <= 0)) return;
+
+  m_SampleRate = p_SampleRate;
+  m_WindowFrames = ((kWindowMs * m_SampleRate) / 1000) & ~1;
+  m_HopFrames = m_WindowFrames / 2;
+  m_SearchFrames = (kSearchMs * m_SampleRate) / 1000;
+
+  // Periodic Hann window, which sums to one at half window overlap
+  m_Window.resize(m_WindowFrames);
+  for (int i = 0; i < m_WindowFrames; ++i)
+  {
+    m_Window[i] = 0.5f - (0.5f * cosf((2.0f * static_cast<float>(M_PI) * i) / m_WindowFrames));
+  }
+
+  // Buffers are sized for the largest speed up front, to not allocate on
+  // the audio thread while playing
+  const int maxHop = static_cast<int>(std::ceil(m_HopFrames * kMaxSpeed));
+  m_Input.resize(2 * (2 * (maxHop + m_WindowFrames + (2 * m_SearchFrames))));
+  m_Overlap.resize(2 * m_WindowFrames);
+  m_Output.reserve(2 * m_HopFrames);
+  m_TemplateMono.resize(m_HopFrames);
+  m_SearchMono.resize(m_HopFrames + (2 * m_SearchFrames) + 1);
+  Reset();
+}
+
+void TimeStretch::Reset()
+{
+  m_Active = false;
+  m_First = true;
+  m_InputFrames = 0;
+  m_Nominal = 0.0;
+  m_Template = 0;
+  std::fill(m_Overlap.begin(), m_Overlap.end(), 0.0f);
+  m_Output.clear();
+  m_OutputPos = 0;
+  m_PendingFrames.store(0, std::memory_order_relaxed);
+}
+
+bool TimeStretch::Prepare()
+{
+  // Once started, stretching continues (at 1x without search) until reset,
+  // as its buffered audio would otherwise be lost
+  m_ActiveSpeed = m_Speed.load(std::memory_order_relaxed);
+  if (!m_Active && (m_ActiveSpeed != 1.0f) && (m_SampleRate > 0))
+  {
+    Reset();
+    m_Active = true;
+  }
+
+  return m_Active;
+}
+
+size_t TimeStretch::ReadOutput(float* p_Samples, size_t p_Count)
+{
+  size_t done = 0;
+  while (done < p_Count)
+  {
+    if (m_OutputPos >= m_Output.size())
+    {
+      if (m_InputFrames < FramesNeeded()) break;
+
+      Step();
+    }
+
+    const size_t count = std::min(p_Count - done, m_Output.size() - m_OutputPos);
+    std::copy(m_Output.begin() + m_OutputPos, m_Output.begin() + m_OutputPos + count, p_Samples + done);
+    m_OutputPos += count;
+    done += count;
+  }
+
+  UpdatePending();
+  return done;
+}
+
+float* TimeStretch::InputBuffer(size_t& p_Count)
+{
+  const size_t needed = FramesNeeded();
+  if (m_Input.size() < (2 * needed))
+  {
+    m_Input.resize(2 * needed);
+  }
+
+  p_Count = 2 * (needed - std::min(needed, m_InputFrames));
+  return m_Input.data() + (2 * m_InputFrames);
+}
+
+void TimeStretch::InputWritten(size_t p_Count)
+{
+  m_InputFrames += p_Count / 2;
+  UpdatePending();
+}
+
+void TimeStretch::Step()
+{
+  int start = 0;
+  if (m_First)
+  {
+    m_First = false;
+  }
+  else if (m_ActiveSpeed == 1.0f)
+  {
+    // Natural continuation, which overlap-adds back to the input
+    start = m_Template;
+  }
+  else
+  {
+    const int nominal = static_cast<int>(m_Nominal);
+    start = nominal + BestOffset(nominal);
+  }
+
+  // Overlap-add the windowed segment, of which the first hop is complete
+  const float* input = m_Input.data() + (2 * start);
+  float* overlap = m_Overlap.data();
+  for (int i = 0; i < m_WindowFrames; ++i)
+  {
+    overlap[2 * i] += m_Window[i] * input[2 * i];
+    overlap[(2 * i) + 1] += m_Window[i] * input[(2 * i) + 1];
+  }
+
+  m_Output.assign(overlap, overlap + (2 * m_HopFrames));
+  m_OutputPos = 0;
+  std::copy(overlap + (2 * m_HopFrames), overlap + (2 * m_WindowFrames), overlap);
+  std::fill(overlap + (2 * (m_WindowFrames - m_HopFrames)), overlap + (2 * m_WindowFrames), 0.0f);
+
+  m_Template = start + m_HopFrames;
+  m_Nominal = (m_ActiveSpeed == 1.0f) ? m_Template : (m_Nominal + (m_HopFrames * m_ActiveSpeed));
+
+  // Drop input before both the template and the next search range
+  const int discard = std::min(static_cast<int>(m_Nominal) - m_SearchFrames, m_Template);
+  if (discard > 0)
+  {
+    std::copy(m_Input.begin() + (2 * discard), m_Input.begin() + (2 * m_InputFrames), m_Input.begin());
+    m_InputFrames -= discard;
+    m_Nominal -= discard;
+    m_Template -= discard;
+  }
+}
+
+size_t TimeStretch::FramesNeeded() const
+{
+  if (m_First) return m_WindowFrames;
+
+  const int search = (m_ActiveSpeed == 1.0f) ? 0 : m_SearchFrames;
+  return std::max(static_cast<int>(m_Nominal) + search + m_WindowFrames, m_Template + m_WindowFrames);
+}
+
+void TimeStretch::UpdatePending()
+{
+  // Input not yet reached by the segment position, and output not yet read,
+  // in input frames
+  const double input = std::max(0.0, m_InputFrames - m_Nominal);
+  const double output = ((m_Output.size() - m_OutputPos) / 2) * m_ActiveSpeed;
+  m_PendingFrames.store(static_cast<qint64>(input + output), std::memory_order_relaxed);
+}
+
+int TimeStretch::BestOffset(int p_Nominal)
+{
+  const int lo = std::max(-m_SearchFrames, -p_Nominal);
+  const int hi = m_SearchFrames;
+  const int length = m_HopFrames;
+
+  // Similarity is measured on the sum of both channels, where the segment
+  // overlaps the natural continuation of the previous one
+  const float* input = m_Input.data();
+  for (int i = 0; i < length; ++i)
+  {
+    m_TemplateMono[i] = input[2 * (m_Template + i)] + input[(2 * (m_Template + i)) + 1];
+  }
+
+  const int searchCount = (hi - lo) + length;
+  for (int i = 0; i < searchCount; ++i)
+  {
+    const int frame = p_Nominal + lo + i;
+    m_SearchMono[i] = input[2 * frame] + input[(2 * frame) + 1];
+  }
+
+  // Coarse search at every other offset, refined around the best one
+  float energy = 0.0f;
+  for (int i = 0; i < length; ++i)
+  {
+    energy += m_SearchMono[i] * m_SearchMono[i];
+  }
+
+  int best = lo;
+  float bestScore = -INFINITY;
+  for (int offset = lo; offset <= hi; offset += 2)
+  {
+    const int pos = offset - lo;
+    const float score = Dot(m_TemplateMono.data(), m_SearchMono.data() + pos, length) / sqrtf(energy + 1.0e-9f);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      best = offset;
+    }
+
+    for (int i = 0; (i < 2) && ((pos + i + length) < searchCount); ++i)
+    {
+      const float out = m_SearchMono[pos + i];
+      const float in = m_SearchMono[pos + i + length];
+      energy = std::max(0.0f, energy + (in * in) - (out * out));
+    }
+  }
+
+  const int coarse = best;
+  for (int offset = std::max(lo, coarse - 1); offset <= std::min(hi, coarse + 1); offset += 2)
+  {
+    const float* search = m_SearchMono.data() + (offset - lo);
+    const float score = Dot(m_TemplateMono.data(), search, length) / sqrtf(Dot(search, search, length) + 1.0e-9f);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      best = offset;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,68 @@
+// timestretch.h
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+// Pitch preserving time stretching of interleaved stereo float audio by
+// WSOLA (waveform similarity overlap-add). Windowed input segments are taken
+// at the playback speed and overlap-added at a fixed output hop, each one at
+// the offset around its nominal position that best continues the waveform of
+// the previous one. The similarity search uses SSE/AVX/NEON where available.
+// Speed is set from the GUI thread and picked up by the audio thread.
+class TimeStretch
+{
+public:
+  static constexpr float kMinSpeed = 0.5f;
+  static constexpr float kMaxSpeed = 3.0f;
+
+  void SetSpeed(float p_Speed);
+  float Speed() const;
+  qint64 PendingFrames() const;
+
+  // Audio thread (or while it is stopped)
+  void SetSampleRate(int p_SampleRate);
+  void Reset();
+  bool Prepare();
+  size_t ReadOutput(float* p_Samples, size_t p_Count);
+  float* InputBuffer(size_t& p_Count);
+  void InputWritten(size_t p_Count);
+
+private:
+  void Step();
+  size_t FramesNeeded() const;
+  int BestOffset(int p_Nominal);
+  void UpdatePending();
+
+private:
+  std::atomic<float> m_Speed{1.0f};
+  std::atomic<qint64> m_PendingFrames{0};
+
+  // Audio thread only
+  int m_SampleRate = 0;
+  int m_WindowFrames = 0;
+  int m_HopFrames = 0;
+  int m_SearchFrames = 0;
+  float m_ActiveSpeed = 1.0f;
+  bool m_Active = false;
+  bool m_First = true;
+  std::vector<float> m_Window;
+  std::vector<float> m_Input;
+  size_t m_InputFrames = 0;
+  double m_Nominal = 0.0;
+  int m_Template = 0;
+  std::vector<float> m_Overlap;
+  std::vector<float> m_Output;
+  size_t m_OutputPos = 0;
+  std::vector<float> m_TemplateMono;
+  std::vector<float> m_SearchMono;
+};
@@ -36,15 +36,78 @@ UIKeyhandler::~UIKeyhandler()
 
 void UIKeyhandler::ProcessKeyEvent()
 {
-  int key = wgetch(m_KeyhandlerWindow);
+  // Drain all pending input per activation. Consecutive playlist navigation
+  // keys are merged into a single movement, so that key repeat results in
+  // one selection update (and one redraw) rather than one per key. Movement
+  // is applied as pages followed by rows, each clamped at the list ends, so
+  // it is flushed before a key that would reverse direction or put a page
+  // after rows, to end up where the keys applied one by one would.
+  int rows = 0;
+  int pages = 0;
+  int key = ERR;
+  while ((key = wgetch(m_KeyhandlerWindow)) != ERR)
+  {
+    if (m_UIState & UISTATE_PLAYLIST)
+    {
+      int rowStep = 0;
+      int pageStep = 0;
+      switch (key)
+      {
+        case KEY_UP: rowStep = -1; break;
+        case KEY_DOWN: rowStep = 1; break;
+        case KEY_PPAGE: pageStep = -1; break;
+        case KEY_NPAGE: pageStep = 1; break;
+        default: break;
+      }
+
+      if (rowStep != 0)
+      {
+        if ((rows * rowStep) < 0)
+        {
+          FlushMovement(rows, pages);
+        }
+
+        rows += rowStep;
+        continue;
+      }
+
+      if (pageStep != 0)
+      {
+        if ((rows != 0) || ((pages * pageStep) < 0))
+        {
+          FlushMovement(rows, pages);
+        }
+
+        pages += pageStep;
+        continue;
+      }
+    }
+
+    FlushMovement(rows, pages);
+    ProcessKey(key);
+  }
 
+  FlushMovement(rows, pages);
+}
+
+void UIKeyhandler::FlushMovement(int& p_Rows, int& p_Pages)
+{
+  if ((p_Rows == 0) && (p_Pages == 0)) return;
+
+  emit MoveSelection(p_Rows, p_Pages);
+  p_Rows = 0;
+  p_Pages = 0;
+}
+
+void UIKeyhandler::ProcessKey(int p_Key)
+{
   if (m_UIState & UISTATE_SEARCH)
   {
-    emit KeyPress(key);
+    emit KeyPress(p_Key);
     return;
   }
 
-  switch (key)
+  switch (p_Key)
   {
     case 'z':
     case 'Z':
@@ -85,12 +148,10 @@ void UIKeyhandler::ProcessKeyEvent()
 
     case KEY_UP:
       if (m_UIState & UISTATE_PLAYER) emit VolumeUp();
-      if (m_UIState & UISTATE_PLAYLIST) emit SelectPrevious();
       break;
 
     case KEY_DOWN:
       if (m_UIState & UISTATE_PLAYER) emit VolumeDown();
-      if (m_UIState & UISTATE_PLAYLIST) emit SelectNext();
       break;
 
     case KEY_LEFT:
@@ -101,12 +162,14 @@ void UIKeyhandler::ProcessKeyEvent()
       emit SkipForward();
       break;
 
-    case KEY_PPAGE:
-      if (m_UIState & UISTATE_PLAYLIST) emit PagePrevious();
+    case KEY_SLEFT:
+    case '[':
+      emit SpeedDown();
       break;
 
-    case KEY_NPAGE:
-      if (m_UIState & UISTATE_PLAYLIST) emit PageNext();
+    case KEY_SRIGHT:
+    case ']':
+      emit SpeedUp();
       break;
 
     case KEY_HOME:
@@ -144,6 +207,11 @@ void UIKeyhandler::ProcessKeyEvent()
       emit ToggleFolders();
       break;
 
+    case 'i':
+    case 'I':
+      emit ToggleStats();
+      break;
+
     case 'e':
       emit Enqueue();
       break;
@@ -152,6 +220,19 @@ void UIKeyhandler::ProcessKeyEvent()
       emit Unenqueue();
       break;
 
+    case 'r':
+    case 'R':
+      emit EnqueueFolder();
+      break;
+
+    case 'y':
+      emit CycleEqualizer();
+      break;
+
+    case 'Y':
+      emit ToggleEqualizerFolder();
+      break;
+
     case 't':
     case 'T':
       emit ExternalEdit();
@@ -39,12 +39,18 @@ signals:
   void VolumeDown();
   void SkipBackward();
   void SkipForward();
+  void SpeedDown();
+  void SpeedUp();
   void ToggleShuffle();
   void ToggleAnalyzer();
   void ToggleFolders();
+  void ToggleStats();
   void ExternalEdit();
   void Enqueue();
   void Unenqueue();
+  void EnqueueFolder();
+  void CycleEqualizer();
+  void ToggleEqualizerFolder();
 #ifdef HAS_GUI
   void ToggleCdg();
   void ToggleLyrics();
@@ -54,10 +60,7 @@ signals:
   void LyricsZoomReset();
 #endif
   void Search();
-  void SelectPrevious();
-  void SelectNext();
-  void PagePrevious();
-  void PageNext();
+  void MoveSelection(int p_Rows, int p_Pages);
   void Home();
   void End();
   void PlaySelected();
@@ -68,6 +71,8 @@ signals:
   void MouseEventRequest(int p_X, int p_Y, uint32_t p_Button);
 
 private:
+  void ProcessKey(int p_Key);
+  void FlushMovement(int& p_Rows, int& p_Pages);
   void DoMouseEventRequest();
 
 private:
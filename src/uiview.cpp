@@ -6,6 +6,7 @@
 // namp is distributed under the GPLv2 license, see LICENSE for details.
 //
 
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QObject>
@@ -24,6 +25,7 @@
 
 #include "scrobbler.h"
 #include "log.h"
+#include "playbackstats.h"
 #include "uiview.h"
 #include "util.h"
 
@@ -92,7 +94,7 @@ void UIView::PositionChanged(qint64 p_Position)
   m_TrackPositionSec = p_Position / 1000;
   Refresh();
 
-  if (m_Scrobbler && (m_TrackDurationSec > 0) && (m_PlaylistPosition < m_Playlist.count()))
+  if ((m_TrackDurationSec > 0) && (m_PlaylistPosition < m_Playlist.count()))
   {
     if (m_TrackPositionSec == 0)
     {
@@ -104,16 +106,25 @@ void UIView::PositionChanged(qint64 p_Position)
     const qint64 elapsedSec = m_PlayTime.elapsed() / 1000;
     if (!m_SetPlayed && (elapsedSec >= 10) && (m_TrackPositionSec >= (m_TrackDurationSec / 2))) // scrobble played after 50% (min 10 sec)
     {
-      const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
-      const QString& title = m_Playlist.at(m_PlaylistPosition).title;
-      m_Scrobbler->Played(artist, title, m_TrackDurationSec);
+      if (m_Scrobbler)
+      {
+        const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
+        const QString& title = m_Playlist.at(m_PlaylistPosition).title;
+        m_Scrobbler->Played(artist, title, m_TrackDurationSec);
+      }
+
+      emit TrackPlayed(m_PlaylistPosition);
       m_SetPlayed = true;
     }
     else if (!m_SetPlaying && (elapsedSec >= 3)) // scrobble playing after 3 sec
     {
-      const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
-      const QString& title = m_Playlist.at(m_PlaylistPosition).title;
-      m_Scrobbler->Playing(artist, title, m_TrackDurationSec);
+      if (m_Scrobbler)
+      {
+        const QString& artist = m_Playlist.at(m_PlaylistPosition).artist;
+        const QString& title = m_Playlist.at(m_PlaylistPosition).title;
+        m_Scrobbler->Playing(artist, title, m_TrackDurationSec);
+      }
+
       m_SetPlaying = true;
     }
   }
@@ -154,35 +165,38 @@ void UIView::PlaybackModeUpdated(bool p_Shuffle)
   Refresh();
 }
 
-void UIView::Search()
+void UIView::EqualizerUpdated(const QString& p_Preset)
 {
-  SetUIState(UISTATE_SEARCH);
+  m_EqualizerPreset = p_Preset;
   Refresh();
 }
 
-void UIView::SelectPrevious()
+void UIView::SpeedUpdated(float p_Speed)
 {
-  SetPlaylistSelected((m_PlaylistSelected - 1), true);
+  m_Speed = p_Speed;
   Refresh();
 }
 
-void UIView::SelectNext()
+void UIView::Search()
 {
-  SetPlaylistSelected((m_PlaylistSelected + 1), true);
+  SetUIState(UISTATE_SEARCH);
   Refresh();
 }
 
-void UIView::PagePrevious()
+void UIView::MoveSelection(int p_Rows, int p_Pages)
 {
-  int pageSize = m_ViewFolders ? VisibleTrackCount() : (m_PlaylistWindowHeight - 2);
-  SetPlaylistSelected((m_PlaylistSelected - pageSize), true);
-  Refresh();
-}
+  // Apply a (possibly merged) movement and redraw once
+  for (int i = 0; i < qAbs(p_Pages); ++i)
+  {
+    int pageSize = m_ViewFolders ? VisibleTrackCount() : (m_PlaylistWindowHeight - 2);
+    SetPlaylistSelected((m_PlaylistSelected + ((p_Pages < 0) ? -pageSize : pageSize)), true);
+  }
+
+  if ((p_Rows != 0) || (p_Pages == 0))
+  {
+    SetPlaylistSelected((m_PlaylistSelected + p_Rows), true);
+  }
 
-void UIView::PageNext()
-{
-  int pageSize = m_ViewFolders ? VisibleTrackCount() : (m_PlaylistWindowHeight - 2);
-  SetPlaylistSelected((m_PlaylistSelected + pageSize), true);
   Refresh();
 }
 
@@ -332,8 +346,17 @@ void UIView::CreateWindows()
   }
 
   m_TitleWidth = m_PlayerWindowWidth - 13;;
-  m_VolumeWidth = m_PlayerWindowWidth - 15;
   m_PositionWidth = m_PlayerWindowWidth - 6;
+
+  // Analyzer has one column per band, and grows with the player window
+  const int spectrumWidth = qBound(8, 8 + ((m_PlayerWindowWidth - s_MinTerminalWidth) / 2), 64);
+  m_VolumeX = spectrumWidth + 3;
+  m_VolumeWidth = m_PlayerWindowWidth - m_VolumeX - 4;
+  if (spectrumWidth != m_SpectrumWidth)
+  {
+    m_SpectrumWidth = spectrumWidth;
+    emit SpectrumBandCountChanged(m_SpectrumWidth);
+  }
 }
 
 void UIView::DrawPlayer()
@@ -358,11 +381,18 @@ void UIView::DrawPlayer()
       mvwprintw(m_PlayerWindow, 1, 3, "      ");
     }
 
-    // Track title
+    // Track title, or playback stats overlay
     mvwprintw(m_PlayerWindow, 1, 11, "%.*s", -m_TitleWidth, "");
-    std::string fullName = GetPlayerTrackName(m_TitleWidth).toStdString();
-    std::wstring trackName = Util::TrimPadWString(Util::ToWString(fullName), m_TitleWidth);
-    mvwaddnwstr(m_PlayerWindow, 1, 11, trackName.c_str(), trackName.size());
+    if (m_ViewStats)
+    {
+      DrawStats();
+    }
+    else
+    {
+      std::string fullName = GetPlayerTrackName(m_TitleWidth).toStdString();
+      std::wstring trackName = Util::TrimPadWString(Util::ToWString(fullName), m_TitleWidth);
+      mvwaddnwstr(m_PlayerWindow, 1, 11, trackName.c_str(), trackName.size());
+    }
 
     // Spectrum analyzer
     if (m_ViewAnalyzer)
@@ -371,12 +401,12 @@ void UIView::DrawPlayer()
     }
     else
     {
-      mvwprintw(m_PlayerWindow, 2, 2, "        ");
+      mvwprintw(m_PlayerWindow, 2, 2, "%*c", m_SpectrumWidth, ' ');
     }
 
     // Volume
-    mvwprintw(m_PlayerWindow, 2, 11, "-%*c+", m_VolumeWidth, ' ');
-    mvwhline(m_PlayerWindow, 2, 12, 0, (m_VolumeWidth * m_VolumePercentage) / 100);
+    mvwprintw(m_PlayerWindow, 2, m_VolumeX, "-%*c+", m_VolumeWidth, ' ');
+    mvwhline(m_PlayerWindow, 2, m_VolumeX + 1, 0, (m_VolumeWidth * m_VolumePercentage) / 100);
 
     // Progress
     mvwprintw(m_PlayerWindow, 3, 2, "|%*c|", m_PositionWidth, ' ');
@@ -407,6 +437,21 @@ void UIView::DrawPlayer()
     mvwprintw(m_PlayerWindow, 4, xpos, "[%c] Shuffle", m_Shuffle ? 'X' : ' ');
     xpos += 11;
 
+    // Playback speed, when not normal
+    if ((m_Speed != 1.0f) && (xpos + 8 <= m_PlayerWindowWidth))
+    {
+      mvwprintw(m_PlayerWindow, 4, xpos, "  %.2fx", m_Speed);
+      xpos += 7;
+    }
+
+    // Equalizer preset (native engine only, and when it fits in window)
+    const int equalizerWidth = 5 + static_cast<int>(m_EqualizerPreset.size());
+    if (!m_EqualizerPreset.isEmpty() && (xpos + equalizerWidth + 1 <= m_PlayerWindowWidth))
+    {
+      mvwprintw(m_PlayerWindow, 4, xpos, "  EQ %s", m_EqualizerPreset.toStdString().c_str());
+      xpos += equalizerWidth;
+    }
+
     // Lyrics toggle (when available and fits in window, with trailing space margin)
     m_LyricsX = -1;
     if (m_LyricsAvailable && (xpos + 14 <= m_PlayerWindowWidth))
@@ -544,6 +589,19 @@ void UIView::KeyPress(int p_Key) // can move this to other slots later.
       }
       break;
 
+    case 5: // CTRLE
+      if (!m_Resultlist.isEmpty())
+      {
+        QVector<int> indices;
+        indices.reserve(m_Resultlist.size());
+        for (const TrackInfo& trackInfo : m_Resultlist)
+        {
+          indices.append(trackInfo.index);
+        }
+        emit EnqueueTracks(indices);
+      }
+      break;
+
     case 3: // CTRLC
     case 27: // ESC
       SetUIState(m_PreviousUIState);
@@ -730,10 +788,10 @@ void UIView::MouseEventRequest(int p_X, int p_Y, uint32_t p_Button)
     if ((p_Y == 1) && (p_X >= 11) && (p_X < (m_TitleWidth + 11))) m_ScrollTitle = !m_ScrollTitle;
 
     // Analyzer
-    if ((p_Y == 2) && (p_X >= 2) && (p_X <= 9)) { m_ViewAnalyzer = !m_ViewAnalyzer; emit AnalyzerEnabled(m_ViewAnalyzer); }
+    if ((p_Y == 2) && (p_X >= 2) && (p_X <= (m_SpectrumWidth + 1))) { m_ViewAnalyzer = !m_ViewAnalyzer; emit AnalyzerEnabled(m_ViewAnalyzer); }
 
     // Volume
-    if ((p_Y == 2) && (p_X >= 11) && (p_X < (m_VolumeWidth + 11 + 2))) emit ProcessMouseEvent(UIMouseEvent(UIELEM_VOLUME, 100 * (p_X - 11) / m_VolumeWidth));
+    if ((p_Y == 2) && (p_X >= m_VolumeX) && (p_X < (m_VolumeWidth + m_VolumeX + 2))) emit ProcessMouseEvent(UIMouseEvent(UIELEM_VOLUME, 100 * (p_X - m_VolumeX) / m_VolumeWidth));
 
     // Position
     else if ((p_Y == 3) && (p_X >= 2) && (p_X < (m_PositionWidth + 2 + 2))) emit ProcessMouseEvent(UIMouseEvent(UIELEM_POSITION, 100 * (p_X - 2) / m_PositionWidth));
@@ -1078,12 +1136,53 @@ void UIView::ToggleAnalyzer()
   Refresh();
 }
 
+void UIView::ToggleStats()
+{
+  m_ViewStats = !m_ViewStats;
+  Refresh();
+}
+
+void UIView::DrawStats()
+{
+  // Counts since start, and age of the most recent event
+  qint64 lastTimeMs = 0;
+  PlaybackStats::Counter lastCounter = PlaybackStats::Underrun;
+  for (int i = 0; i < PlaybackStats::CounterCount; ++i)
+  {
+    const PlaybackStats::Counter counter = static_cast<PlaybackStats::Counter>(i);
+    const qint64 timeMs = PlaybackStats::GetLastTime(counter);
+    if (timeMs > lastTimeMs)
+    {
+      lastTimeMs = timeMs;
+      lastCounter = counter;
+    }
+  }
+
+  char stats[160];
+  int len = snprintf(stats, sizeof(stats), "xrun %d stall %d late %d restart %d dsp %.2f%% lat %lldms",
+                     PlaybackStats::GetCount(PlaybackStats::Underrun),
+                     PlaybackStats::GetCount(PlaybackStats::DecoderStall),
+                     PlaybackStats::GetCount(PlaybackStats::LatePosition),
+                     PlaybackStats::GetCount(PlaybackStats::DeviceRestart),
+                     PlaybackStats::GetDspLoad() * 100.0f,
+                     static_cast<long long>(PlaybackStats::GetOutputLatency()));
+  if ((lastTimeMs > 0) && (len > 0) && (len < static_cast<int>(sizeof(stats))))
+  {
+    const qint64 ageSec = (QDateTime::currentMSecsSinceEpoch() - lastTimeMs) / 1000;
+    snprintf(stats + len, sizeof(stats) - len, " (%s %llds ago)", PlaybackStats::GetName(lastCounter),
+             static_cast<long long>(ageSec));
+  }
+
+  mvwprintw(m_PlayerWindow, 1, 11, "%-*.*s", m_TitleWidth, m_TitleWidth, stats);
+}
+
 void UIView::DrawSpectrumBars()
 {
   static const wchar_t bars[] = L" \u2581\u2582\u2583\u2584\u2585\u2586\u2587";
-  for (int i = 0; i < 8 && i < m_SpectrumBands.size(); ++i)
+  for (int i = 0; i < m_SpectrumWidth; ++i)
   {
-    int level = qBound(0, static_cast<int>(m_SpectrumBands[i] * 7.0f), 7);
+    const float band = (i < m_SpectrumBands.size()) ? m_SpectrumBands[i] : 0.0f;
+    int level = qBound(0, static_cast<int>(band * 7.0f), 7);
     wchar_t ch = bars[level];
     mvwaddnwstr(m_PlayerWindow, 2, 2 + i, &ch, 1);
   }
@@ -1110,23 +1209,44 @@ void UIView::Unenqueue()
   }
 }
 
-void UIView::QueueUpdated(const QVector<int>& p_Queue)
+void UIView::EnqueueFolder()
+{
+  if ((m_UIState & (UISTATE_PLAYER | UISTATE_PLAYLIST)) &&
+      (m_PlaylistSelected >= 0) && (m_PlaylistSelected < m_Playlist.size()))
+  {
+    const QString dir = QFileInfo(m_Playlist.at(m_PlaylistSelected).path).path();
+    QVector<int> indices;
+    for (const TrackInfo& trackInfo : m_Playlist)
+    {
+      if (QFileInfo(trackInfo.path).path() == dir)
+      {
+        indices.append(trackInfo.index);
+      }
+    }
+    emit EnqueueTracks(indices);
+  }
+}
+
+void UIView::QueueUpdated(const PlayQueue* p_Queue)
 {
+  // Queue is owned by the audio player, and read from here only when drawing
   m_Queue = p_Queue;
   Refresh();
 }
 
 std::wstring UIView::GetQueueMarker(int p_TrackIndex) const
 {
+  if (m_Queue == nullptr) return std::wstring();
+
+  const QVector<int> queuePositions = m_Queue->Positions(p_TrackIndex);
+  if (queuePositions.isEmpty()) return std::wstring();
+
   QStringList positions;
-  for (int i = 0; i < m_Queue.size(); ++i)
+  for (int position : queuePositions)
   {
-    if (m_Queue.at(i) == p_TrackIndex)
-    {
-      positions.append(QString::number(i + 1));
-    }
+    positions.append(QString::number(position));
   }
-  if (positions.isEmpty()) return std::wstring();
+
   QString marker = " [" + positions.join(",") + "]";
   return Util::ToWString(marker.toStdString());
 }
@@ -19,6 +19,7 @@
 #include <ncurses.h>
 
 #include "common.h"
+#include "playqueue.h"
 #include "scrobbler.h"
 
 struct TrackInfo
@@ -72,10 +73,7 @@ public slots:
   void VolumeChanged(int p_Volume);
   void PlaybackModeUpdated(bool p_Shuffle);
   void Search();
-  void SelectPrevious();
-  void SelectNext();
-  void PagePrevious();
-  void PageNext();
+  void MoveSelection(int p_Rows, int p_Pages);
   void Home();
   void End();
   void PlaySelected();
@@ -86,11 +84,15 @@ public slots:
   void SpectrumChanged(const QVector<float>& p_Spectrum);
   void ToggleAnalyzer();
   void ToggleFolders();
+  void ToggleStats();
   void LyricsUpdated(bool p_Enabled);
   void ExternalEdit();
   void Enqueue();
   void Unenqueue();
-  void QueueUpdated(const QVector<int>& p_Queue);
+  void EnqueueFolder();
+  void QueueUpdated(const PlayQueue* p_Queue);
+  void EqualizerUpdated(const QString& p_Preset);
+  void SpeedUpdated(float p_Speed);
 
 private slots:
   void Timer();
@@ -104,6 +106,9 @@ signals:
   void AnalyzerEnabled(bool);
   void EnqueueTrack(int);
   void UnenqueueTrack(int);
+  void EnqueueTracks(const QVector<int>&);
+  void SpectrumBandCountChanged(int);
+  void TrackPlayed(int);
 
 private:
   void SetUIState(UIState p_UIState);
@@ -113,6 +118,7 @@ private:
   void CreateWindows();
   void DrawPlayer();
   void DrawSpectrumBars();
+  void DrawStats();
   QString GetPlayerTrackName(int p_MaxLength);
   void DrawPlaylist();
   void LoadTracksData();
@@ -145,12 +151,14 @@ private:
   int m_PlaylistWindowY = -1;
 
   int m_TitleWidth = 0;
+  int m_SpectrumWidth = 0;
+  int m_VolumeX = 11;
   int m_VolumeWidth = 0;
   int m_PositionWidth = 0;
 
   QVector<TrackInfo> m_Playlist;
   QVector<TrackInfo> m_Resultlist;
-  QVector<int> m_Queue;
+  const PlayQueue* m_Queue = nullptr;
 
   bool m_PlaylistLoaded = true;
   int m_TrackPositionSec = 0;
@@ -160,6 +168,8 @@ private:
   int m_PlaylistOffset = 0;
   int m_VolumePercentage = 100;
   bool m_Shuffle = false;
+  QString m_EqualizerPreset;
+  float m_Speed = 1.0f;
   bool m_LyricsEnabled = false;
   bool m_LyricsAvailable = false;
   int m_ShuffleX = 18;
@@ -168,6 +178,7 @@ private:
   bool m_ViewPosition = true;
   bool m_ViewAnalyzer = false;
   bool m_ViewFolders = false;
+  bool m_ViewStats = false;
   QString m_CommonAncestorPath;
   UIState m_UIState = UISTATE_PLAYER;
   UIState m_PreviousUIState = UISTATE_PLAYER;
@@ -178,6 +189,6 @@ private:
 
   bool m_SetPlaying = false;
   bool m_SetPlayed = false;
-  QVector<float> m_SpectrumBands = QVector<float>(8, 0.0f);
+  QVector<float> m_SpectrumBands;
 };
 
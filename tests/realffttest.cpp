@@ -0,0 +1,136 @@
+// realffttest.cpp
+//
+// Copyright (C) 2026 Kristofer Berggren
+// All rights reserved.
+//
+// namp is distributed under the GPLv2 license, see LICENSE for details.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "realfft.h"
+
+// Max error relative to the largest reference magnitude
+static const double kMaxRelError = 1.0e-4;
+
+// Transforms per size in the timing loop
+static const int kBenchIterations = 20000;
+
+// Keeps the timed results from being optimized away
+static volatile float s_Sink = 0.0f;
+
+static void ReferenceDft(const std::vector<float>& p_Input, std::vector<double>& p_Re, std::vector<double>& p_Im)
+{
+  const int size = static_cast<int>(p_Input.size());
+  p_Re.assign((size / 2) + 1, 0.0);
+  p_Im.assign((size / 2) + 1, 0.0);
+  for (int k = 0; k <= size / 2; ++k)
+  {
+    for (int n = 0; n < size; ++n)
+    {
+      const double angle = (-2.0 * M_PI * k * n) / size;
+      p_Re[k] += p_Input[n] * cos(angle);
+      p_Im[k] += p_Input[n] * sin(angle);
+    }
+  }
+}
+
+static bool CheckSize(int p_Size)
+{
+  std::vector<float> input(p_Size);
+  std::vector<float> window(p_Size);
+  for (int n = 0; n < p_Size; ++n)
+  {
+    input[n] = (static_cast<float>(rand()) / RAND_MAX) - 0.5f + (0.25f * sinf(0.3f * n));
+    window[n] = 0.5f * (1.0f - cosf((2.0f * static_cast<float>(M_PI) * n) / (p_Size - 1)));
+  }
+
+  RealFFT fft(p_Size);
+  std::vector<float> re((p_Size / 2) + 1);
+  std::vector<float> im((p_Size / 2) + 1);
+  std::vector<double> refRe;
+  std::vector<double> refIm;
+  double maxError = 0.0;
+  double maxMagnitude = 0.0;
+
+  // Plain transform
+  fft.Forward(input.data(), re.data(), im.data());
+  ReferenceDft(input, refRe, refIm);
+  for (int k = 0; k <= p_Size / 2; ++k)
+  {
+    maxError = std::max(maxError, std::max(std::fabs(re[k] - refRe[k]), std::fabs(im[k] - refIm[k])));
+    maxMagnitude = std::max(maxMagnitude, std::hypot(refRe[k], refIm[k]));
+  }
+
+  // Windowed magnitudes, single and batched
+  std::vector<float> windowed(p_Size);
+  for (int n = 0; n < p_Size; ++n)
+  {
+    windowed[n] = input[n] * window[n];
+  }
+
+  ReferenceDft(windowed, refRe, refIm);
+  fft.SetWindow(window);
+  std::vector<float> magnitudes(p_Size / 2);
+  fft.Magnitudes(input.data(), magnitudes.data());
+  std::vector<float> batch(2 * (p_Size / 2));
+  std::vector<float> twice(input);
+  twice.insert(twice.end(), input.begin(), input.end());
+  fft.MagnitudesBatch(twice.data(), 2, p_Size, batch.data());
+  for (int k = 0; k < p_Size / 2; ++k)
+  {
+    const double refMagnitude = std::hypot(refRe[k], refIm[k]);
+    maxError = std::max(maxError, std::fabs(magnitudes[k] - refMagnitude));
+    maxError = std::max(maxError, std::fabs(batch[k] - refMagnitude));
+    maxError = std::max(maxError, std::fabs(batch[(p_Size / 2) + k] - refMagnitude));
+  }
+
+  const double relError = maxError / std::max(maxMagnitude, 1.0e-9);
+  const bool ok = (relError <= kMaxRelError);
+  printf("size %5d  max error %.2e  relative %.2e  %s\n", p_Size, maxError, relError, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+static void BenchSize(int p_Size)
+{
+  std::vector<float> input(p_Size);
+  for (int n = 0; n < p_Size; ++n)
+  {
+    input[n] = (static_cast<float>(rand()) / RAND_MAX) - 0.5f;
+  }
+
+  RealFFT fft(p_Size);
+  std::vector<float> magnitudes(p_Size / 2);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kBenchIterations; ++i)
+  {
+    input[i % p_Size] += 1.0e-6f;
+    fft.Magnitudes(input.data(), magnitudes.data());
+    s_Sink = magnitudes[i % (p_Size / 2)];
+  }
+
+  const double elapsedUs =
+    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  printf("size %5d  %.3f us per magnitude spectrum\n", p_Size, elapsedUs / kBenchIterations);
+}
+
+int main()
+{
+  srand(1);
+  bool ok = true;
+  for (int size = 8; size <= 4096; size *= 2)
+  {
+    ok = CheckSize(size) && ok;
+  }
+
+  for (int size = 256; size <= 4096; size *= 2)
+  {
+    BenchSize(size);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+TARGET               = realffttest
+TEMPLATE             = app
+CONFIG              += c++11 release cmdline
+CONFIG              -= qt app_bundle
+
+INCLUDEPATH         += $$PWD/../src
+
+HEADERS              = ../src/realfft.h
+
+SOURCES              = realffttest.cpp                         \
+                       ../src/realfft.cpp